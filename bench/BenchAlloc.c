@@ -0,0 +1,90 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "BenchAlloc.h"
+
+// This file sees the real allocator
+#undef malloc
+#undef calloc
+#undef realloc
+#undef free
+
+// Every block starts with its size, so frees can be accounted
+#define HEADER_SIZE 16
+
+BenchAllocStats benchAllocStats;
+
+static void track(long long bytes)
+{
+    benchAllocStats.liveBytes += bytes;
+    if (benchAllocStats.liveBytes > benchAllocStats.peakBytes)
+    {
+        benchAllocStats.peakBytes = benchAllocStats.liveBytes;
+    }
+}
+
+void* benchMalloc(size_t size)
+{
+    char* block = malloc(HEADER_SIZE + size);
+    if (!block)
+    {
+        return NULL;
+    }
+
+    *(size_t*)block = size;
+    benchAllocStats.allocations++;
+    track((long long)size);
+    return block + HEADER_SIZE;
+}
+
+void* benchCalloc(size_t count, size_t size)
+{
+    void* result = benchMalloc(count * size);
+    if (result)
+    {
+        memset(result, 0, count * size);
+    }
+
+    return result;
+}
+
+void* benchRealloc(void* pointer, size_t size)
+{
+    if (!pointer)
+    {
+        return benchMalloc(size);
+    }
+
+    char*  block   = (char*)pointer - HEADER_SIZE;
+    size_t oldSize = *(size_t*)block;
+
+    block = realloc(block, HEADER_SIZE + size);
+    if (!block)
+    {
+        return NULL;
+    }
+
+    *(size_t*)block = size;
+    benchAllocStats.allocations++;
+    track((long long)size - (long long)oldSize);
+    return block + HEADER_SIZE;
+}
+
+void benchFree(void* pointer)
+{
+    if (pointer)
+    {
+        char* block = (char*)pointer - HEADER_SIZE;
+
+        benchAllocStats.frees++;
+        track(-(long long)*(size_t*)block);
+        free(block);
+    }
+}
+
+void benchAllocReset(void)
+{
+    benchAllocStats.allocations = 0;
+    benchAllocStats.frees       = 0;
+    benchAllocStats.peakBytes   = benchAllocStats.liveBytes;
+}
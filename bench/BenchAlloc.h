@@ -0,0 +1,29 @@
+#pragma once
+
+// Force-included (-include) into the code under benchmark, so every allocation is counted.
+// The real headers come first, the macros then only rename the calls.
+
+#include <stdlib.h>
+#include <string.h>
+
+void*       benchMalloc(size_t size);
+void*       benchCalloc(size_t count, size_t size);
+void*       benchRealloc(void* pointer, size_t size);
+void        benchFree(void* pointer);
+
+#define malloc  benchMalloc
+#define calloc  benchCalloc
+#define realloc benchRealloc
+#define free    benchFree
+
+typedef struct BenchAllocStats
+{
+    long long allocations;      // malloc/calloc/realloc calls
+    long long frees;
+    long long liveBytes;
+    long long peakBytes;
+} BenchAllocStats;
+
+extern BenchAllocStats benchAllocStats;
+
+void        benchAllocReset(void);
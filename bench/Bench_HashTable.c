@@ -0,0 +1,491 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include "../include/HashTable.h"
+#include "BenchAlloc.h"
+
+// This file is not force-included, undo the renames from BenchAlloc.h
+// so the harness' own buffers are not counted as table memory.
+#undef malloc
+#undef calloc
+#undef realloc
+#undef free
+
+#ifndef BENCH_BACKEND
+#define BENCH_BACKEND "unknown"
+#endif
+
+#define LATENCY_SAMPLES 100000
+#define LOOKUP_OPS      (1 << 20)
+
+typedef enum Distribution
+{
+    Distribution_Sequential,
+    Distribution_Uniform,
+    Distribution_Zipfian,
+    Distribution_Count,
+} Distribution;
+
+static const char* distributionNames[] = { "sequential", "uniform", "zipfian" };
+
+typedef struct Workload
+{
+    int   count;        // Keys in the table
+    int   keySize;
+    int   valueSize;
+
+    char* keys;         // 2 * count keys, the second half is never inserted (misses)
+    char* value;
+} Workload;
+
+typedef struct Result
+{
+    double    nsPerOp;
+    double    p50;
+    double    p99;
+    double    p999;
+    long long allocations;
+    long long peakBytes;
+} Result;
+
+static uint64_t rngState = 0x9e3779b97f4a7c15ull;
+
+static uint64_t nextRandom(void)
+{
+    // splitmix64
+    uint64_t z = (rngState += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static double nowNs(void)
+{
+    struct timespec ts;
+#ifndef _WIN32
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+    timespec_get(&ts, TIME_UTC);
+#endif
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static long peakRssKb(void)
+{
+#ifndef _WIN32
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+#else
+    return 0;
+#endif
+}
+
+static inline void* keyAt(const Workload* workload, int index)
+{
+    return workload->keys + (size_t)index * workload->keySize;
+}
+
+// Keys look like structured IDs: a shared prefix followed by a hex counter,
+// 8-byte keys are plain sequential integers.
+static void makeKeys(Workload* workload)
+{
+    int total = workload->count * 2;
+    workload->keys = malloc((size_t)total * workload->keySize);
+
+    for (int i = 0; i < total; i++)
+    {
+        char* key = keyAt(workload, i);
+        if (workload->keySize == 8)
+        {
+            uint64_t id = (uint64_t)i;
+            memcpy(key, &id, sizeof(id));
+        }
+        else
+        {
+            char buffer[256];
+            int  length = snprintf(buffer, sizeof(buffer), "tenant/0042/object/%08x", i);
+            memset(key, '_', workload->keySize);
+            if (length > workload->keySize)
+            {
+                // Keep the counter, drop the head of the prefix
+                memcpy(key, buffer + length - workload->keySize, workload->keySize);
+            }
+            else
+            {
+                memcpy(key + workload->keySize - length, buffer, length);
+            }
+        }
+    }
+
+    workload->value = malloc(workload->valueSize);
+    memset(workload->value, 0xab, workload->valueSize);
+}
+
+// Zipfian ranks (theta 0.99) following Gray et al. "Quickly generating billion-record synthetic databases"
+typedef struct Zipfian
+{
+    int    count;
+    double theta;
+    double alpha;
+    double zetan;
+    double eta;
+} Zipfian;
+
+static Zipfian newZipfian(int count)
+{
+    Zipfian zipf;
+    zipf.count = count;
+    zipf.theta = 0.99;
+
+    double zeta2 = 0.0;
+    zipf.zetan   = 0.0;
+    for (int i = 1; i <= count; i++)
+    {
+        zipf.zetan += 1.0 / pow((double)i, zipf.theta);
+        if (i == 2)
+        {
+            zeta2 = zipf.zetan;
+        }
+    }
+
+    zipf.alpha = 1.0 / (1.0 - zipf.theta);
+    zipf.eta   = (1.0 - pow(2.0 / count, 1.0 - zipf.theta)) / (1.0 - zeta2 / zipf.zetan);
+    return zipf;
+}
+
+static int nextZipfian(const Zipfian* zipf)
+{
+    double u  = (double)(nextRandom() >> 11) / (double)(1ull << 53);
+    double uz = u * zipf->zetan;
+
+    int rank;
+    if (uz < 1.0)
+    {
+        rank = 0;
+    }
+    else if (uz < 1.0 + pow(0.5, zipf->theta))
+    {
+        rank = 1;
+    }
+    else
+    {
+        rank = (int)(zipf->count * pow(zipf->eta * u - zipf->eta + 1.0, zipf->alpha));
+    }
+
+    if (rank >= zipf->count)
+    {
+        rank = zipf->count - 1;
+    }
+
+    // Scatter the hot ranks over the key space, so they are not also neighbours in memory
+    return (int)(((uint64_t)rank * 2654435761ull) % (uint64_t)zipf->count);
+}
+
+// Indices into the first half of the keys (hits), offset by count for misses
+static int* makeOrder(int count, int ops, Distribution distribution, int offset)
+{
+    int* order = malloc((size_t)ops * sizeof(int));
+
+    Zipfian zipf;
+    if (distribution == Distribution_Zipfian)
+    {
+        zipf = newZipfian(count);
+    }
+
+    for (int i = 0; i < ops; i++)
+    {
+        switch (distribution)
+        {
+            case Distribution_Sequential:
+                order[i] = i % count;
+                break;
+
+            case Distribution_Uniform:
+                order[i] = (int)(nextRandom() % (uint64_t)count);
+                break;
+
+            default:
+                order[i] = nextZipfian(&zipf);
+                break;
+        }
+
+        order[i] += offset;
+    }
+
+    return order;
+}
+
+static int* makeShuffle(int count)
+{
+    int* order = malloc((size_t)count * sizeof(int));
+    for (int i = 0; i < count; i++)
+    {
+        order[i] = i;
+    }
+
+    for (int i = count - 1; i > 0; i--)
+    {
+        int j = (int)(nextRandom() % (uint64_t)(i + 1));
+        int t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+
+    return order;
+}
+
+static int compareDouble(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void fillPercentiles(Result* result, double* samples, int count)
+{
+    if (count == 0)
+    {
+        result->p50 = result->p99 = result->p999 = 0.0;
+        return;
+    }
+
+    qsort(samples, count, sizeof(double), compareDouble);
+    result->p50  = samples[(int)(count * 0.50)];
+    result->p99  = samples[(int)(count * 0.99)];
+    result->p999 = samples[(int)(count * 0.999)];
+}
+
+static void printResult(const char* operation, const char* distribution, const Workload* workload, const Result* result)
+{
+    printf("%-12s %-10s %-10s %4d %5d %9d %9.1f %9.1f %9.1f %9.1f %12lld %12lld\n",
+        BENCH_BACKEND, operation, distribution, workload->keySize, workload->valueSize, workload->count,
+        result->nsPerOp, result->p50, result->p99, result->p999, result->allocations, result->peakBytes);
+}
+
+static volatile uintptr_t sink;
+
+static int visitEntry(void* context, void* key, int keySize, void* value, int valueSize)
+{
+    (void)context;
+    (void)key;
+    (void)keySize;
+    (void)valueSize;
+
+    sink += (uintptr_t)value;
+    return 0;
+}
+
+typedef enum Operation
+{
+    Operation_Search,
+    Operation_Insert,
+    Operation_Remove,
+} Operation;
+
+static void runOperation(HashTable* table, const Workload* workload, Operation operation, int index)
+{
+    void* key = keyAt(workload, index);
+    switch (operation)
+    {
+        case Operation_Search:
+            sink += (uintptr_t)htSearch(table, key, workload->keySize);
+            break;
+
+        case Operation_Insert:
+            sink += (uintptr_t)htInsert(table, key, workload->keySize, workload->value, workload->valueSize);
+            break;
+
+        case Operation_Remove:
+            htRemove(table, key, workload->keySize);
+            break;
+    }
+}
+
+// Run order[0..ops): the first bulkOps are timed as one loop for ns/op,
+// the rest are timed one by one (up to LATENCY_SAMPLES) for the percentiles.
+static Result measure(HashTable* table, const Workload* workload, Operation operation, const int* order, int ops, int bulkOps)
+{
+    static double samples[LATENCY_SAMPLES];
+
+    Result result;
+    benchAllocReset();
+
+    double start = nowNs();
+    for (int i = 0; i < bulkOps; i++)
+    {
+        runOperation(table, workload, operation, order[i]);
+    }
+    result.nsPerOp = bulkOps > 0 ? (nowNs() - start) / bulkOps : 0.0;
+
+    int sampleCount = 0;
+    for (int i = bulkOps; i < ops && sampleCount < LATENCY_SAMPLES; i++)
+    {
+        double opStart = nowNs();
+        runOperation(table, workload, operation, order[i]);
+        samples[sampleCount++] = nowNs() - opStart;
+    }
+    fillPercentiles(&result, samples, sampleCount);
+
+    result.allocations = benchAllocStats.allocations;
+    result.peakBytes   = benchAllocStats.peakBytes;
+    return result;
+}
+
+static void runWorkload(Workload* workload)
+{
+    int  count   = workload->count;
+    int* inOrder = makeOrder(count, count, Distribution_Sequential, 0);
+
+    // Insert: most keys in bulk, the last ones one by one for latencies
+    int samples = count / 10 < LATENCY_SAMPLES ? count / 10 : LATENCY_SAMPLES;
+    HashTable* table = htNew(count, NULL);
+    Result result = measure(table, workload, Operation_Insert, inOrder, count, count - samples);
+    result.peakBytes = benchAllocStats.liveBytes;
+    printResult("insert", "sequential", workload, &result);
+
+    for (int d = 0; d < Distribution_Count; d++)
+    {
+        int lookups = LOOKUP_OPS + LATENCY_SAMPLES;
+
+        int* hits = makeOrder(count, lookups, (Distribution)d, 0);
+        result = measure(table, workload, Operation_Search, hits, lookups, LOOKUP_OPS);
+        printResult("hit", distributionNames[d], workload, &result);
+
+        int* misses = makeOrder(count, lookups, (Distribution)d, count);
+        result = measure(table, workload, Operation_Search, misses, lookups, LOOKUP_OPS);
+        printResult("miss", distributionNames[d], workload, &result);
+
+        result = measure(table, workload, Operation_Insert, hits, lookups, LOOKUP_OPS);
+        printResult("overwrite", distributionNames[d], workload, &result);
+
+        free(hits);
+        free(misses);
+    }
+
+    // Iteration, reported per entry
+    {
+        benchAllocReset();
+        double start = nowNs();
+        HashTableIter* iter = htIterNew(table);
+        while (htIterNext(iter))
+        {
+            sink += (uintptr_t)htIterGetValue(iter);
+        }
+        htIterFree(iter);
+
+        result = (Result){ (nowNs() - start) / count, 0, 0, 0, benchAllocStats.allocations, benchAllocStats.peakBytes };
+        printResult("iterate", "sequential", workload, &result);
+    }
+
+    // Visitor over the backend's storage, reported per entry
+    {
+        benchAllocReset();
+        double start = nowNs();
+        htForEach(table, visitEntry, NULL);
+
+        result = (Result){ (nowNs() - start) / count, 0, 0, 0, benchAllocStats.allocations, benchAllocStats.peakBytes };
+        printResult("foreach", "sequential", workload, &result);
+    }
+
+    // Remove every key in random order
+    {
+        int* shuffled = makeShuffle(count);
+        result = measure(table, workload, Operation_Remove, shuffled, count, count - samples);
+        printResult("remove", "uniform", workload, &result);
+        free(shuffled);
+    }
+    htFree(table);
+
+    // Bulk construction from arrays, reported per entry
+    {
+        void** keys       = malloc((size_t)count * sizeof(void*));
+        void** values     = malloc((size_t)count * sizeof(void*));
+        int*   keySizes   = malloc((size_t)count * sizeof(int));
+        int*   valueSizes = malloc((size_t)count * sizeof(int));
+        for (int i = 0; i < count; i++)
+        {
+            keys[i]       = keyAt(workload, i);
+            values[i]     = workload->value;
+            keySizes[i]   = workload->keySize;
+            valueSizes[i] = workload->valueSize;
+        }
+
+        benchAllocReset();
+        double start = nowNs();
+        table = htBuildFromArrays(keys, keySizes, values, valueSizes, count, HashTableDuplicates_LastWins, NULL);
+
+        result = (Result){ (nowNs() - start) / count, 0, 0, 0, benchAllocStats.allocations, benchAllocStats.peakBytes };
+        printResult("build", "sequential", workload, &result);
+
+        htFree(table);
+        free(valueSizes);
+        free(keySizes);
+        free(values);
+        free(keys);
+    }
+
+    // Teardown of a full table, reported per entry
+    {
+        table = htNew(count, NULL);
+        for (int i = 0; i < count; i++)
+        {
+            runOperation(table, workload, Operation_Insert, i);
+        }
+
+        benchAllocReset();
+        double start = nowNs();
+        htFree(table);
+
+        result = (Result){ (nowNs() - start) / count, 0, 0, 0, benchAllocStats.frees, benchAllocStats.peakBytes };
+        printResult("teardown", "sequential", workload, &result);
+    }
+
+    free(inOrder);
+}
+
+int main(int argc, char* argv[])
+{
+    // Table sizes from L1 resident up to far beyond the last level cache
+    int maxCount = argc > 1 ? atoi(argv[1]) : (1 << 22);
+    int counts[] = { 1 << 10, 1 << 14, 1 << 18, 1 << 22 };
+
+    int keySizes[]   = { 8, 16, 64 };
+    int valueSizes[] = { 8, 64 };
+
+    printf("%-12s %-10s %-10s %4s %5s %9s %9s %9s %9s %9s %12s %12s\n",
+        "backend", "operation", "keys", "key", "value", "entries", "ns/op", "p50", "p99", "p99.9", "allocs", "peak bytes");
+
+    for (int c = 0; c < (int)(sizeof(counts) / sizeof(counts[0])); c++)
+    {
+        if (counts[c] > maxCount)
+        {
+            break;
+        }
+
+        for (int k = 0; k < (int)(sizeof(keySizes) / sizeof(keySizes[0])); k++)
+        {
+            for (int v = 0; v < (int)(sizeof(valueSizes) / sizeof(valueSizes[0])); v++)
+            {
+                Workload workload = { counts[c], keySizes[k], valueSizes[v], NULL, NULL };
+                makeKeys(&workload);
+
+                runWorkload(&workload);
+
+                free(workload.keys);
+                free(workload.value);
+            }
+        }
+    }
+
+    printf("%-12s peak RSS %ld KiB\n", BENCH_BACKEND, peakRssKb());
+    return 0;
+}
@@ -0,0 +1,32 @@
+#!/bin/sh
+# Build Bench_HashTable.c against every src/HashTable_*.c backend and run the workload matrix.
+# Usage: bench/run.sh [maxEntries]    (CC and CFLAGS are taken from the environment)
+
+set -e
+cd "$(dirname "$0")/.."
+
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:-"-O2 -DNDEBUG -D_POSIX_C_SOURCE=200809L"}
+OUT=${OUT:-bench/out}
+
+mkdir -p "$OUT"
+
+SUPPORT="src/Arena.c src/MurmurHash.c src/Pool.c"
+
+for source in src/HashTable_*.c; do
+    backend=$(basename "$source" .c | sed 's/^HashTable_//')
+
+    # Table code is compiled with BenchAlloc.h forced in, so its allocations are counted
+    objects=""
+    for file in "$source" $SUPPORT; do
+        object="$OUT/$backend-$(basename "$file" .c).o"
+        $CC $CFLAGS -include bench/BenchAlloc.h -c "$file" -o "$object"
+        objects="$objects $object"
+    done
+
+    $CC $CFLAGS -DBENCH_BACKEND="\"$backend\"" $objects bench/BenchAlloc.c bench/Bench_HashTable.c -o "$OUT/bench_$backend" -lm
+done
+
+for binary in "$OUT"/bench_*; do
+    "$binary" "$@"
+done
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+
+// Thread-safe hash table: the key space is split over independently locked shards,
+// each one a HashTable from whichever backend is linked in.
+// Shards use reader/writer locks, so lookups on the same shard run in parallel.
+
+typedef struct ConcurrentHashTable     ConcurrentHashTable;
+typedef struct ConcurrentHashTableIter ConcurrentHashTableIter;
+
+// shardCount is rounded up to a power of two, size is the initial size of each shard
+ConcurrentHashTable*        chtNew(int shardCount, int size, uint64_t (*hashFn)(void*, int));
+void                        chtFree(ConcurrentHashTable* table);
+
+// Values never leave the shard lock by pointer, lookups copy them out instead.
+// chtSearch returns 1 if the key was found. It then copies at most valueSize bytes of the stored
+// value into outValue and stores the full size in outValueSize, either may be NULL.
+// When built with HT_STATS, searches on the same shard are serialized to keep its counters exact.
+void                        chtRemove(ConcurrentHashTable* table, void* key, int keySize);
+int                         chtSearch(ConcurrentHashTable* table, void* key, int keySize, void* outValue, int valueSize, int* outValueSize);
+int                         chtInsert(ConcurrentHashTable* table, void* key, int keySize, void* value, int valueSize);
+
+int                         chtCount(ConcurrentHashTable* table);
+
+// Iteration visits one shard at a time and holds that shard's read lock while on it,
+// so every shard is seen as a consistent snapshot. Writers to the current shard wait,
+// always call chtIterFree, even when stopping early.
+ConcurrentHashTableIter*    chtIterNew(ConcurrentHashTable* table);
+void                        chtIterFree(ConcurrentHashTableIter* iter);
+int                         chtIterNext(ConcurrentHashTableIter* iter);
+void*                       chtIterGetKey(ConcurrentHashTableIter* iter);
+void*                       chtIterGetValue(ConcurrentHashTableIter* iter);
@@ -1,22 +1,138 @@
 #pragma once
 
+#include <stdint.h>
+
 typedef struct HashTable     HashTable;
 typedef struct HashTableIter HashTableIter;
 
-HashTable*      htNew(int size, int (*hashFn)(void*, int, int));
+// Which pair htBuildFromArrays keeps when a key appears more than once
+typedef enum HashTableDuplicates
+{
+    HashTableDuplicates_LastWins,
+    HashTableDuplicates_FirstWins,
+} HashTableDuplicates;
+
+// hashFn returns the full 64-bit hash of a key, the table masks it down to its bucket count itself.
+// It must be well mixed in the low bits, pass NULL to use htHash.
+HashTable*      htNew(int size, uint64_t (*hashFn)(void*, int));
 void            htFree(HashTable* table);
 
+// Same as htNew, but key and value bytes are bump allocated from chunks owned by the table.
+// htFree then releases a handful of chunks instead of every key and value.
+// Removed or overwritten data is not reused until the table is freed.
+HashTable*      htNewArena(int size, uint64_t (*hashFn)(void*, int));
+
+// Same as htNew, but key and value bytes come from size-class pools owned by the table.
+// Removed or overwritten data is reused by later inserts, and htFree releases the pools whole.
+HashTable*      htNewPooled(int size, uint64_t (*hashFn)(void*, int));
+
+// Build a table from parallel arrays in one pass: sized once, keys hashed in a tight loop,
+// and entries laid out grouped by bucket where the backend allows, so chains are contiguous.
+// Returns NULL when out of memory.
+HashTable*      htBuildFromArrays(void** keys, int* keySizes, void** values, int* valueSizes, int count,
+                                  HashTableDuplicates duplicates, uint64_t (*hashFn)(void*, int));
+
+int             htCount(HashTable* table);
+
+// Keys and values are copied into the table, small ones are stored inline in the entry.
+// Returned value pointers stay valid until the next insert or remove on the table.
 void            htRemove(HashTable* table, void* key, int keySize);
 void*           htSearch(HashTable* table, void* key, int keySize);
 void*           htInsert(HashTable* talbe, void* key, int keySize, void* value, int valueSize);
 
-int             htHash(void* key, int keySize, int tableSize);
+// Same as above with the key already hashed by the table's hashFn, for callers that needed
+// the hash themselves. htSearchHashed also stores the value size in outValueSize when not NULL.
+void            htRemoveHashed(HashTable* table, uint64_t hash, void* key, int keySize);
+void*           htSearchHashed(HashTable* table, uint64_t hash, void* key, int keySize, int* outValueSize);
+void*           htInsertHashed(HashTable* table, uint64_t hash, void* key, int keySize, void* value, int valueSize);
+
+// Batched versions of htSearch and htInsert over parallel arrays.
+// Keys are hashed up front and their buckets prefetched, so lookups overlap their cache misses.
+// htSearchBatch stores NULL for missing keys, htInsertBatch returns the number of pairs stored.
+void            htSearchBatch(HashTable* table, void** keys, int* keySizes, int count, void** outValues);
+int             htInsertBatch(HashTable* table, void** keys, int* keySizes, void** values, int* valueSizes, int count);
+
+uint64_t        htHash(void* key, int keySize);
+
+// Number of lengths tracked by HashTableStats.lengthHistogram, the last one counts everything longer
+#define HT_STATS_HISTOGRAM_SIZE 16
+
+typedef struct HashTableStats
+{
+    int         count;
+    int         bucketCount;        // Buckets, or slots for open addressing
+    int         usedBuckets;        // Buckets holding at least one entry, or full slots
+
+    // Chained backends: number of buckets per chain length.
+    // Open addressing: number of entries per probe length (groups or slots visited to reach them).
+    int         lengthHistogram[HT_STATS_HISTOGRAM_SIZE];
 
+    // Hot path counters, only maintained when the backend is compiled with HT_STATS.
+    // Comparisons count the entries looked at, memcmpCalls the ones whose hash and size matched.
+    long long   hits;
+    long long   misses;
+    long long   hitComparisons;
+    long long   missComparisons;
+    long long   memcmpCalls;
+    long long   resizes;
+
+    // Memory by allocation kind, the fields do not overlap and add up to the table's footprint
+    long long   tableBytes;         // The HashTable struct and its bucket or control arrays
+    long long   entryBytes;         // Entry, node or slot arrays, including unused capacity
+    long long   keyBytes;           // Keys too large to be stored inline, when not in an arena or pool
+    long long   valueBytes;         // Values too large to be stored inline, when not in an arena or pool
+    long long   poolBytes;          // Node pool, key/value pool and arena chunks
+} HashTableStats;
+
+void            htGetStats(HashTable* table, HashTableStats* outStats);
+
+// Iterators can live on the stack: htIterInit needs no allocation and no htIterFree.
+// After htIterNext returns 1, key, value and their sizes describe the current entry.
+struct HashTableIter
+{
+    void*   key;
+    void*   value;
+    int     keySize;
+    int     valueSize;
+
+    // Backend state
+    struct
+    {
+        HashTable*  table;
+        void*       node;
+        int         bucket;
+        int         index;
+        int         end;
+    } internal;
+};
+
+void            htIterInit(HashTableIter* iter, HashTable* table);
+
+// Iterator over part [0, partCount) of the table, for splitting a scan across threads.
+// The parts are disjoint and together visit every entry exactly once, as long as
+// the table is not modified while they are in use.
+void            htIterInitRange(HashTableIter* iter, HashTable* table, int part, int partCount);
+
+// Heap allocated versions of htIterInit and htIterInitRange, release with htIterFree
 HashTableIter*  htIterNew(HashTable* table);
+HashTableIter*  htIterNewRange(HashTable* table, int part, int partCount);
 void            htIterFree(HashTableIter* iter);
+
 int             htIterNext(HashTableIter* iter);
 void*           htIterGetKey(HashTableIter* iter);
 void*           htIterGetValue(HashTableIter* iter);
+int             htIterGetKeySize(HashTableIter* iter);
+int             htIterGetValueSize(HashTableIter* iter);
+
+// Call fn on every entry, walking the backend's storage directly.
+// Stops early when fn returns non-zero. The table must not be modified from fn.
+void            htForEach(HashTable* table, int (*fn)(void* context, void* key, int keySize, void* value, int valueSize), void* context);
+
+// for loop over a stack iterator:
+//     HT_FOREACH(iter, table) { use(iter.key, iter.value); }
+#define HT_FOREACH(iter, table)                                                 \
+    for (HashTableIter iter, *iter##Once = &iter; iter##Once; iter##Once = 0)  \
+        for (htIterInit(&iter, table); htIterNext(&iter); )
 
 #define dictRemove(table, key)                      htRemove(table, key, strlen(key) + 1)
 #define dictSearch(table, key)         (const char*)htSearch(table, key, strlen(key) + 1)
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "HashTable.h"
+
+// Read-only hash table served straight from a memory mapped image file.
+// htSave writes the image: a bucket index and entry array holding file offsets instead of
+// pointers, followed by the key and value bytes. htOpenMapped maps it without copying
+// anything, and every process opening the same image shares one copy in the page cache.
+// Opening makes one pass over the bucket index and entries to check their bounds, the key
+// and value bytes are not read until they are looked up.
+//
+// Images are hashed with htHash whatever hashFn the saved table uses, and can only be
+// opened on machines with the same byte order. Returned pointers point into the mapping,
+// values are 8-byte aligned, and stay valid until mhtClose.
+
+typedef struct MappedHashTable     MappedHashTable;
+typedef struct MappedHashTableIter MappedHashTableIter;
+
+// Returns 1 on success. The image is written next to path then renamed over it,
+// so processes that still map the previous image keep a consistent view.
+int                     htSave(HashTable* table, const char* path);
+
+// Returns NULL when the file cannot be mapped or is not a valid image
+MappedHashTable*        htOpenMapped(const char* path);
+void                    mhtClose(MappedHashTable* table);
+
+int                     mhtCount(MappedHashTable* table);
+const void*             mhtSearch(MappedHashTable* table, const void* key, int keySize);
+
+MappedHashTableIter*    mhtIterNew(MappedHashTable* table);
+void                    mhtIterFree(MappedHashTableIter* iter);
+int                     mhtIterNext(MappedHashTableIter* iter);
+const void*             mhtIterGetKey(MappedHashTableIter* iter);
+const void*             mhtIterGetValue(MappedHashTableIter* iter);
+int                     mhtIterGetKeySize(MappedHashTableIter* iter);
+int                     mhtIterGetValueSize(MappedHashTableIter* iter);
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+
+// Read-mostly hash table: readers search an immutable published version without locks
+// and without writing to any shared memory. Writers batch changes into a private draft
+// copy and publish it atomically. Replaced versions are freed once no reader that
+// could still see them is inside a read section (epoch based reclamation).
+
+typedef struct SnapshotHashTable     SnapshotHashTable;
+typedef struct SnapshotReader        SnapshotReader;
+typedef struct SnapshotHashTableIter SnapshotHashTableIter;
+
+SnapshotHashTable*      shtNew(int size, uint64_t (*hashFn)(void*, int));
+void                    shtFree(SnapshotHashTable* table);
+
+// Writers, serialized by a mutex inside the table.
+// Changes go into a draft and are invisible to readers until shtPublish.
+int                     shtInsert(SnapshotHashTable* table, void* key, int keySize, void* value, int valueSize);
+void                    shtRemove(SnapshotHashTable* table, void* key, int keySize);
+void                    shtPublish(SnapshotHashTable* table);
+
+// Readers, one SnapshotReader per thread.
+// Everything returned between shtReadBegin and shtReadEnd comes from the same version
+// and stays valid until shtReadEnd. Keep read sections short, they hold back reclamation.
+SnapshotReader*         shtReaderNew(SnapshotHashTable* table);
+void                    shtReaderFree(SnapshotReader* reader);
+
+void                    shtReadBegin(SnapshotReader* reader);
+void                    shtReadEnd(SnapshotReader* reader);
+
+int                     shtCount(SnapshotReader* reader);
+void*                   shtSearch(SnapshotReader* reader, void* key, int keySize);
+
+SnapshotHashTableIter*  shtIterNew(SnapshotReader* reader);
+void                    shtIterFree(SnapshotHashTableIter* iter);
+int                     shtIterNext(SnapshotHashTableIter* iter);
+void*                   shtIterGetKey(SnapshotHashTableIter* iter);
+void*                   shtIterGetValue(SnapshotHashTableIter* iter);
@@ -0,0 +1,279 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __cplusplus
+#include <utility>
+#endif
+
+// Typed hash tables generated at compile time.
+//
+//     HT_DEFINE(IntMap, int, Point, htHashU32, htEqual)
+//
+// defines the IntMap type and static inline IntMapNew, IntMapFree, IntMapCount,
+// IntMapSearch, IntMapInsert and IntMapRemove. Keys and values are stored by value
+// in fixed size entries and hashFn(key) / eqFn(a, b) are called directly, so the
+// compiler can inline them and specialize every access for the types.
+//
+// The layout is the one of the DOD backend: a dense entry array chained from a
+// power-of-two bucket array. table->entries[0..count) can be walked directly,
+// and returned value pointers stay valid until the next insert or remove.
+// Hashes are not cached, so hashFn should be cheap; rehashing calls it again.
+
+// Finalizer of MurmurHash3: well mixed in every bit, as the bucket mask needs
+static inline uint64_t htHashU64(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ull;
+    key ^= key >> 33;
+    return key;
+}
+
+static inline uint64_t htHashU32(uint32_t key)
+{
+    return htHashU64(key);
+}
+
+#define htEqual(a, b) ((a) == (b))
+
+// Chain routines and load factors expanded by both HT_DEFINE and TypedHashTable.hpp,
+// so the C and C++ tables share one layout and growth policy. Elements of entries need
+// `key` and `next` fields; hashFn(key) and eqFn(a, b) are expanded as written, so they
+// can be functions, macros or C++ functors.
+
+// Same load factors as the DOD backend: grow above 1, shrink below 1/4
+#define HT_GROWS_(count, hashCount)                 ((count) > (hashCount))
+#define HT_SHRINKS_(count, hashCount, minHashCount) ((hashCount) > (minHashCount) && (count) < (hashCount) / 4)
+
+#define HT_BUCKET_OF_(hashFn, hashCount, findKey)   ((int)(hashFn(findKey) & (uint64_t)((hashCount) - 1)))
+
+#ifdef __cplusplus
+#define HT_MOVE_(entry)                             std::move(entry)
+#else
+#define HT_MOVE_(entry)                             (entry)
+#endif
+
+// Index of the entry holding findKey or -1 in outCurr, with its bucket and the entry before it
+#define HT_CHAIN_FIND_(hashs, hashCount, entries, hashFn, eqFn, findKey, outBucket, outPrev, outCurr) \
+    do                                                                                      \
+    {                                                                                       \
+        (outBucket) = HT_BUCKET_OF_(hashFn, hashCount, findKey);                            \
+        (outPrev)   = -1;                                                                   \
+        (outCurr)   = (hashs)[outBucket];                                                   \
+        while ((outCurr) > -1 && !(eqFn((entries)[outCurr].key, findKey)))                  \
+        {                                                                                   \
+            (outPrev) = (outCurr);                                                          \
+            (outCurr) = (entries)[outCurr].next;                                            \
+        }                                                                                   \
+    } while (0)
+
+// Point the link after prev, or the bucket head when prev is -1, at index
+#define HT_CHAIN_LINK_(hashs, entries, bucket, prev, index)                                 \
+    do                                                                                      \
+    {                                                                                       \
+        if ((prev) > -1)                                                                    \
+        {                                                                                   \
+            (entries)[prev].next = (index);                                                 \
+        }                                                                                   \
+        else                                                                                \
+        {                                                                                   \
+            (hashs)[bucket] = (index);                                                      \
+        }                                                                                   \
+    } while (0)
+
+// Take entry curr, found by HT_CHAIN_FIND_, out of its chain and move entry last into
+// the hole. The caller then drops the last entry.
+#define HT_CHAIN_UNLINK_(hashs, hashCount, entries, hashFn, curr, bucket, prev, last)       \
+    do                                                                                      \
+    {                                                                                       \
+        HT_CHAIN_LINK_(hashs, entries, bucket, prev, (entries)[curr].next);                 \
+        if ((curr) < (last))                                                                \
+        {                                                                                   \
+            /* Entries are unique by index, the last one's bucket leads to its link */      \
+            int* link_ = &(hashs)[HT_BUCKET_OF_(hashFn, hashCount, (entries)[last].key)];   \
+            while (*link_ != (last))                                                        \
+            {                                                                               \
+                link_ = &(entries)[*link_].next;                                            \
+            }                                                                               \
+                                                                                            \
+            *link_ = (curr);                                                                \
+            (entries)[curr] = HT_MOVE_((entries)[last]);                                    \
+        }                                                                                   \
+    } while (0)
+
+// Rebuild every chain of a bucket array of hashCount from the keys
+#define HT_CHAIN_RELINK_(hashs, hashCount, entries, count, hashFn)                          \
+    do                                                                                      \
+    {                                                                                       \
+        for (int i_ = 0; i_ < (hashCount); i_++)                                            \
+        {                                                                                   \
+            (hashs)[i_] = -1;                                                               \
+        }                                                                                   \
+                                                                                            \
+        for (int i_ = 0; i_ < (count); i_++)                                                \
+        {                                                                                   \
+            int bucket_ = HT_BUCKET_OF_(hashFn, hashCount, (entries)[i_].key);              \
+            (entries)[i_].next = (hashs)[bucket_];                                          \
+            (hashs)[bucket_] = i_;                                                          \
+        }                                                                                   \
+    } while (0)
+
+#define HT_DEFINE(Name, KeyType, ValueType, hashFn, eqFn)                                   \
+                                                                                            \
+typedef struct Name##Entry                                                                  \
+{                                                                                           \
+    KeyType     key;                                                                        \
+    ValueType   value;                                                                      \
+    int         next;                                                                       \
+} Name##Entry;                                                                              \
+                                                                                            \
+typedef struct Name                                                                         \
+{                                                                                           \
+    int             count;                                                                  \
+    int             capacity;                                                               \
+    Name##Entry*    entries;                                                                \
+                                                                                            \
+    int             minHashCount;                                                           \
+    int             hashCount;                                                              \
+    int*            hashs;                                                                  \
+} Name;                                                                                     \
+                                                                                            \
+static inline Name* Name##New(int size)                                                     \
+{                                                                                           \
+    int hashCount = 1;                                                                      \
+    while (hashCount < size)                                                                \
+    {                                                                                       \
+        hashCount *= 2;                                                                     \
+    }                                                                                       \
+                                                                                            \
+    Name* table = (Name*)malloc(sizeof(Name));                                              \
+    if (!table)                                                                             \
+    {                                                                                       \
+        return NULL;                                                                        \
+    }                                                                                       \
+                                                                                            \
+    table->hashs = (int*)malloc(hashCount * sizeof(int));                                   \
+    if (!table->hashs)                                                                      \
+    {                                                                                       \
+        free(table);                                                                        \
+        return NULL;                                                                        \
+    }                                                                                       \
+                                                                                            \
+    /* All bits set is -1, the empty bucket */                                              \
+    memset(table->hashs, 0xff, hashCount * sizeof(int));                                    \
+    table->hashCount    = hashCount;                                                        \
+    table->minHashCount = hashCount;                                                        \
+    table->count        = 0;                                                                \
+    table->capacity     = 0;                                                                \
+    table->entries      = NULL;                                                             \
+    return table;                                                                           \
+}                                                                                           \
+                                                                                            \
+static inline void Name##Free(Name* table)                                                  \
+{                                                                                           \
+    if (table)                                                                              \
+    {                                                                                       \
+        free(table->entries);                                                               \
+        free(table->hashs);                                                                 \
+        free(table);                                                                        \
+    }                                                                                       \
+}                                                                                           \
+                                                                                            \
+static inline int Name##Count(const Name* table)                                            \
+{                                                                                           \
+    return table->count;                                                                    \
+}                                                                                           \
+                                                                                            \
+static inline void Name##Rehash_(Name* table, int hashCount)                                \
+{                                                                                           \
+    int* hashs = (int*)realloc(table->hashs, hashCount * sizeof(int));                      \
+    if (!hashs)                                                                             \
+    {                                                                                       \
+        /* Keep the old buckets, the table is still valid with longer chains */             \
+        return;                                                                             \
+    }                                                                                       \
+                                                                                            \
+    table->hashs     = hashs;                                                               \
+    table->hashCount = hashCount;                                                           \
+    HT_CHAIN_RELINK_(hashs, hashCount, table->entries, table->count, hashFn);               \
+}                                                                                           \
+                                                                                            \
+static inline ValueType* Name##Search(Name* table, KeyType key)                             \
+{                                                                                           \
+    int bucket;                                                                             \
+    int prev;                                                                               \
+    int curr;                                                                               \
+    HT_CHAIN_FIND_(table->hashs, table->hashCount, table->entries, hashFn, eqFn, key,       \
+                   bucket, prev, curr);                                                     \
+    (void)prev;                                                                             \
+    return curr > -1 ? &table->entries[curr].value : NULL;                                  \
+}                                                                                           \
+                                                                                            \
+static inline ValueType* Name##Insert(Name* table, KeyType key, ValueType value)            \
+{                                                                                           \
+    int bucket;                                                                             \
+    int prev;                                                                               \
+    int curr;                                                                               \
+    HT_CHAIN_FIND_(table->hashs, table->hashCount, table->entries, hashFn, eqFn, key,       \
+                   bucket, prev, curr);                                                     \
+    if (curr > -1)                                                                          \
+    {                                                                                       \
+        table->entries[curr].value = value;                                                 \
+        return &table->entries[curr].value;                                                 \
+    }                                                                                       \
+                                                                                            \
+    if (table->count == table->capacity)                                                    \
+    {                                                                                       \
+        int capacity = table->capacity > 0 ? table->capacity * 2 : 16;                      \
+        Name##Entry* entries = (Name##Entry*)realloc(table->entries, capacity * sizeof(Name##Entry)); \
+        if (!entries)                                                                       \
+        {                                                                                   \
+            return NULL;                                                                    \
+        }                                                                                   \
+                                                                                            \
+        table->entries  = entries;                                                          \
+        table->capacity = capacity;                                                         \
+    }                                                                                       \
+                                                                                            \
+    curr = table->count++;                                                                  \
+    Name##Entry* entry = &table->entries[curr];                                             \
+    entry->key   = key;                                                                     \
+    entry->value = value;                                                                   \
+    entry->next  = -1;                                                                      \
+    HT_CHAIN_LINK_(table->hashs, table->entries, bucket, prev, curr);                       \
+                                                                                            \
+    if (HT_GROWS_(table->count, table->hashCount))                                          \
+    {                                                                                       \
+        Name##Rehash_(table, table->hashCount * 2);                                         \
+    }                                                                                       \
+                                                                                            \
+    return &table->entries[curr].value;                                                     \
+}                                                                                           \
+                                                                                            \
+static inline int Name##Remove(Name* table, KeyType key)                                    \
+{                                                                                           \
+    int bucket;                                                                             \
+    int prev;                                                                               \
+    int curr;                                                                               \
+    HT_CHAIN_FIND_(table->hashs, table->hashCount, table->entries, hashFn, eqFn, key,       \
+                   bucket, prev, curr);                                                     \
+    if (curr < 0)                                                                           \
+    {                                                                                       \
+        return 0;                                                                           \
+    }                                                                                       \
+                                                                                            \
+    int last = --table->count;                                                              \
+    HT_CHAIN_UNLINK_(table->hashs, table->hashCount, table->entries, hashFn,                \
+                     curr, bucket, prev, last);                                             \
+                                                                                            \
+    if (HT_SHRINKS_(table->count, table->hashCount, table->minHashCount))                   \
+    {                                                                                       \
+        Name##Rehash_(table, table->hashCount / 2);                                         \
+    }                                                                                       \
+                                                                                            \
+    return 1;                                                                               \
+}
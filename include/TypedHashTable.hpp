@@ -0,0 +1,137 @@
+#pragma once
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "TypedHashTable.h"
+
+// C++ flavour of HT_DEFINE: the same dense entry array chained from power-of-two buckets,
+// expanded from the same HT_CHAIN_* macros, with the hash and equality functors inlined.
+// Entries live in a std::vector rather than realloc'd memory, so keys and values may be any
+// movable type. Containers throw std::bad_alloc when out of memory.
+
+template <typename Key>
+struct TypedHash
+{
+    uint64_t operator()(const Key& key) const
+    {
+        return htHashU64((uint64_t)key);
+    }
+};
+
+template <typename Key, typename Value, typename Hash = TypedHash<Key>, typename Equal = std::equal_to<Key>>
+class TypedHashTable
+{
+public:
+    struct Entry
+    {
+        Key     key;
+        Value   value;
+        int     next;
+    };
+
+    explicit TypedHashTable(int size = 8)
+    {
+        int hashCount = 1;
+        while (hashCount < size)
+        {
+            hashCount *= 2;
+        }
+
+        minHashCount = hashCount;
+        hashs.assign(hashCount, -1);
+    }
+
+    int count() const
+    {
+        return (int)entries.size();
+    }
+
+    // Pointers stay valid until the next insert or remove
+    Value* search(const Key& key)
+    {
+        int bucket;
+        int prev;
+        int curr;
+        HT_CHAIN_FIND_(hashs, hashCount(), entries, hash, equal, key, bucket, prev, curr);
+        (void)prev;
+        return curr > -1 ? &entries[curr].value : nullptr;
+    }
+
+    Value* insert(const Key& key, const Value& value)
+    {
+        int bucket;
+        int prev;
+        int curr;
+        HT_CHAIN_FIND_(hashs, hashCount(), entries, hash, equal, key, bucket, prev, curr);
+        if (curr > -1)
+        {
+            entries[curr].value = value;
+            return &entries[curr].value;
+        }
+
+        curr = count();
+        entries.push_back(Entry{ key, value, -1 });
+        HT_CHAIN_LINK_(hashs, entries, bucket, prev, curr);
+
+        if (HT_GROWS_(count(), hashCount()))
+        {
+            rehash(hashCount() * 2);
+        }
+
+        return &entries[curr].value;
+    }
+
+    bool remove(const Key& key)
+    {
+        int bucket;
+        int prev;
+        int curr;
+        HT_CHAIN_FIND_(hashs, hashCount(), entries, hash, equal, key, bucket, prev, curr);
+        if (curr < 0)
+        {
+            return false;
+        }
+
+        int last = count() - 1;
+        HT_CHAIN_UNLINK_(hashs, hashCount(), entries, hash, curr, bucket, prev, last);
+        entries.pop_back();
+
+        if (HT_SHRINKS_(count(), hashCount(), minHashCount))
+        {
+            rehash(hashCount() / 2);
+        }
+
+        return true;
+    }
+
+    // fn(key, value) on every entry, in storage order
+    template <typename Fn>
+    void forEach(Fn fn)
+    {
+        for (Entry& entry : entries)
+        {
+            fn(entry.key, entry.value);
+        }
+    }
+
+private:
+    std::vector<Entry>  entries;
+    std::vector<int>    hashs;
+    int                 minHashCount;
+
+    Hash                hash;
+    Equal               equal;
+
+    int hashCount() const
+    {
+        return (int)hashs.size();
+    }
+
+    void rehash(int newHashCount)
+    {
+        hashs.resize(newHashCount);
+        HT_CHAIN_RELINK_(hashs, newHashCount, entries, count(), hash);
+    }
+};
@@ -0,0 +1,93 @@
+#include "Arena.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#define ARENA_MAX_CHUNK     (1 << 20)
+
+struct ArenaChunk
+{
+    struct ArenaChunk* next;
+    int                size;
+    int                used;
+};
+
+// Keep the chunk data aligned
+#define ARENA_HEADER_SIZE   ((sizeof(ArenaChunk) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1))
+
+Arena* arNew(int chunkSize)
+{
+    assert(chunkSize > 0);
+
+    Arena* arena = malloc(sizeof(Arena));
+    if (arena)
+    {
+        arena->chunks    = NULL;
+        arena->chunkSize = chunkSize;
+        arena->reserved  = 0;
+        arena->allocated = 0;
+        arena->wasted    = 0;
+    }
+
+    return arena;
+}
+
+void arFree(Arena* arena)
+{
+    if (arena)
+    {
+        ArenaChunk* chunk = arena->chunks;
+        while (chunk)
+        {
+            ArenaChunk* next = chunk->next;
+            free(chunk);
+            chunk = next;
+        }
+
+        free(arena);
+    }
+}
+
+void* arAlloc(Arena* arena, int size)
+{
+    assert(size > 0);
+
+    size = arRoundSize(size);
+
+    ArenaChunk* chunk = arena->chunks;
+    if (!chunk || chunk->size - chunk->used < size)
+    {
+        int chunkSize = arena->chunkSize;
+        while (chunkSize < size)
+        {
+            chunkSize *= 2;
+        }
+
+        chunk = malloc(ARENA_HEADER_SIZE + chunkSize);
+        if (!chunk)
+        {
+            return NULL;
+        }
+
+        chunk->size = chunkSize;
+        chunk->used = 0;
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+        arena->reserved += ARENA_HEADER_SIZE + chunkSize;
+
+        if (arena->chunkSize < ARENA_MAX_CHUNK)
+        {
+            arena->chunkSize *= 2;
+        }
+    }
+
+    void* result = (char*)chunk + ARENA_HEADER_SIZE + chunk->used;
+    chunk->used += size;
+    arena->allocated += size;
+    return result;
+}
+
+void arWaste(Arena* arena, int size)
+{
+    arena->wasted += arRoundSize(size);
+}
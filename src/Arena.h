@@ -0,0 +1,30 @@
+#pragma once
+
+typedef struct ArenaChunk ArenaChunk;
+
+// Every block is rounded up to a multiple of ARENA_ALIGNMENT bytes
+#define ARENA_ALIGNMENT     16
+
+// Bump allocator over a list of chunks, everything is released at once by arFree.
+// Chunks grow geometrically so a large arena still owns only a handful of them.
+typedef struct Arena
+{
+    ArenaChunk* chunks;
+    int         chunkSize;      // Size of the next chunk to allocate
+
+    long long   reserved;       // Bytes of all chunks, headers included
+    long long   allocated;      // Bytes handed out by arAlloc
+    long long   wasted;         // Bytes handed out but no longer used by the owner
+} Arena;
+
+Arena*      arNew(int chunkSize);
+void        arFree(Arena* arena);
+
+void*       arAlloc(Arena* arena, int size);
+void        arWaste(Arena* arena, int size);
+
+// Bytes arAlloc really takes for a block of size bytes
+static inline int arRoundSize(int size)
+{
+    return (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
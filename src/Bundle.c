@@ -1,6 +1,8 @@
 #include "Bundle.h"
+#include "MurmurHash.h"
 
 #include <assert.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -8,32 +10,167 @@
 #define strdup _strdup
 #endif
 
-static uint64_t hashString(const char* key)
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+typedef SRWLOCK Mutex;
+
+#define MUTEX_INITIALIZER       SRWLOCK_INIT
+#define mutexLock(mutex)        AcquireSRWLockExclusive(mutex)
+#define mutexUnlock(mutex)      ReleaseSRWLockExclusive(mutex)
+#else
+#include <pthread.h>
+
+typedef pthread_mutex_t Mutex;
+
+#define MUTEX_INITIALIZER       PTHREAD_MUTEX_INITIALIZER
+#define mutexLock(mutex)        pthread_mutex_lock(mutex)
+#define mutexUnlock(mutex)      pthread_mutex_unlock(mutex)
+#endif
+
+// Number of items getBatch and setBatch move through each stage together
+#ifndef BUNDLE_BATCH_SIZE
+#define BUNDLE_BATCH_SIZE 16
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <xmmintrin.h>
+#define BUNDLE_PREFETCH(address) _mm_prefetch((const char*)(address), _MM_HINT_T0)
+#else
+#define BUNDLE_PREFETCH(address) __builtin_prefetch(address)
+#endif
+
+typedef struct InternedString
+{
+    uint64_t hash;
+    int      length;
+    char     string[];
+} InternedString;
+
+// Guards the intern table and the children lists of shared shapes,
+// taken only when a key is interned or a bundle moves to another shared shape
+static Mutex globalLock = MUTEX_INITIALIZER;
+
+// Every interned string, open addressing with linear probing.
+// The capacity is a power of two and the table is kept at most half full.
+static struct
+{
+    int              count;
+    int              capacity;
+    InternedString** entries;
+} internTable;
+
+static uint64_t hashString(const char* key, int length)
 {
-    uint64_t result = 0;
+    return murmurHash64((void*)key, length, MURMUR_HASH_SEED);
+}
 
-    int c;
-    while ((c = *key++))
+static int findInterned(const char* key, int length, uint64_t hash)
+{
+    int mask = internTable.capacity - 1;
+    for (int i = (int)(hash & (uint64_t)mask); ; i = (i + 1) & mask)
+    {
+        InternedString* entry = internTable.entries[i];
+        if (!entry || (entry->hash == hash && entry->length == length && memcmp(entry->string, key, length) == 0))
+        {
+            return i;
+        }
+    }
+}
+
+static int growInternTable(void)
+{
+    int capacity = internTable.capacity > 0 ? internTable.capacity * 2 : 64;
+    InternedString** entries = calloc(capacity, sizeof(InternedString*));
+    if (!entries)
     {
-        result ^= (result  | (uint64_t)c);
-        result ^= (result << (uint64_t)32u);
-        result ^= (result >> (uint64_t)32u);
-        result ^= (result >> (uint64_t)32u);
+        return 0;
     }
 
+    InternedString** oldEntries  = internTable.entries;
+    int              oldCapacity = internTable.capacity;
+
+    internTable.entries  = entries;
+    internTable.capacity = capacity;
+    for (int i = 0; i < oldCapacity; i++)
+    {
+        InternedString* entry = oldEntries[i];
+        if (entry)
+        {
+            entries[findInterned(entry->string, entry->length, entry->hash)] = entry;
+        }
+    }
+
+    free(oldEntries);
+    return 1;
+}
+
+static BundleKey globalLocked(const char* key)
+{
+    int length = (int)strlen(key);
+
+    BundleKey result = { NULL, hashString(key, length) };
+    if ((internTable.count + 1) * 2 > internTable.capacity && !growInternTable())
+    {
+        return result;
+    }
+
+    int index = findInterned(key, length, result.hash);
+    InternedString* entry = internTable.entries[index];
+    if (!entry)
+    {
+        entry = malloc(sizeof(InternedString) + length + 1);
+        if (!entry)
+        {
+            return result;
+        }
+
+        entry->hash   = result.hash;
+        entry->length = length;
+        memcpy(entry->string, key, length + 1);
+
+        internTable.entries[index] = entry;
+        internTable.count++;
+    }
+
+    result.string = entry->string;
+    return result;
+}
+
+BundleKey bundleIntern(const char* key)
+{
+    mutexLock(&globalLock);
+    BundleKey result = globalLocked(key);
+    mutexUnlock(&globalLock);
     return result;
 }
 
-static void freeVariantData(Variant* variant)
+static InternedString* internedOf(const char* internedKey)
+{
+    return (InternedString*)(internedKey - offsetof(InternedString, string));
+}
+
+int bundleKeyLength(const char* internedKey)
+{
+    return internedOf(internedKey)->length;
+}
+
+uint64_t bundleKeyHash(const char* internedKey)
 {
-    switch (variant->type)
+    return internedOf(internedKey)->hash;
+}
+
+static void freeVariantData(uint8_t type, Variant* value)
+{
+    switch (type)
     {
         case Type_String:
-            free((char*)variant->asString);
+            free((char*)value->asString);
             break;
 
         case Type_Bundle:
-            freeBundle(variant->asBundle);
+            freeBundle(value->asBundle);
             break;
 
         default:
@@ -41,19 +178,181 @@ static void freeVariantData(Variant* variant)
     }
 }
 
+// Bundles with more keys than this get a shape of their own, so a schema costs at most
+// SHARED_SHAPE_SLOTS shapes of up to SHARED_SHAPE_SLOTS keys
+#define SHARED_SHAPE_SLOTS 64
+
+// Shape of bundles with no key, the root of every transition chain
+static BundleShape emptyShape = { 0, 0, 1, NULL, NULL, NULL, NULL, NULL };
+
+static int shapeSlotOf(const BundleShape* shape, BundleKey key)
+{
+    if (!key.string || shape->slotCount == 0)
+    {
+        return -1;
+    }
+
+    // Interned keys are equal only when their pointers are
+    for (int slot = shape->buckets[key.hash & (uint64_t)(shape->bucketCount - 1)]; slot > -1; slot = shape->next[slot])
+    {
+        if (shape->keys[slot] == key.string)
+        {
+            return slot;
+        }
+    }
+
+    return -1;
+}
+
+// Lookup by plain string for the getters: no trip through the intern table,
+// the stored keys are still ordinary strings
+static int shapeSlotOfString(const BundleShape* shape, const char* key)
+{
+    if (shape->slotCount == 0)
+    {
+        return -1;
+    }
+
+    uint64_t hash = hashString(key, (int)strlen(key));
+    for (int slot = shape->buckets[hash & (uint64_t)(shape->bucketCount - 1)]; slot > -1; slot = shape->next[slot])
+    {
+        if (strcmp(shape->keys[slot], key) == 0)
+        {
+            return slot;
+        }
+    }
+
+    return -1;
+}
+
+static void linkShapeSlot(BundleShape* shape, int slot)
+{
+    int bucket = (int)(bundleKeyHash(shape->keys[slot]) & (uint64_t)(shape->bucketCount - 1));
+    shape->next[slot] = shape->buckets[bucket];
+    shape->buckets[bucket] = slot;
+}
+
+static void indexShape(BundleShape* shape)
+{
+    memset(shape->buckets, 0xff, shape->bucketCount * sizeof(int));
+    for (int slot = 0; slot < shape->slotCount; slot++)
+    {
+        linkShapeSlot(shape, slot);
+    }
+}
+
+// Shape holding the first count keys with room for keyCapacity, header, keys and index in one block.
+// The index is left for the caller to build once the keys are final.
+static BundleShape* newShape(const char* const* keys, int count, int keyCapacity, int shared)
+{
+    int bucketCount = 1;
+    while (bucketCount < keyCapacity)
+    {
+        bucketCount *= 2;
+    }
+
+    BundleShape* shape = malloc(sizeof(BundleShape) + keyCapacity * sizeof(const char*) + (keyCapacity + bucketCount) * sizeof(int));
+    if (!shape)
+    {
+        return NULL;
+    }
+
+    shape->slotCount   = count;
+    shape->bucketCount = bucketCount;
+    shape->shared      = shared;
+    shape->keys        = (const char**)(shape + 1);
+    shape->next        = (int*)(shape->keys + keyCapacity);
+    shape->buckets     = shape->next + keyCapacity;
+    shape->children    = NULL;
+    shape->sibling     = NULL;
+
+    if (count > 0)
+    {
+        memcpy(shape->keys, keys, count * sizeof(const char*));
+    }
+
+    return shape;
+}
+
+static BundleShape* shapeWithLocked(const BundleShape* shape, const char* key)
+{
+    for (BundleShape* child = shape->children; child; child = child->sibling)
+    {
+        if (child->keys[child->slotCount - 1] == key)
+        {
+            return child;
+        }
+    }
+
+    BundleShape* child = newShape(shape->keys, shape->slotCount, shape->slotCount + 1, 1);
+    if (!child)
+    {
+        return NULL;
+    }
+
+    child->keys[child->slotCount++] = key;
+    indexShape(child);
+
+    // Shapes are only ever added to, the const on the parent protects its keys
+    BundleShape* parent = (BundleShape*)shape;
+    child->sibling   = parent->children;
+    parent->children = child;
+    return child;
+}
+
+// Shared shape with the keys of shape followed by key, created on first use.
+// The new shape is complete before it is linked, and the lock publishes it to other threads.
+static BundleShape* shapeWith(const BundleShape* shape, const char* key)
+{
+    mutexLock(&globalLock);
+    BundleShape* child = shapeWithLocked(shape, key);
+    mutexUnlock(&globalLock);
+    return child;
+}
+
+// Move bundle to a copy of its shape that only it uses and changes in place,
+// with room for keyCapacity keys, a power of two
+static int ownShape(Bundle* bundle, int keyCapacity)
+{
+    const BundleShape* shape = bundle->shape;
+
+    BundleShape* owned = newShape(shape->keys, shape->slotCount, keyCapacity, 0);
+    if (!owned)
+    {
+        return 0;
+    }
+
+    indexShape(owned);
+    if (!shape->shared)
+    {
+        free((BundleShape*)shape);
+    }
+
+    bundle->shape = owned;
+    return 1;
+}
+
+BundleField bundleField(const char* key)
+{
+    BundleField field = { bundleIntern(key), NULL, -1 };
+    return field;
+}
+
 Bundle* newBundle(int size)
 {
     assert(size > 0);
-    
-    Bundle* bundle = malloc(sizeof(Bundle) + (size - 1) * sizeof(BundleNode*));
-    bundle->size = size;
-    bundle->count = 0;
 
-    for (int i = 0; i < size; i++)
+    Bundle* bundle = malloc(sizeof(Bundle));
+    if (!bundle)
     {
-        bundle->nodes[i] = NULL;
+        return NULL;
     }
 
+    bundle->shape       = &emptyShape;
+    bundle->values      = NULL;
+    bundle->count       = 0;
+    bundle->capacity    = 0;
+    bundle->minCapacity = size;
     return bundle;
 }
 
@@ -61,303 +360,952 @@ void freeBundle(Bundle* bundle)
 {
     if (bundle)
     {
-        for (int i = 0, n = bundle->size; i < n; i++)
+        uint8_t* types = bundleTypes(bundle);
+        for (int i = 0, n = bundle->count; i < n; i++)
         {
-            BundleNode* node = bundle->nodes[i];
-            if (node)
-            {
-                freeVariantData(&node->value);
-                free(node);
-            }
+            freeVariantData(types[i], &bundle->values[i]);
+        }
+
+        // Shared shapes belong to every bundle with the same keys and are never freed
+        if (!bundle->shape->shared)
+        {
+            free((BundleShape*)bundle->shape);
         }
+
+        free(bundle->values);
+        free(bundle);
     }
 }
 
-void removeBundleNode(Bundle* bundle, const char* key)
+static int resizeSlots(Bundle* bundle, int capacity)
 {
-    int index = (int)(hashString(key) % (uint64_t)bundle->size);
-    BundleNode* currNode = bundle->nodes[index];
-    BundleNode* prevNode = NULL;
-    while (currNode)
+    Variant* values = malloc((size_t)capacity * (sizeof(Variant) + sizeof(uint8_t)));
+    if (!values)
     {
-        if (strcmp(currNode->key, key) == 0)
-        {
-            if (prevNode)
-            {
-                prevNode->next = currNode->next;
-            }
-            else
-            {
-                bundle->nodes[index] = 0;
-            }
-            
-            freeVariantData(&currNode->value);
-            free((char*)currNode->key);
-            free(currNode);
-            return;
-        }
+        return 0;
+    }
 
-        prevNode = currNode;
-        currNode = currNode->next;
+    if (bundle->values)
+    {
+        memcpy(values, bundle->values, (size_t)bundle->count * sizeof(Variant));
+        memcpy(values + capacity, bundleTypes(bundle), (size_t)bundle->count);
+        free(bundle->values);
     }
+
+    bundle->values   = values;
+    bundle->capacity = capacity;
+    return 1;
 }
 
-static BundleNode* searchBundleNode(const Bundle* bundle, const char* key, int createNew)
+// Append a slot for key, moving the bundle to the successor shape. Returns -1 when out of memory.
+static int addSlot(Bundle* bundle, BundleKey key)
 {
-    int index = (int)(hashString(key) % (uint64_t)bundle->size);
-    BundleNode* currNode = (BundleNode*)bundle->nodes[index];
-    BundleNode* prevNode = NULL;
-    while (currNode)
+    if (bundle->count == bundle->capacity
+        && !resizeSlots(bundle, bundle->capacity > 0 ? bundle->capacity * 2 : bundle->minCapacity))
     {
-        if (strcmp(currNode->key, key) == 0)
+        return -1;
+    }
+
+    const BundleShape* shape = bundle->shape;
+    if (shape->shared && shape->slotCount < SHARED_SHAPE_SLOTS)
+    {
+        shape = shapeWith(shape, key.string);
+        if (!shape)
         {
-            return currNode;
+            return -1;
         }
 
-        prevNode = currNode;
-        currNode = currNode->next;
+        bundle->shape = shape;
     }
-
-    if (createNew)
+    else
     {
-        BundleNode* node = malloc(sizeof(BundleNode));
-        node->key = strdup(key);
-        node->value = (Variant){ 0 };
-        node->next = NULL;
-
-        if (prevNode)
+        if ((shape->shared || shape->slotCount == shape->bucketCount) && !ownShape(bundle, shape->bucketCount * 2))
         {
-            prevNode->next = node;
+            return -1;
         }
-        else
+
+        BundleShape* owned = (BundleShape*)bundle->shape;
+        owned->keys[owned->slotCount] = key.string;
+        linkShapeSlot(owned, owned->slotCount++);
+    }
+
+    int slot = bundle->count++;
+    bundle->values[slot] = (Variant){ 0 };
+    bundleTypes(bundle)[slot] = Type_I8;
+    return slot;
+}
+
+static int searchSlot(Bundle* bundle, BundleKey key, int createNew)
+{
+    int slot = shapeSlotOf(bundle->shape, key);
+    if (slot < 0 && createNew && key.string)
+    {
+        slot = addSlot(bundle, key);
+    }
+
+    return slot;
+}
+
+// Keys already in the bundle are found without interning, so overwriting fields never takes the intern lock
+static int searchSlotString(Bundle* bundle, const char* key)
+{
+    int slot = shapeSlotOfString(bundle->shape, key);
+    if (slot < 0)
+    {
+        BundleKey interned = bundleIntern(key);
+        slot = interned.string ? addSlot(bundle, interned) : -1;
+    }
+
+    return slot;
+}
+
+// Owned shapes change in place, only slots of shared shapes can be remembered
+static int fieldSlot(const Bundle* bundle, BundleField* field)
+{
+    if (field->shape == bundle->shape)
+    {
+        return field->slot;
+    }
+
+    int slot = shapeSlotOf(bundle->shape, field->key);
+    if (bundle->shape->shared)
+    {
+        field->shape = bundle->shape;
+        field->slot  = slot;
+    }
+
+    return slot;
+}
+
+static int searchFieldSlot(Bundle* bundle, BundleField* field)
+{
+    int slot = fieldSlot(bundle, field);
+    if (slot < 0 && field->key.string)
+    {
+        slot = addSlot(bundle, field->key);
+
+        // The bundle moved to the successor shape, which the next access will likely see again
+        if (slot > -1 && bundle->shape->shared)
         {
-            ((Bundle*)bundle)->nodes[index] = node;
+            field->shape = bundle->shape;
+            field->slot  = slot;
         }
+    }
+
+    return slot;
+}
 
-        ((Bundle*)bundle)->count++;
-        return node;
+// Release the old value of slot and give it its new type, returns where the new value goes
+static Variant* assignSlot(Bundle* bundle, int slot, Type type)
+{
+    uint8_t* types = bundleTypes(bundle);
+    freeVariantData(types[slot], &bundle->values[slot]);
+    types[slot] = (uint8_t)type;
+    return &bundle->values[slot];
+}
+
+// A removal would otherwise create a shape per remaining key for every order keys are
+// removed in, the bundle takes its own shape instead, as it likely keeps changing
+static void removeSlot(Bundle* bundle, int slot)
+{
+    if (slot < 0 || (bundle->shape->shared && !ownShape(bundle, bundle->shape->bucketCount)))
+    {
+        return;
+    }
+
+    BundleShape* shape = (BundleShape*)bundle->shape;
+    uint8_t*     types = bundleTypes(bundle);
+    freeVariantData(types[slot], &bundle->values[slot]);
+
+    int after = bundle->count - slot - 1;
+    memmove(&bundle->values[slot], &bundle->values[slot + 1], after * sizeof(Variant));
+    memmove(&types[slot], &types[slot + 1], after);
+    memmove(&shape->keys[slot], &shape->keys[slot + 1], after * sizeof(const char*));
+
+    bundle->count--;
+    shape->slotCount--;
+
+    // Slots after the removed one moved down, the index is rebuilt either way
+    if (shape->bucketCount <= 1 || shape->slotCount >= shape->bucketCount / 4 || !ownShape(bundle, shape->bucketCount / 2))
+    {
+        indexShape(shape);
+    }
+
+    if (bundle->capacity > bundle->minCapacity && bundle->count < bundle->capacity / 4)
+    {
+        // Keep the current arrays when they cannot be replaced, they are only larger than needed
+        resizeSlots(bundle, bundle->capacity / 2);
     }
-    
-    return NULL;
+}
+
+void removeBundleNode(Bundle* bundle, const char* key)
+{
+    removeSlot(bundle, shapeSlotOfString(bundle->shape, key));
+}
+
+void removeBundleNodeKey(Bundle* bundle, BundleKey key)
+{
+    removeSlot(bundle, shapeSlotOf(bundle->shape, key));
+}
+
+void removeBundleNodeField(Bundle* bundle, BundleField* field)
+{
+    removeSlot(bundle, fieldSlot(bundle, field));
 }
 
 int8_t getI8(const Bundle* bundle, const char* key)
 {
-    BundleNode* node = searchBundleNode(bundle, key, 0);
-    return node && node->value.type == Type_I8 ? node->value.asI8 : 0;
+    int slot = shapeSlotOfString(bundle->shape, key);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_I8 ? bundle->values[slot].asI8 : 0;
 }
 
 uint8_t getU8(const Bundle* bundle, const char* key)
 {
-    BundleNode* node = searchBundleNode(bundle, key, 0);
-    return node && node->value.type == Type_U8 ? node->value.asU8 : 0;
+    int slot = shapeSlotOfString(bundle->shape, key);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_U8 ? bundle->values[slot].asU8 : 0;
 }
 
 int16_t getI16(const Bundle* bundle, const char* key)
 {
-    BundleNode* node = searchBundleNode(bundle, key, 0);
-    return node && node->value.type == Type_I16 ? node->value.asI16 : 0;
+    int slot = shapeSlotOfString(bundle->shape, key);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_I16 ? bundle->values[slot].asI16 : 0;
 }
 
 uint16_t getU16(const Bundle* bundle, const char* key)
 {
-    BundleNode* node = searchBundleNode(bundle, key, 0);
-    return node && node->value.type == Type_U16 ? node->value.asU16 : 0;
+    int slot = shapeSlotOfString(bundle->shape, key);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_U16 ? bundle->values[slot].asU16 : 0;
 }
 
 int32_t getI32(const Bundle* bundle, const char* key)
 {
-    BundleNode* node = searchBundleNode(bundle, key, 0);
-    return node && node->value.type == Type_I32 ? node->value.asI32 : 0;
+    int slot = shapeSlotOfString(bundle->shape, key);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_I32 ? bundle->values[slot].asI32 : 0;
 }
 
 uint32_t getU32(const Bundle* bundle, const char* key)
 {
-    BundleNode* node = searchBundleNode(bundle, key, 0);
-    return node && node->value.type == Type_U32 ? node->value.asU32 : 0;
+    int slot = shapeSlotOfString(bundle->shape, key);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_U32 ? bundle->values[slot].asU32 : 0;
 }
 
 int64_t getI64(const Bundle* bundle, const char* key)
 {
-    BundleNode* node = searchBundleNode(bundle, key, 0);
-    return node && node->value.type == Type_I64 ? node->value.asI64 : 0;
+    int slot = shapeSlotOfString(bundle->shape, key);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_I64 ? bundle->values[slot].asI64 : 0;
 }
 
 uint64_t getU64(const Bundle* bundle, const char* key)
 {
-    BundleNode* node = searchBundleNode(bundle, key, 0);
-    return node && node->value.type == Type_U64 ? node->value.asU64 : 0;
+    int slot = shapeSlotOfString(bundle->shape, key);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_U64 ? bundle->values[slot].asU64 : 0;
 }
 
 float getFloat(const Bundle* bundle, const char* key)
 {
-    BundleNode* node = searchBundleNode(bundle, key, 0);
-    return node && node->value.type == Type_Float ? node->value.asFloat : 0;
+    int slot = shapeSlotOfString(bundle->shape, key);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_Float ? bundle->values[slot].asFloat : 0;
 }
 
 double getDouble(const Bundle* bundle, const char* key)
 {
-    BundleNode* node = searchBundleNode(bundle, key, 0);
-    return node && node->value.type == Type_Double ? node->value.asDouble : 0;
+    int slot = shapeSlotOfString(bundle->shape, key);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_Double ? bundle->values[slot].asDouble : 0;
 }
 
 const char* getString(const Bundle* bundle, const char* key)
 {
-    BundleNode* node = searchBundleNode(bundle, key, 0);
-    return node && node->value.type == Type_String ? node->value.asString : "";
+    int slot = shapeSlotOfString(bundle->shape, key);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_String ? bundle->values[slot].asString : "";
 }
 
 Bundle* getBundle(const Bundle* bundle, const char* key)
 {
-    BundleNode* node = searchBundleNode(bundle, key, 0);
-    return node && node->value.type == Type_Bundle ? node->value.asBundle : NULL;
+    int slot = shapeSlotOfString(bundle->shape, key);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_Bundle ? bundle->values[slot].asBundle : NULL;
 }
 
 void* getCustom(const Bundle* bundle, const char* key)
 {
-    BundleNode* node = searchBundleNode(bundle, key, 0);
-    return node && node->value.type == Type_Custom ? node->value.asCustom : NULL;
+    int slot = shapeSlotOfString(bundle->shape, key);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_Custom ? bundle->values[slot].asCustom : NULL;
+}
+
+int8_t getI8Key(const Bundle* bundle, BundleKey key)
+{
+    int slot = shapeSlotOf(bundle->shape, key);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_I8 ? bundle->values[slot].asI8 : 0;
+}
+
+uint8_t getU8Key(const Bundle* bundle, BundleKey key)
+{
+    int slot = shapeSlotOf(bundle->shape, key);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_U8 ? bundle->values[slot].asU8 : 0;
+}
+
+int16_t getI16Key(const Bundle* bundle, BundleKey key)
+{
+    int slot = shapeSlotOf(bundle->shape, key);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_I16 ? bundle->values[slot].asI16 : 0;
+}
+
+uint16_t getU16Key(const Bundle* bundle, BundleKey key)
+{
+    int slot = shapeSlotOf(bundle->shape, key);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_U16 ? bundle->values[slot].asU16 : 0;
+}
+
+int32_t getI32Key(const Bundle* bundle, BundleKey key)
+{
+    int slot = shapeSlotOf(bundle->shape, key);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_I32 ? bundle->values[slot].asI32 : 0;
+}
+
+uint32_t getU32Key(const Bundle* bundle, BundleKey key)
+{
+    int slot = shapeSlotOf(bundle->shape, key);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_U32 ? bundle->values[slot].asU32 : 0;
+}
+
+int64_t getI64Key(const Bundle* bundle, BundleKey key)
+{
+    int slot = shapeSlotOf(bundle->shape, key);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_I64 ? bundle->values[slot].asI64 : 0;
+}
+
+uint64_t getU64Key(const Bundle* bundle, BundleKey key)
+{
+    int slot = shapeSlotOf(bundle->shape, key);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_U64 ? bundle->values[slot].asU64 : 0;
+}
+
+float getFloatKey(const Bundle* bundle, BundleKey key)
+{
+    int slot = shapeSlotOf(bundle->shape, key);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_Float ? bundle->values[slot].asFloat : 0;
+}
+
+double getDoubleKey(const Bundle* bundle, BundleKey key)
+{
+    int slot = shapeSlotOf(bundle->shape, key);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_Double ? bundle->values[slot].asDouble : 0;
+}
+
+const char* getStringKey(const Bundle* bundle, BundleKey key)
+{
+    int slot = shapeSlotOf(bundle->shape, key);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_String ? bundle->values[slot].asString : "";
+}
+
+Bundle* getBundleKey(const Bundle* bundle, BundleKey key)
+{
+    int slot = shapeSlotOf(bundle->shape, key);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_Bundle ? bundle->values[slot].asBundle : NULL;
+}
+
+void* getCustomKey(const Bundle* bundle, BundleKey key)
+{
+    int slot = shapeSlotOf(bundle->shape, key);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_Custom ? bundle->values[slot].asCustom : NULL;
+}
+
+int8_t getI8Field(const Bundle* bundle, BundleField* field)
+{
+    int slot = fieldSlot(bundle, field);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_I8 ? bundle->values[slot].asI8 : 0;
+}
+
+uint8_t getU8Field(const Bundle* bundle, BundleField* field)
+{
+    int slot = fieldSlot(bundle, field);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_U8 ? bundle->values[slot].asU8 : 0;
+}
+
+int16_t getI16Field(const Bundle* bundle, BundleField* field)
+{
+    int slot = fieldSlot(bundle, field);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_I16 ? bundle->values[slot].asI16 : 0;
+}
+
+uint16_t getU16Field(const Bundle* bundle, BundleField* field)
+{
+    int slot = fieldSlot(bundle, field);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_U16 ? bundle->values[slot].asU16 : 0;
+}
+
+int32_t getI32Field(const Bundle* bundle, BundleField* field)
+{
+    int slot = fieldSlot(bundle, field);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_I32 ? bundle->values[slot].asI32 : 0;
+}
+
+uint32_t getU32Field(const Bundle* bundle, BundleField* field)
+{
+    int slot = fieldSlot(bundle, field);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_U32 ? bundle->values[slot].asU32 : 0;
+}
+
+int64_t getI64Field(const Bundle* bundle, BundleField* field)
+{
+    int slot = fieldSlot(bundle, field);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_I64 ? bundle->values[slot].asI64 : 0;
+}
+
+uint64_t getU64Field(const Bundle* bundle, BundleField* field)
+{
+    int slot = fieldSlot(bundle, field);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_U64 ? bundle->values[slot].asU64 : 0;
+}
+
+float getFloatField(const Bundle* bundle, BundleField* field)
+{
+    int slot = fieldSlot(bundle, field);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_Float ? bundle->values[slot].asFloat : 0;
+}
+
+double getDoubleField(const Bundle* bundle, BundleField* field)
+{
+    int slot = fieldSlot(bundle, field);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_Double ? bundle->values[slot].asDouble : 0;
+}
+
+const char* getStringField(const Bundle* bundle, BundleField* field)
+{
+    int slot = fieldSlot(bundle, field);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_String ? bundle->values[slot].asString : "";
+}
+
+Bundle* getBundleField(const Bundle* bundle, BundleField* field)
+{
+    int slot = fieldSlot(bundle, field);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_Bundle ? bundle->values[slot].asBundle : NULL;
+}
+
+void* getCustomField(const Bundle* bundle, BundleField* field)
+{
+    int slot = fieldSlot(bundle, field);
+    return slot > -1 && bundleTypes(bundle)[slot] == Type_Custom ? bundle->values[slot].asCustom : NULL;
 }
 
 void setI8(Bundle* bundle, const char* key, int8_t value)
 {
-    BundleNode* node = searchBundleNode(bundle, key, 1);
-    if (node)
+    int slot = searchSlotString(bundle, key);
+    if (slot > -1)
     {
-        freeVariantData(&node->value);
-        node->value.type = Type_I8;
-        node->value.asI8 = value;
+        assignSlot(bundle, slot, Type_I8)->asI8 = value;
     }
 }
 
 void setU8(Bundle* bundle, const char* key, uint8_t value)
 {
-    BundleNode* node = searchBundleNode(bundle, key, 1);
-    if (node)
+    int slot = searchSlotString(bundle, key);
+    if (slot > -1)
     {
-        freeVariantData(&node->value);
-        node->value.type = Type_U8;
-        node->value.asU8 = value;
+        assignSlot(bundle, slot, Type_U8)->asU8 = value;
     }
 }
 
 void setI16(Bundle* bundle, const char* key, int16_t value)
 {
-    BundleNode* node = searchBundleNode(bundle, key, 1);
-    if (node)
+    int slot = searchSlotString(bundle, key);
+    if (slot > -1)
     {
-        freeVariantData(&node->value);
-        node->value.type = Type_I16;
-        node->value.asI16 = value;
+        assignSlot(bundle, slot, Type_I16)->asI16 = value;
     }
 }
 
 void setU16(Bundle* bundle, const char* key, uint16_t value)
 {
-    BundleNode* node = searchBundleNode(bundle, key, 1);
-    if (node)
+    int slot = searchSlotString(bundle, key);
+    if (slot > -1)
     {
-        freeVariantData(&node->value);
-        node->value.type = Type_U16;
-        node->value.asU16 = value;
+        assignSlot(bundle, slot, Type_U16)->asU16 = value;
     }
 }
 
 void setI32(Bundle* bundle, const char* key, int32_t value)
 {
-    BundleNode* node = searchBundleNode(bundle, key, 1);
-    if (node)
+    int slot = searchSlotString(bundle, key);
+    if (slot > -1)
     {
-        freeVariantData(&node->value);
-        node->value.type = Type_I32;
-        node->value.asI32 = value;
+        assignSlot(bundle, slot, Type_I32)->asI32 = value;
     }
 }
 
 void setU32(Bundle* bundle, const char* key, uint32_t value)
 {
-    BundleNode* node = searchBundleNode(bundle, key, 1);
-    if (node)
+    int slot = searchSlotString(bundle, key);
+    if (slot > -1)
     {
-        freeVariantData(&node->value);
-        node->value.type = Type_U32;
-        node->value.asU32 = value;
+        assignSlot(bundle, slot, Type_U32)->asU32 = value;
     }
 }
 
 void setI64(Bundle* bundle, const char* key, int64_t value)
 {
-    BundleNode* node = searchBundleNode(bundle, key, 1);
-    if (node)
+    int slot = searchSlotString(bundle, key);
+    if (slot > -1)
     {
-        freeVariantData(&node->value);
-        node->value.type = Type_I64;
-        node->value.asI64 = value;
+        assignSlot(bundle, slot, Type_I64)->asI64 = value;
     }
 }
 
 void setU64(Bundle* bundle, const char* key, uint64_t value)
 {
-    BundleNode* node = searchBundleNode(bundle, key, 1);
-    if (node)
+    int slot = searchSlotString(bundle, key);
+    if (slot > -1)
     {
-        freeVariantData(&node->value);
-        node->value.type = Type_U64;
-        node->value.asU64 = value;
+        assignSlot(bundle, slot, Type_U64)->asU64 = value;
     }
 }
 
 void setFloat(Bundle* bundle, const char* key, float value)
 {
-    BundleNode* node = searchBundleNode(bundle, key, 1);
-    if (node)
+    int slot = searchSlotString(bundle, key);
+    if (slot > -1)
     {
-        freeVariantData(&node->value);
-        node->value.type = Type_Float;
-        node->value.asFloat = value;
+        assignSlot(bundle, slot, Type_Float)->asFloat = value;
     }
 }
 
 void setDouble(Bundle* bundle, const char* key, double value)
 {
-    BundleNode* node = searchBundleNode(bundle, key, 1);
-    if (node)
+    int slot = searchSlotString(bundle, key);
+    if (slot > -1)
     {
-        freeVariantData(&node->value);
-        node->value.type = Type_Double;
-        node->value.asDouble = value;
+        assignSlot(bundle, slot, Type_Double)->asDouble = value;
     }
 }
 
 void setString(Bundle* bundle, const char* key, const char* value)
 {
-    BundleNode* node = searchBundleNode(bundle, key, 1);
-    if (node)
+    // Copy first: value may be the string being replaced, and a failed copy must not add the key
+    char* copy = strdup(value);
+    if (!copy)
     {
-        freeVariantData(&node->value);
-        node->value.type = Type_String;
-        node->value.asString = strdup(value);
+        return;
     }
+
+    int slot = searchSlotString(bundle, key);
+    if (slot < 0)
+    {
+        free(copy);
+        return;
+    }
+
+    assignSlot(bundle, slot, Type_String)->asString = copy;
 }
 
 void setBundle(Bundle* bundle, const char* key, Bundle* value)
 {
-    BundleNode* node = searchBundleNode(bundle, key, 1);
-    if (node)
+    int slot = searchSlotString(bundle, key);
+    if (slot > -1)
     {
-        freeVariantData(&node->value);
-        node->value.type = Type_Bundle;
-        node->value.asBundle = value;
+        assignSlot(bundle, slot, Type_Bundle)->asBundle = value;
     }
 }
 
 void setCustom(Bundle* bundle, const char* key, void* value)
 {
-    BundleNode* node = searchBundleNode(bundle, key, 1);
-    if (node)
+    int slot = searchSlotString(bundle, key);
+    if (slot > -1)
+    {
+        assignSlot(bundle, slot, Type_Custom)->asCustom = value;
+    }
+}
+
+void setI8Key(Bundle* bundle, BundleKey key, int8_t value)
+{
+    int slot = searchSlot(bundle, key, 1);
+    if (slot > -1)
+    {
+        assignSlot(bundle, slot, Type_I8)->asI8 = value;
+    }
+}
+
+void setU8Key(Bundle* bundle, BundleKey key, uint8_t value)
+{
+    int slot = searchSlot(bundle, key, 1);
+    if (slot > -1)
+    {
+        assignSlot(bundle, slot, Type_U8)->asU8 = value;
+    }
+}
+
+void setI16Key(Bundle* bundle, BundleKey key, int16_t value)
+{
+    int slot = searchSlot(bundle, key, 1);
+    if (slot > -1)
+    {
+        assignSlot(bundle, slot, Type_I16)->asI16 = value;
+    }
+}
+
+void setU16Key(Bundle* bundle, BundleKey key, uint16_t value)
+{
+    int slot = searchSlot(bundle, key, 1);
+    if (slot > -1)
+    {
+        assignSlot(bundle, slot, Type_U16)->asU16 = value;
+    }
+}
+
+void setI32Key(Bundle* bundle, BundleKey key, int32_t value)
+{
+    int slot = searchSlot(bundle, key, 1);
+    if (slot > -1)
+    {
+        assignSlot(bundle, slot, Type_I32)->asI32 = value;
+    }
+}
+
+void setU32Key(Bundle* bundle, BundleKey key, uint32_t value)
+{
+    int slot = searchSlot(bundle, key, 1);
+    if (slot > -1)
+    {
+        assignSlot(bundle, slot, Type_U32)->asU32 = value;
+    }
+}
+
+void setI64Key(Bundle* bundle, BundleKey key, int64_t value)
+{
+    int slot = searchSlot(bundle, key, 1);
+    if (slot > -1)
+    {
+        assignSlot(bundle, slot, Type_I64)->asI64 = value;
+    }
+}
+
+void setU64Key(Bundle* bundle, BundleKey key, uint64_t value)
+{
+    int slot = searchSlot(bundle, key, 1);
+    if (slot > -1)
+    {
+        assignSlot(bundle, slot, Type_U64)->asU64 = value;
+    }
+}
+
+void setFloatKey(Bundle* bundle, BundleKey key, float value)
+{
+    int slot = searchSlot(bundle, key, 1);
+    if (slot > -1)
+    {
+        assignSlot(bundle, slot, Type_Float)->asFloat = value;
+    }
+}
+
+void setDoubleKey(Bundle* bundle, BundleKey key, double value)
+{
+    int slot = searchSlot(bundle, key, 1);
+    if (slot > -1)
+    {
+        assignSlot(bundle, slot, Type_Double)->asDouble = value;
+    }
+}
+
+void setStringKey(Bundle* bundle, BundleKey key, const char* value)
+{
+    // Copy first: value may be the string being replaced, and a failed copy must not add the key
+    char* copy = strdup(value);
+    if (!copy)
+    {
+        return;
+    }
+
+    int slot = searchSlot(bundle, key, 1);
+    if (slot < 0)
+    {
+        free(copy);
+        return;
+    }
+
+    assignSlot(bundle, slot, Type_String)->asString = copy;
+}
+
+void setBundleKey(Bundle* bundle, BundleKey key, Bundle* value)
+{
+    int slot = searchSlot(bundle, key, 1);
+    if (slot > -1)
+    {
+        assignSlot(bundle, slot, Type_Bundle)->asBundle = value;
+    }
+}
+
+void setCustomKey(Bundle* bundle, BundleKey key, void* value)
+{
+    int slot = searchSlot(bundle, key, 1);
+    if (slot > -1)
+    {
+        assignSlot(bundle, slot, Type_Custom)->asCustom = value;
+    }
+}
+
+void setI8Field(Bundle* bundle, BundleField* field, int8_t value)
+{
+    int slot = searchFieldSlot(bundle, field);
+    if (slot > -1)
+    {
+        assignSlot(bundle, slot, Type_I8)->asI8 = value;
+    }
+}
+
+void setU8Field(Bundle* bundle, BundleField* field, uint8_t value)
+{
+    int slot = searchFieldSlot(bundle, field);
+    if (slot > -1)
+    {
+        assignSlot(bundle, slot, Type_U8)->asU8 = value;
+    }
+}
+
+void setI16Field(Bundle* bundle, BundleField* field, int16_t value)
+{
+    int slot = searchFieldSlot(bundle, field);
+    if (slot > -1)
+    {
+        assignSlot(bundle, slot, Type_I16)->asI16 = value;
+    }
+}
+
+void setU16Field(Bundle* bundle, BundleField* field, uint16_t value)
+{
+    int slot = searchFieldSlot(bundle, field);
+    if (slot > -1)
+    {
+        assignSlot(bundle, slot, Type_U16)->asU16 = value;
+    }
+}
+
+void setI32Field(Bundle* bundle, BundleField* field, int32_t value)
+{
+    int slot = searchFieldSlot(bundle, field);
+    if (slot > -1)
+    {
+        assignSlot(bundle, slot, Type_I32)->asI32 = value;
+    }
+}
+
+void setU32Field(Bundle* bundle, BundleField* field, uint32_t value)
+{
+    int slot = searchFieldSlot(bundle, field);
+    if (slot > -1)
+    {
+        assignSlot(bundle, slot, Type_U32)->asU32 = value;
+    }
+}
+
+void setI64Field(Bundle* bundle, BundleField* field, int64_t value)
+{
+    int slot = searchFieldSlot(bundle, field);
+    if (slot > -1)
+    {
+        assignSlot(bundle, slot, Type_I64)->asI64 = value;
+    }
+}
+
+void setU64Field(Bundle* bundle, BundleField* field, uint64_t value)
+{
+    int slot = searchFieldSlot(bundle, field);
+    if (slot > -1)
+    {
+        assignSlot(bundle, slot, Type_U64)->asU64 = value;
+    }
+}
+
+void setFloatField(Bundle* bundle, BundleField* field, float value)
+{
+    int slot = searchFieldSlot(bundle, field);
+    if (slot > -1)
+    {
+        assignSlot(bundle, slot, Type_Float)->asFloat = value;
+    }
+}
+
+void setDoubleField(Bundle* bundle, BundleField* field, double value)
+{
+    int slot = searchFieldSlot(bundle, field);
+    if (slot > -1)
+    {
+        assignSlot(bundle, slot, Type_Double)->asDouble = value;
+    }
+}
+
+void setStringField(Bundle* bundle, BundleField* field, const char* value)
+{
+    // Copy first: value may be the string being replaced, and a failed copy must not add the key
+    char* copy = strdup(value);
+    if (!copy)
+    {
+        return;
+    }
+
+    int slot = searchFieldSlot(bundle, field);
+    if (slot < 0)
+    {
+        free(copy);
+        return;
+    }
+
+    assignSlot(bundle, slot, Type_String)->asString = copy;
+}
+
+void setBundleField(Bundle* bundle, BundleField* field, Bundle* value)
+{
+    int slot = searchFieldSlot(bundle, field);
+    if (slot > -1)
+    {
+        assignSlot(bundle, slot, Type_Bundle)->asBundle = value;
+    }
+}
+
+void setCustomField(Bundle* bundle, BundleField* field, void* value)
+{
+    int slot = searchFieldSlot(bundle, field);
+    if (slot > -1)
     {
-        freeVariantData(&node->value);
-        node->value.type = Type_Custom;
-        node->value.asCustom = value;
+        assignSlot(bundle, slot, Type_Custom)->asCustom = value;
     }
 }
+
+BundleBatchItem bundleBatchItem(const char* key, Type type, void* value)
+{
+    BundleBatchItem item = { bundleField(key), type, value };
+    return item;
+}
+
+// Start loading the buckets of the fields that are not resolved for shape yet
+static void prefetchFieldBuckets(const BundleShape* shape, const BundleBatchItem* items, int count)
+{
+    if (shape->slotCount == 0)
+    {
+        return;
+    }
+
+    uint64_t mask = (uint64_t)(shape->bucketCount - 1);
+    for (int i = 0; i < count; i++)
+    {
+        if (items[i].field.shape != shape && items[i].field.key.string)
+        {
+            BUNDLE_PREFETCH(&shape->buckets[items[i].field.key.hash & mask]);
+        }
+    }
+}
+
+static const Variant missingValue;
+
+// Store the value of slot in out, or the default of type when it holds something else
+static int readSlot(const Bundle* bundle, int slot, Type type, void* out)
+{
+    int            found = slot > -1 && bundleTypes(bundle)[slot] == type;
+    const Variant* value = found ? &bundle->values[slot] : &missingValue;
+    switch (type)
+    {
+        case Type_I8:       *(int8_t*)out      = value->asI8;       break;
+        case Type_U8:       *(uint8_t*)out     = value->asU8;       break;
+        case Type_I16:      *(int16_t*)out     = value->asI16;      break;
+        case Type_U16:      *(uint16_t*)out    = value->asU16;      break;
+        case Type_I32:      *(int32_t*)out     = value->asI32;      break;
+        case Type_U32:      *(uint32_t*)out    = value->asU32;      break;
+        case Type_I64:      *(int64_t*)out     = value->asI64;      break;
+        case Type_U64:      *(uint64_t*)out    = value->asU64;      break;
+        case Type_Float:    *(float*)out       = value->asFloat;    break;
+        case Type_Double:   *(double*)out      = value->asDouble;   break;
+        case Type_String:   *(const char**)out = found ? value->asString : ""; break;
+        case Type_Bundle:   *(Bundle**)out     = value->asBundle;   break;
+        case Type_Custom:   *(void**)out       = value->asCustom;   break;
+    }
+
+    return found;
+}
+
+static int writeField(Bundle* bundle, BundleField* field, Type type, const void* in)
+{
+    // Copy first: the value may be the string being replaced, and a failed copy must not add the key
+    char* copy = NULL;
+    if (type == Type_String)
+    {
+        copy = strdup(*(const char* const*)in);
+        if (!copy)
+        {
+            return 0;
+        }
+    }
+
+    int slot = searchFieldSlot(bundle, field);
+    if (slot < 0)
+    {
+        free(copy);
+        return 0;
+    }
+
+    switch (type)
+    {
+        case Type_I8:       assignSlot(bundle, slot, type)->asI8     = *(const int8_t*)in;      break;
+        case Type_U8:       assignSlot(bundle, slot, type)->asU8     = *(const uint8_t*)in;     break;
+        case Type_I16:      assignSlot(bundle, slot, type)->asI16    = *(const int16_t*)in;     break;
+        case Type_U16:      assignSlot(bundle, slot, type)->asU16    = *(const uint16_t*)in;    break;
+        case Type_I32:      assignSlot(bundle, slot, type)->asI32    = *(const int32_t*)in;     break;
+        case Type_U32:      assignSlot(bundle, slot, type)->asU32    = *(const uint32_t*)in;    break;
+        case Type_I64:      assignSlot(bundle, slot, type)->asI64    = *(const int64_t*)in;     break;
+        case Type_U64:      assignSlot(bundle, slot, type)->asU64    = *(const uint64_t*)in;    break;
+        case Type_Float:    assignSlot(bundle, slot, type)->asFloat  = *(const float*)in;       break;
+        case Type_Double:   assignSlot(bundle, slot, type)->asDouble = *(const double*)in;      break;
+        case Type_Bundle:   assignSlot(bundle, slot, type)->asBundle = *(Bundle* const*)in;     break;
+        case Type_String:   assignSlot(bundle, slot, type)->asString = copy;                    break;
+        case Type_Custom:   assignSlot(bundle, slot, type)->asCustom = *(void* const*)in;       break;
+    }
+
+    return 1;
+}
+
+int getBatch(const Bundle* bundle, BundleBatchItem* items, int count)
+{
+    int slots[BUNDLE_BATCH_SIZE];
+    int found = 0;
+
+    for (int base = 0; base < count; base += BUNDLE_BATCH_SIZE)
+    {
+        int n = count - base < BUNDLE_BATCH_SIZE ? count - base : BUNDLE_BATCH_SIZE;
+
+        prefetchFieldBuckets(bundle->shape, &items[base], n);
+
+        // Resolve every slot and start loading its value
+        for (int i = 0; i < n; i++)
+        {
+            slots[i] = fieldSlot(bundle, &items[base + i].field);
+            if (slots[i] > -1)
+            {
+                BUNDLE_PREFETCH(&bundle->values[slots[i]]);
+            }
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            found += readSlot(bundle, slots[i], items[base + i].type, items[base + i].value);
+        }
+    }
+
+    return found;
+}
+
+int setBatch(Bundle* bundle, BundleBatchItem* items, int count)
+{
+    int stored = 0;
+
+    for (int base = 0; base < count; base += BUNDLE_BATCH_SIZE)
+    {
+        int n = count - base < BUNDLE_BATCH_SIZE ? count - base : BUNDLE_BATCH_SIZE;
+
+        prefetchFieldBuckets(bundle->shape, &items[base], n);
+
+        // New keys move the bundle to another shape and may move its values, so slots are taken one at a time
+        for (int i = 0; i < n; i++)
+        {
+            BundleBatchItem* item = &items[base + i];
+            stored += writeField(bundle, &item->field, item->type, item->value);
+        }
+    }
+
+    return stored;
+}
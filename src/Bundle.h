@@ -19,46 +19,100 @@ typedef enum Type
     Type_Custom,
 } Type;
 
-typedef struct Variant
+// Payload of a slot, its Type is kept in a separate byte array
+typedef union Variant
 {
-    Type type;
-    union
-    {
-        int8_t          asI8;
-        uint8_t         asU8;
-        int16_t         asI16;
-        uint16_t        asU16;
-        int32_t         asI32;
-        uint32_t        asU32;
-        int64_t         asI64;
-        uint64_t        asU64;
-        float           asFloat;
-        double          asDouble;
-        const char*     asString;
-        struct Bundle*  asBundle;
-        void*           asCustom;
-    };
+    int8_t          asI8;
+    uint8_t         asU8;
+    int16_t         asI16;
+    uint16_t        asU16;
+    int32_t         asI32;
+    uint32_t        asU32;
+    int64_t         asI64;
+    uint64_t        asU64;
+    float           asFloat;
+    double          asDouble;
+    const char*     asString;
+    struct Bundle*  asBundle;
+    void*           asCustom;
 } Variant;
 
-typedef struct BundleNode
+// Interned key: a canonical copy of the string shared by every bundle, and its hash.
+// Lookups by BundleKey skip hashing and compare keys by pointer, so intern the
+// field names once and reuse them. The string-keyed functions intern on the fly.
+// Interning is thread safe, behind a global lock that the string-keyed setters only take
+// to add a key that is not in the bundle yet. A single bundle still needs external locking.
+// Interned strings are never freed: keys made from data, such as ids or user input, grow
+// the intern table without bound and are better stored as values.
+typedef struct BundleKey
 {
-    const char* key;
-    Variant     value;
+    const char* string;     // NULL when interning ran out of memory
+    uint64_t    hash;
+} BundleKey;
 
-    struct BundleNode* next;
-} BundleNode;
+BundleKey       bundleIntern(const char* key);
 
+// Length and hash of a key held by a node, kept with the interned string
+int             bundleKeyLength(const char* internedKey);
+uint64_t        bundleKeyHash(const char* internedKey);
+
+// Keys of a bundle and the slots holding their values, in the order they were set.
+// Shared shapes are immutable and used by every bundle whose keys were set in the same order:
+// setting a new key moves the bundle to the successor shape with that key appended,
+// created once and cached in the children of its predecessor.
+// A bundle that removes a key or grows past 64 keys gets a shape of its own instead, changed in place.
+// Like interned strings, shared shapes live until the end of the program, and they are created
+// under the same global lock, so separate bundles can be built on separate threads.
+typedef struct BundleShape
+{
+    int                 slotCount;
+    int                 bucketCount;    // Power of two, at least slotCount, also the key capacity of owned shapes
+    int                 shared;         // 0 for a shape owned by a single bundle
+
+    const char**        keys;           // Interned, slot order
+    int*                next;           // Next slot of the same bucket, -1 at the end
+    int*                buckets;        // First slot of each bucket
+
+    struct BundleShape* children;       // Shapes with one more key
+    struct BundleShape* sibling;
+} BundleShape;
+
+// Values live in a flat array indexed by the slots of the shape, types in a byte array after them.
+// The arrays double when full and halve when below a quarter full, allocated on the first set.
 typedef struct Bundle
 {
-    int size;
-    int count;
+    const BundleShape*  shape;
+    Variant*            values;         // Followed by uint8_t types[capacity]
 
-    BundleNode* nodes[1];
+    int                 count;          // Same as shape->slotCount
+    int                 capacity;
+    int                 minCapacity;    // Size given to newBundle, never shrinks below it
 } Bundle;
 
+// Type of each slot of bundle, as a uint8_t Type
+static inline uint8_t* bundleTypes(const Bundle* bundle)
+{
+    return (uint8_t*)(bundle->values + bundle->capacity);
+}
+
+// Key with the slot it resolved to in the last shape it was used with.
+// Bundles of one schema share their shape, so repeated accesses through the same field
+// skip the key lookup and become an indexed load. Keep one per call site or per schema.
+typedef struct BundleField
+{
+    BundleKey           key;
+    const BundleShape*  shape;
+    int                 slot;           // -1 when the key is not in shape
+} BundleField;
+
+BundleField     bundleField(const char* key);
+
+// size is the number of fields expected, the bundle grows past it as needed
 Bundle*         newBundle(int size);
 void            freeBundle(Bundle* bundle);
 void            removeBundleNode(Bundle* bundle, const char* key);
+void            removeBundleNodeKey(Bundle* bundle, BundleKey key);
+void            removeBundleNodeField(Bundle* bundle, BundleField* field);
 
 int8_t          getI8(const Bundle* bundle, const char* key);
 uint8_t         getU8(const Bundle* bundle, const char* key);
@@ -74,6 +128,34 @@ const char*     getString(const Bundle* bundle, const char* key);
 Bundle*         getBundle(const Bundle* bundle, const char* key);
 void*           getCustom(const Bundle* bundle, const char* key);
 
+int8_t          getI8Key(const Bundle* bundle, BundleKey key);
+uint8_t         getU8Key(const Bundle* bundle, BundleKey key);
+int16_t         getI16Key(const Bundle* bundle, BundleKey key);
+uint16_t        getU16Key(const Bundle* bundle, BundleKey key);
+int32_t         getI32Key(const Bundle* bundle, BundleKey key);
+uint32_t        getU32Key(const Bundle* bundle, BundleKey key);
+int64_t         getI64Key(const Bundle* bundle, BundleKey key);
+uint64_t        getU64Key(const Bundle* bundle, BundleKey key);
+float           getFloatKey(const Bundle* bundle, BundleKey key);
+double          getDoubleKey(const Bundle* bundle, BundleKey key);
+const char*     getStringKey(const Bundle* bundle, BundleKey key);
+Bundle*         getBundleKey(const Bundle* bundle, BundleKey key);
+void*           getCustomKey(const Bundle* bundle, BundleKey key);
+
+int8_t          getI8Field(const Bundle* bundle, BundleField* field);
+uint8_t         getU8Field(const Bundle* bundle, BundleField* field);
+int16_t         getI16Field(const Bundle* bundle, BundleField* field);
+uint16_t        getU16Field(const Bundle* bundle, BundleField* field);
+int32_t         getI32Field(const Bundle* bundle, BundleField* field);
+uint32_t        getU32Field(const Bundle* bundle, BundleField* field);
+int64_t         getI64Field(const Bundle* bundle, BundleField* field);
+uint64_t        getU64Field(const Bundle* bundle, BundleField* field);
+float           getFloatField(const Bundle* bundle, BundleField* field);
+double          getDoubleField(const Bundle* bundle, BundleField* field);
+const char*     getStringField(const Bundle* bundle, BundleField* field);
+Bundle*         getBundleField(const Bundle* bundle, BundleField* field);
+void*           getCustomField(const Bundle* bundle, BundleField* field);
+
 void            setI8(Bundle* bundle, const char* key, int8_t value);
 void            setU8(Bundle* bundle, const char* key, uint8_t value);
 void            setI16(Bundle* bundle, const char* key, int16_t value);
@@ -87,3 +169,50 @@ void            setDouble(Bundle* bundle, const char* key, double value);
 void            setString(Bundle* bundle, const char* key, const char* value);
 void            setBundle(Bundle* bundle, const char* key, Bundle* value);
 void            setCustom(Bundle* bundle, const char* key, void* value);
+
+void            setI8Key(Bundle* bundle, BundleKey key, int8_t value);
+void            setU8Key(Bundle* bundle, BundleKey key, uint8_t value);
+void            setI16Key(Bundle* bundle, BundleKey key, int16_t value);
+void            setU16Key(Bundle* bundle, BundleKey key, uint16_t value);
+void            setI32Key(Bundle* bundle, BundleKey key, int32_t value);
+void            setU32Key(Bundle* bundle, BundleKey key, uint32_t value);
+void            setI64Key(Bundle* bundle, BundleKey key, int64_t value);
+void            setU64Key(Bundle* bundle, BundleKey key, uint64_t value);
+void            setFloatKey(Bundle* bundle, BundleKey key, float value);
+void            setDoubleKey(Bundle* bundle, BundleKey key, double value);
+void            setStringKey(Bundle* bundle, BundleKey key, const char* value);
+void            setBundleKey(Bundle* bundle, BundleKey key, Bundle* value);
+void            setCustomKey(Bundle* bundle, BundleKey key, void* value);
+
+void            setI8Field(Bundle* bundle, BundleField* field, int8_t value);
+void            setU8Field(Bundle* bundle, BundleField* field, uint8_t value);
+void            setI16Field(Bundle* bundle, BundleField* field, int16_t value);
+void            setU16Field(Bundle* bundle, BundleField* field, uint16_t value);
+void            setI32Field(Bundle* bundle, BundleField* field, int32_t value);
+void            setU32Field(Bundle* bundle, BundleField* field, uint32_t value);
+void            setI64Field(Bundle* bundle, BundleField* field, int64_t value);
+void            setU64Field(Bundle* bundle, BundleField* field, uint64_t value);
+void            setFloatField(Bundle* bundle, BundleField* field, float value);
+void            setDoubleField(Bundle* bundle, BundleField* field, double value);
+void            setStringField(Bundle* bundle, BundleField* field, const char* value);
+void            setBundleField(Bundle* bundle, BundleField* field, Bundle* value);
+void            setCustomField(Bundle* bundle, BundleField* field, void* value);
+
+// One value of a batch: its field, the Type it is expected to hold, and the variable it is read
+// into or written from, of that type (int32_t* for Type_I32, const char** for Type_String...).
+// Keep the items of a decode or encode path around, their fields remember slots between calls.
+typedef struct BundleBatchItem
+{
+    BundleField         field;
+    Type                type;
+    void*               value;
+} BundleBatchItem;
+
+BundleBatchItem bundleBatchItem(const char* key, Type type, void* value);
+
+// Get or set every item in one pass. Items whose field already matches the shape of the bundle
+// skip the lookup, the others have their buckets prefetched first so the lookups overlap.
+// getBatch stores the usual default for missing or mistyped keys and returns the number found,
+// setBatch returns the number of values stored.
+int             getBatch(const Bundle* bundle, BundleBatchItem* items, int count);
+int             setBatch(Bundle* bundle, BundleBatchItem* items, int count);
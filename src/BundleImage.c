@@ -0,0 +1,720 @@
+#include "BundleImage.h"
+#include "MurmurHash.h"
+
+#include <string.h>
+
+// Image layout, every section starts on an IMAGE_ALIGNMENT boundary:
+//   BundleImageHeader
+//   root block
+//
+// Block layout:
+//   BundleImageBlock                        count and bucketCount
+//   uint32_t           buckets[bucketCount + 1]   first entry of each bucket, the last one is count
+//   BundleImageEntry   entries[count]       sorted by bucket
+//   for each entry, in entry order: the key, then the string or the child block it holds
+//
+// Keys and strings are NUL terminated, all offsets are from the image start.
+#define IMAGE_MAGIC         "BUNDLE1"
+#define IMAGE_VERSION       2
+#define IMAGE_BYTE_ORDER    0x01020304u
+#define IMAGE_ALIGNMENT     8
+#define IMAGE_MAX_SIZE      0xffffffffull
+#define IMAGE_MAX_DEPTH     64
+
+typedef struct BundleImageHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t byteOrder;     // Reads back differently on a machine with the other byte order
+
+    uint64_t size;
+    uint64_t rootOffset;
+} BundleImageHeader;
+
+typedef struct BundleImageBlock
+{
+    uint32_t count;
+    uint32_t bucketCount;   // Power of two
+    uint32_t buckets[];
+} BundleImageBlock;
+
+typedef struct BundleImageEntry
+{
+    uint64_t hash;
+    uint32_t keyOffset;
+    uint32_t keySize;       // Without the terminating NUL
+    uint32_t type;
+    uint32_t valueSize;     // String length
+    uint64_t value;         // Scalar bits, or the offset of the string or child block, 0 for a NULL bundle
+} BundleImageEntry;
+
+static inline uint64_t alignOffset(uint64_t offset)
+{
+    return (offset + IMAGE_ALIGNMENT - 1) & ~(uint64_t)(IMAGE_ALIGNMENT - 1);
+}
+
+static uint32_t bucketCountOf(int count)
+{
+    uint32_t bucketCount = 1;
+    while (bucketCount < (uint32_t)count)
+    {
+        bucketCount *= 2;
+    }
+
+    return bucketCount;
+}
+
+static inline uint64_t entriesOffsetOf(uint32_t bucketCount)
+{
+    return alignOffset(sizeof(BundleImageBlock) + ((uint64_t)bucketCount + 1) * sizeof(uint32_t));
+}
+
+static int scalarSizeOf(Type type)
+{
+    switch (type)
+    {
+        case Type_I8:
+        case Type_U8:
+            return 1;
+
+        case Type_I16:
+        case Type_U16:
+            return 2;
+
+        case Type_I32:
+        case Type_U32:
+        case Type_Float:
+            return 4;
+
+        case Type_I64:
+        case Type_U64:
+        case Type_Double:
+            return 8;
+
+        default:
+            return 0;
+    }
+}
+
+static int encodedCountOf(const Bundle* bundle)
+{
+    const uint8_t* types = bundleTypes(bundle);
+
+    int count = 0;
+    for (int i = 0; i < bundle->count; i++)
+    {
+        count += types[i] != Type_Custom;
+    }
+
+    return count;
+}
+
+static uint64_t blockSize(const Bundle* bundle, int depth)
+{
+    if (depth >= IMAGE_MAX_DEPTH)
+    {
+        return IMAGE_MAX_SIZE + 1;
+    }
+
+    int count = encodedCountOf(bundle);
+
+    const uint8_t* types = bundleTypes(bundle);
+
+    uint64_t size = entriesOffsetOf(bucketCountOf(count)) + (uint64_t)count * sizeof(BundleImageEntry);
+    for (int i = 0; i < bundle->count; i++)
+    {
+        const Variant* variant = &bundle->values[i];
+        if (types[i] == Type_Custom)
+        {
+            continue;
+        }
+
+        size += alignOffset((uint64_t)bundleKeyLength(bundle->shape->keys[i]) + 1);
+
+        if (types[i] == Type_String)
+        {
+            size += alignOffset(strlen(variant->asString) + 1);
+        }
+        else if (types[i] == Type_Bundle && variant->asBundle)
+        {
+            size += blockSize(variant->asBundle, depth + 1);
+        }
+    }
+
+    return size;
+}
+
+uint64_t bundleImageSize(const Bundle* bundle)
+{
+    uint64_t size = alignOffset(sizeof(BundleImageHeader)) + blockSize(bundle, 0);
+    return size <= IMAGE_MAX_SIZE ? size : 0;
+}
+
+// Copy size bytes and a NUL, then zeros up to the next aligned offset
+static uint64_t writeString(char* base, uint64_t offset, const char* string, uint64_t size)
+{
+    uint64_t end = alignOffset(offset + size + 1);
+    memcpy(base + offset, string, (size_t)size);
+    memset(base + offset + size, 0, (size_t)(end - offset - size));
+    return end;
+}
+
+// Write the block of bundle at offset, returns the offset following it
+static uint64_t writeBlock(const Bundle* bundle, char* base, uint64_t offset)
+{
+    int      count       = encodedCountOf(bundle);
+    uint32_t bucketCount = bucketCountOf(count);
+    uint32_t mask        = bucketCount - 1;
+
+    BundleImageBlock* block = (BundleImageBlock*)(base + offset);
+    memset(block, 0, (size_t)entriesOffsetOf(bucketCount));
+    block->count       = (uint32_t)count;
+    block->bucketCount = bucketCount;
+
+    // Counting sort by bucket without scratch memory: buckets[b + 1] first counts bucket b,
+    // becomes the start of bucket b + 1, then moves along to its end while entries are placed
+    const char* const* keys  = bundle->shape->keys;
+    const uint8_t*     types = bundleTypes(bundle);
+
+    uint32_t* buckets = block->buckets;
+    for (int i = 0; i < bundle->count; i++)
+    {
+        if (types[i] != Type_Custom)
+        {
+            buckets[(bundleKeyHash(keys[i]) & mask) + 1]++;
+        }
+    }
+
+    for (uint32_t b = 0; b < bucketCount; b++)
+    {
+        buckets[b + 1] += buckets[b];
+    }
+
+    // Place the entries first, each remembering its slot in value until its data is written
+    BundleImageEntry* entries = (BundleImageEntry*)(base + offset + entriesOffsetOf(bucketCount));
+    for (int i = 0; i < bundle->count; i++)
+    {
+        if (types[i] == Type_Custom)
+        {
+            continue;
+        }
+
+        // Keys are interned, their hash and length come for free
+        uint64_t hash = bundleKeyHash(keys[i]);
+
+        BundleImageEntry* entry = &entries[buckets[hash & mask]++];
+        entry->hash      = hash;
+        entry->keySize   = (uint32_t)bundleKeyLength(keys[i]);
+        entry->type      = types[i];
+        entry->valueSize = 0;
+        entry->value     = (uint64_t)i;
+    }
+
+    // Every bucket now holds the start of the next one, shift them back in place
+    for (uint32_t b = bucketCount; b > 0; b--)
+    {
+        buckets[b] = buckets[b - 1];
+    }
+    buckets[0] = 0;
+
+    // Data follows in entry order, which is what bvOpen checks the offsets against
+    uint64_t cursor = offset + entriesOffsetOf(bucketCount) + (uint64_t)count * sizeof(BundleImageEntry);
+    for (int e = 0; e < count; e++)
+    {
+        BundleImageEntry* entry   = &entries[e];
+        int               slot    = (int)entry->value;
+        const Variant*    variant = &bundle->values[slot];
+
+        entry->keyOffset = (uint32_t)cursor;
+        entry->value     = 0;
+        cursor = writeString(base, cursor, keys[slot], entry->keySize);
+
+        if (entry->type == Type_String)
+        {
+            entry->valueSize = (uint32_t)strlen(variant->asString);
+            entry->value     = cursor;
+            cursor = writeString(base, cursor, variant->asString, entry->valueSize);
+        }
+        else if (entry->type == Type_Bundle)
+        {
+            if (variant->asBundle)
+            {
+                entry->value = cursor;
+                cursor = writeBlock(variant->asBundle, base, cursor);
+            }
+        }
+        else
+        {
+            memcpy(&entry->value, &variant->asU64, scalarSizeOf((Type)entry->type));
+        }
+    }
+
+    return cursor;
+}
+
+uint64_t bundleEncode(const Bundle* bundle, void* buffer, uint64_t bufferSize)
+{
+    uint64_t size = bundleImageSize(bundle);
+    if (size == 0 || size > bufferSize)
+    {
+        return 0;
+    }
+
+    char* base = buffer;
+
+    BundleImageHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+    header.version    = IMAGE_VERSION;
+    header.byteOrder  = IMAGE_BYTE_ORDER;
+    header.size       = size;
+    header.rootOffset = alignOffset(sizeof(BundleImageHeader));
+
+    memset(base, 0, (size_t)header.rootOffset);
+    memcpy(base, &header, sizeof(header));
+
+    writeBlock(bundle, base, header.rootOffset);
+    return size;
+}
+
+static int validString(const char* base, uint64_t size, uint64_t offset, uint64_t length)
+{
+    return offset < size && length < size - offset && base[offset + length] == '\0';
+}
+
+// Checks the block at offset and everything it references, returns the offset following it or 0.
+// Keys, strings and child blocks must sit back to back in entry order, exactly where the encoder
+// puts them, so every byte is checked once and no two entries can share a child.
+static uint64_t validBlock(const char* base, uint64_t size, uint64_t offset, int depth)
+{
+    if (depth >= IMAGE_MAX_DEPTH || offset % IMAGE_ALIGNMENT != 0 || offset > size || size - offset < sizeof(BundleImageBlock))
+    {
+        return 0;
+    }
+
+    const BundleImageBlock* block = (const BundleImageBlock*)(base + offset);
+    uint32_t bucketCount = block->bucketCount;
+    if (bucketCount == 0 || (bucketCount & (bucketCount - 1)) != 0
+        || offset + entriesOffsetOf(bucketCount) + (uint64_t)block->count * sizeof(BundleImageEntry) > size)
+    {
+        return 0;
+    }
+
+    if (block->buckets[0] != 0 || block->buckets[bucketCount] != block->count)
+    {
+        return 0;
+    }
+
+    for (uint32_t b = 0; b < bucketCount; b++)
+    {
+        if (block->buckets[b] > block->buckets[b + 1])
+        {
+            return 0;
+        }
+    }
+
+    const BundleImageEntry* entries = (const BundleImageEntry*)(base + offset + entriesOffsetOf(bucketCount));
+    uint64_t                cursor  = offset + entriesOffsetOf(bucketCount) + (uint64_t)block->count * sizeof(BundleImageEntry);
+    for (uint32_t i = 0; i < block->count; i++)
+    {
+        const BundleImageEntry* entry = &entries[i];
+        if (entry->keyOffset != cursor || !validString(base, size, entry->keyOffset, entry->keySize))
+        {
+            return 0;
+        }
+        cursor = alignOffset(cursor + entry->keySize + 1);
+
+        switch (entry->type)
+        {
+            case Type_String:
+                if (entry->value != cursor || !validString(base, size, entry->value, entry->valueSize))
+                {
+                    return 0;
+                }
+                cursor = alignOffset(cursor + entry->valueSize + 1);
+                break;
+
+            case Type_Bundle:
+                if (entry->value != 0)
+                {
+                    if (entry->value != cursor)
+                    {
+                        return 0;
+                    }
+
+                    cursor = validBlock(base, size, entry->value, depth + 1);
+                    if (cursor == 0)
+                    {
+                        return 0;
+                    }
+                }
+                break;
+
+            case Type_Custom:
+                return 0;
+
+            default:
+                if (entry->type > Type_Custom)
+                {
+                    return 0;
+                }
+                break;
+        }
+    }
+
+    return cursor <= size ? cursor : 0;
+}
+
+int bvOpen(BundleView* outView, const void* buffer, uint64_t size)
+{
+    outView->base  = NULL;
+    outView->block = 0;
+
+    const BundleImageHeader* header = buffer;
+    if (size < sizeof(BundleImageHeader) || ((uintptr_t)buffer % IMAGE_ALIGNMENT) != 0
+        || memcmp(header->magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0
+        || header->version != IMAGE_VERSION
+        || header->byteOrder != IMAGE_BYTE_ORDER
+        || header->size > size || header->size > IMAGE_MAX_SIZE
+        || header->rootOffset == 0
+        || validBlock(buffer, header->size, header->rootOffset, 0) != header->size)
+    {
+        return 0;
+    }
+
+    outView->base  = buffer;
+    outView->block = (uint32_t)header->rootOffset;
+    return 1;
+}
+
+int bvCount(BundleView view)
+{
+    return view.block ? (int)((const BundleImageBlock*)(view.base + view.block))->count : 0;
+}
+
+static const BundleImageEntry* findEntry(BundleView view, uint64_t hash, const char* key, int keySize, Type type)
+{
+    if (!view.block)
+    {
+        return NULL;
+    }
+
+    const BundleImageBlock* block   = (const BundleImageBlock*)(view.base + view.block);
+    const BundleImageEntry* entries = (const BundleImageEntry*)(view.base + view.block + entriesOffsetOf(block->bucketCount));
+
+    uint32_t bucket = (uint32_t)(hash & (block->bucketCount - 1));
+    for (uint32_t i = block->buckets[bucket], end = block->buckets[bucket + 1]; i < end; i++)
+    {
+        const BundleImageEntry* entry = &entries[i];
+        if (entry->hash == hash && entry->keySize == (uint32_t)keySize && memcmp(view.base + entry->keyOffset, key, keySize) == 0)
+        {
+            return entry->type == (uint32_t)type ? entry : NULL;
+        }
+    }
+
+    return NULL;
+}
+
+static const BundleImageEntry* findEntryString(BundleView view, const char* key, Type type)
+{
+    int keySize = (int)strlen(key);
+    return findEntry(view, murmurHash64((void*)key, keySize, MURMUR_HASH_SEED), key, keySize, type);
+}
+
+static const BundleImageEntry* findEntryKey(BundleView view, BundleKey key, Type type)
+{
+    if (!key.string)
+    {
+        return NULL;
+    }
+
+    return findEntry(view, key.hash, key.string, bundleKeyLength(key.string), type);
+}
+
+static BundleView childView(BundleView view, const BundleImageEntry* entry)
+{
+    BundleView child = { view.base, entry ? (uint32_t)entry->value : 0 };
+    return child;
+}
+
+int8_t bvGetI8(BundleView view, const char* key)
+{
+    int8_t value = 0;
+
+    const BundleImageEntry* entry = findEntryString(view, key, Type_I8);
+    if (entry)
+    {
+        memcpy(&value, &entry->value, sizeof(value));
+    }
+
+    return value;
+}
+
+uint8_t bvGetU8(BundleView view, const char* key)
+{
+    uint8_t value = 0;
+
+    const BundleImageEntry* entry = findEntryString(view, key, Type_U8);
+    if (entry)
+    {
+        memcpy(&value, &entry->value, sizeof(value));
+    }
+
+    return value;
+}
+
+int16_t bvGetI16(BundleView view, const char* key)
+{
+    int16_t value = 0;
+
+    const BundleImageEntry* entry = findEntryString(view, key, Type_I16);
+    if (entry)
+    {
+        memcpy(&value, &entry->value, sizeof(value));
+    }
+
+    return value;
+}
+
+uint16_t bvGetU16(BundleView view, const char* key)
+{
+    uint16_t value = 0;
+
+    const BundleImageEntry* entry = findEntryString(view, key, Type_U16);
+    if (entry)
+    {
+        memcpy(&value, &entry->value, sizeof(value));
+    }
+
+    return value;
+}
+
+int32_t bvGetI32(BundleView view, const char* key)
+{
+    int32_t value = 0;
+
+    const BundleImageEntry* entry = findEntryString(view, key, Type_I32);
+    if (entry)
+    {
+        memcpy(&value, &entry->value, sizeof(value));
+    }
+
+    return value;
+}
+
+uint32_t bvGetU32(BundleView view, const char* key)
+{
+    uint32_t value = 0;
+
+    const BundleImageEntry* entry = findEntryString(view, key, Type_U32);
+    if (entry)
+    {
+        memcpy(&value, &entry->value, sizeof(value));
+    }
+
+    return value;
+}
+
+int64_t bvGetI64(BundleView view, const char* key)
+{
+    int64_t value = 0;
+
+    const BundleImageEntry* entry = findEntryString(view, key, Type_I64);
+    if (entry)
+    {
+        memcpy(&value, &entry->value, sizeof(value));
+    }
+
+    return value;
+}
+
+uint64_t bvGetU64(BundleView view, const char* key)
+{
+    uint64_t value = 0;
+
+    const BundleImageEntry* entry = findEntryString(view, key, Type_U64);
+    if (entry)
+    {
+        memcpy(&value, &entry->value, sizeof(value));
+    }
+
+    return value;
+}
+
+float bvGetFloat(BundleView view, const char* key)
+{
+    float value = 0;
+
+    const BundleImageEntry* entry = findEntryString(view, key, Type_Float);
+    if (entry)
+    {
+        memcpy(&value, &entry->value, sizeof(value));
+    }
+
+    return value;
+}
+
+double bvGetDouble(BundleView view, const char* key)
+{
+    double value = 0;
+
+    const BundleImageEntry* entry = findEntryString(view, key, Type_Double);
+    if (entry)
+    {
+        memcpy(&value, &entry->value, sizeof(value));
+    }
+
+    return value;
+}
+
+const char* bvGetString(BundleView view, const char* key)
+{
+    const BundleImageEntry* entry = findEntryString(view, key, Type_String);
+    return entry ? view.base + entry->value : "";
+}
+
+BundleView bvGetBundle(BundleView view, const char* key)
+{
+    return childView(view, findEntryString(view, key, Type_Bundle));
+}
+
+int8_t bvGetI8Key(BundleView view, BundleKey key)
+{
+    int8_t value = 0;
+
+    const BundleImageEntry* entry = findEntryKey(view, key, Type_I8);
+    if (entry)
+    {
+        memcpy(&value, &entry->value, sizeof(value));
+    }
+
+    return value;
+}
+
+uint8_t bvGetU8Key(BundleView view, BundleKey key)
+{
+    uint8_t value = 0;
+
+    const BundleImageEntry* entry = findEntryKey(view, key, Type_U8);
+    if (entry)
+    {
+        memcpy(&value, &entry->value, sizeof(value));
+    }
+
+    return value;
+}
+
+int16_t bvGetI16Key(BundleView view, BundleKey key)
+{
+    int16_t value = 0;
+
+    const BundleImageEntry* entry = findEntryKey(view, key, Type_I16);
+    if (entry)
+    {
+        memcpy(&value, &entry->value, sizeof(value));
+    }
+
+    return value;
+}
+
+uint16_t bvGetU16Key(BundleView view, BundleKey key)
+{
+    uint16_t value = 0;
+
+    const BundleImageEntry* entry = findEntryKey(view, key, Type_U16);
+    if (entry)
+    {
+        memcpy(&value, &entry->value, sizeof(value));
+    }
+
+    return value;
+}
+
+int32_t bvGetI32Key(BundleView view, BundleKey key)
+{
+    int32_t value = 0;
+
+    const BundleImageEntry* entry = findEntryKey(view, key, Type_I32);
+    if (entry)
+    {
+        memcpy(&value, &entry->value, sizeof(value));
+    }
+
+    return value;
+}
+
+uint32_t bvGetU32Key(BundleView view, BundleKey key)
+{
+    uint32_t value = 0;
+
+    const BundleImageEntry* entry = findEntryKey(view, key, Type_U32);
+    if (entry)
+    {
+        memcpy(&value, &entry->value, sizeof(value));
+    }
+
+    return value;
+}
+
+int64_t bvGetI64Key(BundleView view, BundleKey key)
+{
+    int64_t value = 0;
+
+    const BundleImageEntry* entry = findEntryKey(view, key, Type_I64);
+    if (entry)
+    {
+        memcpy(&value, &entry->value, sizeof(value));
+    }
+
+    return value;
+}
+
+uint64_t bvGetU64Key(BundleView view, BundleKey key)
+{
+    uint64_t value = 0;
+
+    const BundleImageEntry* entry = findEntryKey(view, key, Type_U64);
+    if (entry)
+    {
+        memcpy(&value, &entry->value, sizeof(value));
+    }
+
+    return value;
+}
+
+float bvGetFloatKey(BundleView view, BundleKey key)
+{
+    float value = 0;
+
+    const BundleImageEntry* entry = findEntryKey(view, key, Type_Float);
+    if (entry)
+    {
+        memcpy(&value, &entry->value, sizeof(value));
+    }
+
+    return value;
+}
+
+double bvGetDoubleKey(BundleView view, BundleKey key)
+{
+    double value = 0;
+
+    const BundleImageEntry* entry = findEntryKey(view, key, Type_Double);
+    if (entry)
+    {
+        memcpy(&value, &entry->value, sizeof(value));
+    }
+
+    return value;
+}
+
+const char* bvGetStringKey(BundleView view, BundleKey key)
+{
+    const BundleImageEntry* entry = findEntryKey(view, key, Type_String);
+    return entry ? view.base + entry->value : "";
+}
+
+BundleView bvGetBundleKey(BundleView view, BundleKey key)
+{
+    return childView(view, findEntryKey(view, key, Type_Bundle));
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Bundle.h"
+
+// Binary image of a Bundle tree, read in place.
+// bundleEncode writes the tree in one pass into a buffer sized with bundleImageSize.
+// Each bundle becomes a block holding a bucket index and an entry array whose strings
+// and child blocks are referenced by offsets from the image start, so a BundleView
+// answers lookups straight from the buffer, a file read or an mmap, without rebuilding
+// any node or copying any string.
+//
+// Keys are hashed like Bundle keys, so a BundleKey finds entries without hashing again.
+// Custom values are pointers into the writing process and are left out of the image.
+// Images are limited to 4 GiB, can only be read on machines with the same byte order,
+// and must be loaded at an 8-byte aligned address, as malloc and mmap return.
+
+typedef struct BundleView
+{
+    const char* base;       // Image start
+    uint32_t    block;      // Offset of the bundle block, 0 for an empty view
+} BundleView;
+
+// Bytes needed to encode bundle, or 0 when it does not fit the 4 GiB limit
+uint64_t        bundleImageSize(const Bundle* bundle);
+
+// Returns the number of bytes written, 0 when bufferSize is too small
+uint64_t        bundleEncode(const Bundle* bundle, void* buffer, uint64_t bufferSize);
+
+// Checks the whole image once, so the accessors can trust every offset afterwards.
+// Returns 0 and an empty view when buffer does not hold a valid image.
+int             bvOpen(BundleView* outView, const void* buffer, uint64_t size);
+
+int             bvCount(BundleView view);
+
+// Same defaults as the Bundle getters when the key is missing or holds another type.
+// Strings point into the image and stay valid as long as the buffer.
+int8_t          bvGetI8(BundleView view, const char* key);
+uint8_t         bvGetU8(BundleView view, const char* key);
+int16_t         bvGetI16(BundleView view, const char* key);
+uint16_t        bvGetU16(BundleView view, const char* key);
+int32_t         bvGetI32(BundleView view, const char* key);
+uint32_t        bvGetU32(BundleView view, const char* key);
+int64_t         bvGetI64(BundleView view, const char* key);
+uint64_t        bvGetU64(BundleView view, const char* key);
+float           bvGetFloat(BundleView view, const char* key);
+double          bvGetDouble(BundleView view, const char* key);
+const char*     bvGetString(BundleView view, const char* key);
+BundleView      bvGetBundle(BundleView view, const char* key);
+
+int8_t          bvGetI8Key(BundleView view, BundleKey key);
+uint8_t         bvGetU8Key(BundleView view, BundleKey key);
+int16_t         bvGetI16Key(BundleView view, BundleKey key);
+uint16_t        bvGetU16Key(BundleView view, BundleKey key);
+int32_t         bvGetI32Key(BundleView view, BundleKey key);
+uint32_t        bvGetU32Key(BundleView view, BundleKey key);
+int64_t         bvGetI64Key(BundleView view, BundleKey key);
+uint64_t        bvGetU64Key(BundleView view, BundleKey key);
+float           bvGetFloatKey(BundleView view, BundleKey key);
+double          bvGetDoubleKey(BundleView view, BundleKey key);
+const char*     bvGetStringKey(BundleView view, BundleKey key);
+BundleView      bvGetBundleKey(BundleView view, BundleKey key);
@@ -0,0 +1,273 @@
+#include "../include/ConcurrentHashTable.h"
+#include "../include/HashTable.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+typedef SRWLOCK RwLock;
+
+#define rwInit(lock)            InitializeSRWLock(lock)
+#define rwDestroy(lock)         ((void)(lock))
+#define rwReadLock(lock)        AcquireSRWLockShared(lock)
+#define rwReadUnlock(lock)      ReleaseSRWLockShared(lock)
+#define rwWriteLock(lock)       AcquireSRWLockExclusive(lock)
+#define rwWriteUnlock(lock)     ReleaseSRWLockExclusive(lock)
+#else
+#include <pthread.h>
+
+typedef pthread_rwlock_t RwLock;
+
+#define rwInit(lock)            pthread_rwlock_init(lock, NULL)
+#define rwDestroy(lock)         pthread_rwlock_destroy(lock)
+#define rwReadLock(lock)        pthread_rwlock_rdlock(lock)
+#define rwReadUnlock(lock)      pthread_rwlock_unlock(lock)
+#define rwWriteLock(lock)       pthread_rwlock_wrlock(lock)
+#define rwWriteUnlock(lock)     pthread_rwlock_unlock(lock)
+#endif
+
+// With HT_STATS the shard's lookup counters are written on every search,
+// so searches take the write lock and no longer run in parallel
+#ifdef HT_STATS
+#define rwSearchLock(lock)      rwWriteLock(lock)
+#define rwSearchUnlock(lock)    rwWriteUnlock(lock)
+#else
+#define rwSearchLock(lock)      rwReadLock(lock)
+#define rwSearchUnlock(lock)    rwReadUnlock(lock)
+#endif
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+typedef struct ConcurrentShard
+{
+    RwLock      lock;
+    HashTable*  table;
+} ConcurrentShard;
+
+// Shards are padded to whole cache lines, so locking one never invalidates its neighbours
+#define SHARD_STRIDE (((sizeof(ConcurrentShard) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE) * CACHE_LINE_SIZE)
+
+struct ConcurrentHashTable
+{
+    uint64_t (*hashFn)(void*, int);
+
+    int     shardCount;
+    int     shardShift;     // Shards are picked from the high bits, the tables use the low ones
+    char*   shards;         // shardCount * SHARD_STRIDE bytes, cache line aligned
+    void*   memory;         // Unaligned block holding the shards
+};
+
+struct ConcurrentHashTableIter
+{
+    ConcurrentHashTable*    table;
+    ConcurrentShard*        shard;
+    HashTableIter           iter;       // Over the locked shard
+    int                     shardIndex;
+};
+
+static inline ConcurrentShard* shardAt(ConcurrentHashTable* table, int index)
+{
+    return (ConcurrentShard*)(table->shards + index * SHARD_STRIDE);
+}
+
+// The shard tables share hashFn, so the hash picking the shard is passed down to it
+static inline ConcurrentShard* shardOf(ConcurrentHashTable* table, uint64_t hash)
+{
+    if (table->shardCount == 1)
+    {
+        return shardAt(table, 0);
+    }
+
+    return shardAt(table, (int)(hash >> table->shardShift));
+}
+
+ConcurrentHashTable* chtNew(int shardCount, int size, uint64_t (*hashFn)(void*, int))
+{
+    assert(shardCount > 0);
+    assert(size > 0);
+
+    int shardBits = 0;
+    while ((1 << shardBits) < shardCount)
+    {
+        shardBits++;
+    }
+    shardCount = 1 << shardBits;
+
+    ConcurrentHashTable* table = malloc(sizeof(ConcurrentHashTable));
+    if (!table)
+    {
+        return NULL;
+    }
+
+    table->memory = malloc(shardCount * SHARD_STRIDE + CACHE_LINE_SIZE - 1);
+    if (!table->memory)
+    {
+        free(table);
+        return NULL;
+    }
+
+    table->hashFn     = hashFn ? hashFn : &htHash;
+    table->shardCount = shardCount;
+    table->shardShift = 64 - shardBits;
+    table->shards     = (char*)(((uintptr_t)table->memory + CACHE_LINE_SIZE - 1) & ~(uintptr_t)(CACHE_LINE_SIZE - 1));
+
+    for (int i = 0; i < shardCount; i++)
+    {
+        ConcurrentShard* shard = shardAt(table, i);
+        shard->table = htNew(size, table->hashFn);
+        if (!shard->table)
+        {
+            table->shardCount = i;
+            chtFree(table);
+            return NULL;
+        }
+
+        rwInit(&shard->lock);
+    }
+
+    return table;
+}
+
+void chtFree(ConcurrentHashTable* table)
+{
+    for (int i = 0, n = table->shardCount; i < n; i++)
+    {
+        ConcurrentShard* shard = shardAt(table, i);
+        htFree(shard->table);
+        rwDestroy(&shard->lock);
+    }
+
+    free(table->memory);
+    free(table);
+}
+
+void chtRemove(ConcurrentHashTable* table, void* key, int keySize)
+{
+    uint64_t         hash  = table->hashFn(key, keySize);
+    ConcurrentShard* shard = shardOf(table, hash);
+
+    rwWriteLock(&shard->lock);
+    htRemoveHashed(shard->table, hash, key, keySize);
+    rwWriteUnlock(&shard->lock);
+}
+
+int chtSearch(ConcurrentHashTable* table, void* key, int keySize, void* outValue, int valueSize, int* outValueSize)
+{
+    uint64_t         hash  = table->hashFn(key, keySize);
+    ConcurrentShard* shard = shardOf(table, hash);
+
+    rwSearchLock(&shard->lock);
+    int   storedSize;
+    void* value = htSearchHashed(shard->table, hash, key, keySize, &storedSize);
+    if (value)
+    {
+        if (outValue)
+        {
+            memcpy(outValue, value, storedSize < valueSize ? storedSize : valueSize);
+        }
+
+        if (outValueSize)
+        {
+            *outValueSize = storedSize;
+        }
+    }
+    rwSearchUnlock(&shard->lock);
+
+    return value != NULL;
+}
+
+int chtInsert(ConcurrentHashTable* table, void* key, int keySize, void* value, int valueSize)
+{
+    uint64_t         hash  = table->hashFn(key, keySize);
+    ConcurrentShard* shard = shardOf(table, hash);
+
+    rwWriteLock(&shard->lock);
+    void* result = htInsertHashed(shard->table, hash, key, keySize, value, valueSize);
+    rwWriteUnlock(&shard->lock);
+
+    return result != NULL;
+}
+
+int chtCount(ConcurrentHashTable* table)
+{
+    int count = 0;
+    for (int i = 0, n = table->shardCount; i < n; i++)
+    {
+        ConcurrentShard* shard = shardAt(table, i);
+
+        rwReadLock(&shard->lock);
+        count += htCount(shard->table);
+        rwReadUnlock(&shard->lock);
+    }
+
+    return count;
+}
+
+ConcurrentHashTableIter* chtIterNew(ConcurrentHashTable* table)
+{
+    ConcurrentHashTableIter* iter = malloc(sizeof(*iter));
+    if (iter)
+    {
+        iter->table      = table;
+        iter->shard      = NULL;
+        iter->shardIndex = -1;
+    }
+
+    return iter;
+}
+
+static void releaseShard(ConcurrentHashTableIter* iter)
+{
+    if (iter->shard)
+    {
+        rwReadUnlock(&iter->shard->lock);
+        iter->shard = NULL;
+    }
+}
+
+void chtIterFree(ConcurrentHashTableIter* iter)
+{
+    releaseShard(iter);
+    free(iter);
+}
+
+int chtIterNext(ConcurrentHashTableIter* iter)
+{
+    while (1)
+    {
+        if (iter->shard && htIterNext(&iter->iter))
+        {
+            return 1;
+        }
+
+        releaseShard(iter);
+
+        if (iter->shardIndex + 1 >= iter->table->shardCount)
+        {
+            iter->shardIndex = iter->table->shardCount;
+            return 0;
+        }
+
+        iter->shardIndex++;
+        iter->shard = shardAt(iter->table, iter->shardIndex);
+
+        rwReadLock(&iter->shard->lock);
+        htIterInit(&iter->iter, iter->shard->table);
+    }
+}
+
+void* chtIterGetKey(ConcurrentHashTableIter* iter)
+{
+    return iter->shard ? iter->iter.key : NULL;
+}
+
+void* chtIterGetValue(ConcurrentHashTableIter* iter)
+{
+    return iter->shard ? iter->iter.value : NULL;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+
+// Bucket chains over a flat entry array, the layout of the DOD backend and SnapshotHashTable:
+// hashs[bucket] is the index of the first entry of a power-of-two bucket array, -1 when empty,
+// and every entry links to the next one of its bucket through its `next` index.
+//
+// HASH_CHAINS_DEFINE generates the chain routines for one entry type. Entry needs
+// `uint64_t hash`, `int keySize` and `int next` fields, and keyEquals(owner, entry, key, keySize)
+// compares the key bytes of an entry whose hash and size already matched.
+#define HASH_CHAINS_DEFINE(Owner, Entry, keyEquals)                                         \
+                                                                                            \
+/* Rebuild every chain from the cached hashes, for a bucket array of hashCount */           \
+static inline void chainsRelink(int* hashs, int hashCount, Entry* entries, int count)       \
+{                                                                                           \
+    for (int i = 0; i < hashCount; i++)                                                     \
+    {                                                                                       \
+        hashs[i] = -1;                                                                      \
+    }                                                                                       \
+                                                                                            \
+    for (int i = 0; i < count; i++)                                                         \
+    {                                                                                       \
+        Entry* entry = &entries[i];                                                         \
+                                                                                            \
+        int bucket = (int)(entry->hash & (uint64_t)(hashCount - 1));                        \
+        entry->next = hashs[bucket];                                                        \
+        hashs[bucket] = i;                                                                  \
+    }                                                                                       \
+}                                                                                           \
+                                                                                            \
+/* Index of the entry holding key or -1, with its bucket, the entry before it in the */     \
+/* chain and the number of entries looked at */                                             \
+static inline int chainsFind(Owner* owner, const int* hashs, int hashCount, Entry* entries, \
+                             uint64_t hash, void* key, int keySize,                         \
+                             int* outBucket, int* outPrev, int* outComparisons)             \
+{                                                                                           \
+    int bucket = (int)(hash & (uint64_t)(hashCount - 1));                                   \
+    int curr = hashs[bucket];                                                               \
+    int prev = -1;                                                                          \
+    int comparisons = 0;                                                                    \
+                                                                                            \
+    while (curr > -1)                                                                       \
+    {                                                                                       \
+        Entry* entry = &entries[curr];                                                      \
+        comparisons++;                                                                      \
+        if (entry->hash == hash && entry->keySize == keySize                                \
+            && keyEquals(owner, entry, key, keySize))                                       \
+        {                                                                                   \
+            break;                                                                          \
+        }                                                                                   \
+                                                                                            \
+        prev = curr;                                                                        \
+        curr = entry->next;                                                                 \
+    }                                                                                       \
+                                                                                            \
+    if (outBucket) *outBucket = bucket;                                                     \
+    if (outPrev) *outPrev = prev;                                                           \
+    if (outComparisons) *outComparisons = comparisons;                                      \
+    return curr;                                                                            \
+}                                                                                           \
+                                                                                            \
+/* Take entry curr, found by chainsFind, out of its chain and move the last of count */     \
+/* entries into the hole. The caller then drops the last entry from its count. */           \
+static inline void chainsUnlink(int* hashs, int hashCount, Entry* entries, int count,       \
+                                int curr, int bucket, int prev)                             \
+{                                                                                           \
+    if (prev > -1)                                                                          \
+    {                                                                                       \
+        entries[prev].next = entries[curr].next;                                            \
+    }                                                                                       \
+    else                                                                                    \
+    {                                                                                       \
+        hashs[bucket] = entries[curr].next;                                                 \
+    }                                                                                       \
+                                                                                            \
+    int last = count - 1;                                                                   \
+    if (curr < last)                                                                        \
+    {                                                                                       \
+        /* Entries are unique by index, the stored hash leads to the link to patch */       \
+        int* link = &hashs[entries[last].hash & (uint64_t)(hashCount - 1)];                 \
+        while (*link != last)                                                               \
+        {                                                                                   \
+            link = &entries[*link].next;                                                    \
+        }                                                                                   \
+                                                                                            \
+        *link = curr;                                                                       \
+        entries[curr] = entries[last];                                                      \
+    }                                                                                       \
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "../include/HashTable.h"
+
+// Hot path counters behind htGetStats.
+// Backends only embed them when compiled with HT_STATS, otherwise every update compiles to nothing.
+
+typedef struct HashTableCounters
+{
+    long long hits;
+    long long misses;
+    long long hitComparisons;
+    long long missComparisons;
+    long long memcmpCalls;
+    long long resizes;
+} HashTableCounters;
+
+// Disabled counters still mention their operands, so a table or counter variable that is
+// only used for statistics does not trigger unused warnings
+#ifdef HT_STATS
+#define HT_COUNTER_ADD(table, counter, amount)  ((table)->counters.counter += (amount))
+
+// Account one lookup that looked at `comparisons` entries
+#define HT_COUNT_LOOKUP(table, found, comparisons)                 \
+    do                                                              \
+    {                                                               \
+        if (found)                                                  \
+        {                                                           \
+            HT_COUNTER_ADD(table, hits, 1);                         \
+            HT_COUNTER_ADD(table, hitComparisons, comparisons);     \
+        }                                                           \
+        else                                                        \
+        {                                                           \
+            HT_COUNTER_ADD(table, misses, 1);                       \
+            HT_COUNTER_ADD(table, missComparisons, comparisons);    \
+        }                                                           \
+    } while (0)
+#else
+#define HT_COUNTER_ADD(table, counter, amount)      ((void)(table))
+#define HT_COUNT_LOOKUP(table, found, comparisons)  ((void)(table), (void)(comparisons))
+#endif
+
+static inline void htCountersCopy(const HashTableCounters* counters, HashTableStats* stats)
+{
+    stats->hits            = counters->hits;
+    stats->misses          = counters->misses;
+    stats->hitComparisons  = counters->hitComparisons;
+    stats->missComparisons = counters->missComparisons;
+    stats->memcmpCalls     = counters->memcmpCalls;
+    stats->resizes         = counters->resizes;
+}
+
+static inline void htStatsAddLength(HashTableStats* stats, int length)
+{
+    stats->lengthHistogram[length < HT_STATS_HISTOGRAM_SIZE ? length : HT_STATS_HISTOGRAM_SIZE - 1]++;
+}
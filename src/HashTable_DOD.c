@@ -1,44 +1,100 @@
 #include "../include/HashTable.h"
+#include "HashChains.h"
+#include "HashTableCounters.h"
+#include "MurmurHash.h"
+#include "SmallBuffer.h"
 
 #include <assert.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 
+// Grow the bucket array when count / hashCount goes above HT_MAX_LOAD_FACTOR,
+// shrink it when count / hashCount goes below HT_MIN_LOAD_FACTOR.
+// The bucket array never shrinks below the size given to htNew.
+#ifndef HT_MAX_LOAD_FACTOR
+#define HT_MAX_LOAD_FACTOR 1.0f
+#endif
+
+#ifndef HT_MIN_LOAD_FACTOR
+#define HT_MIN_LOAD_FACTOR 0.25f
+#endif
+
+// Number of keys htSearchBatch and htInsertBatch move through each stage together.
+// Every stage only starts loads for the next one, so the cache misses of a group overlap.
+#ifndef HT_BATCH_SIZE
+#define HT_BATCH_SIZE 16
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <xmmintrin.h>
+#define HT_PREFETCH(address) _mm_prefetch((const char*)(address), _MM_HINT_T0)
+#else
+#define HT_PREFETCH(address) __builtin_prefetch(address)
+#endif
+
+// Size of the first key/value arena chunk of tables made by htNewArena
+#ifndef HT_ARENA_CHUNK_SIZE
+#define HT_ARENA_CHUNK_SIZE 4096
+#endif
+
 typedef struct HashTableEntry
 {
-    int next;
-    
-    void* key;
-    int keySize;
+    uint64_t hash;
 
-    void* value;
+    SmallBuffer key;
+    SmallBuffer value;
+
+    int keySize;
     int valueSize;
+
+    int next;
 } HashTableEntry;
 
 typedef struct HashTable
 {
-    int (*hashFn)(void*, int, int);
+    uint64_t (*hashFn)(void*, int);
 
     int             count;
     int             capacity;
     HashTableEntry* entries;
 
+    Arena*          arena;  // Owns key and value bytes, NULL when they are malloc'd
+    Pool*           pool;   // Same for tables made by htNewPooled
+
+    int  minHashCount;
     int  hashCount;
-    int  hashs[1];
+    int* hashs;
+
+#ifdef HT_STATS
+    HashTableCounters counters;
+#endif
 } HashTable;
 
-struct HashTableIter
+static inline int entryKeyEquals(HashTable* table, HashTableEntry* entry, void* key, int keySize)
 {
-    HashTable*  table;
-    int         index;
-};
+    HT_COUNTER_ADD(table, memcmpCalls, 1);
+    return memcmp(sbData(&entry->key, keySize), key, keySize) == 0;
+}
+
+HASH_CHAINS_DEFINE(HashTable, HashTableEntry, entryKeyEquals)
 
-HashTable* htNew(int hashCount, int (*hashFn)(void*, int, int))
+HashTable* htNew(int hashCount, uint64_t (*hashFn)(void*, int))
 {
     assert(hashCount > 0);
 
-    HashTable* table = malloc(sizeof(HashTable) + (hashCount - 1) * sizeof(int));
+    // Keep the bucket count a power of two, so resizing always doubles or halves it
+    int powerOfTwo = 1;
+    while (powerOfTwo < hashCount)
+    {
+        powerOfTwo *= 2;
+    }
+    hashCount = powerOfTwo;
+
+    HashTable* table = malloc(sizeof(HashTable));
+    table->hashs = malloc(hashCount * sizeof(int));
     table->hashCount = hashCount;
+    table->minHashCount = hashCount;
     table->hashFn = hashFn ? hashFn : &htHash;
 
     for (int i = 0; i < hashCount; i++)
@@ -49,132 +105,308 @@ HashTable* htNew(int hashCount, int (*hashFn)(void*, int, int))
     table->count    = 0;
     table->capacity = 0;
     table->entries  = NULL;
+    table->arena    = NULL;
+    table->pool     = NULL;
+
+#ifdef HT_STATS
+    memset(&table->counters, 0, sizeof(table->counters));
+#endif
 
     return table;
 }
 
-void htFree(HashTable* table)
+HashTable* htNewArena(int size, uint64_t (*hashFn)(void*, int))
 {
-    for (int i = 0, n = table->count; i < n; i++)
+    HashTable* table = htNew(size, hashFn);
+    if (table)
     {
-        HashTableEntry* entry = &table->entries[i];
-        
-        free(entry->value);
-        free(entry->key);
+        table->arena = arNew(HT_ARENA_CHUNK_SIZE);
+        if (!table->arena)
+        {
+            htFree(table);
+            return NULL;
+        }
     }
 
-    free(table->entries);
-    free(table);
+    return table;
 }
 
-int indexOf(HashTable* table, void* key, int keySize, int* outHash, int* outPrev)
+HashTable* htNewPooled(int size, uint64_t (*hashFn)(void*, int))
 {
-    int hash = table->hashFn(key, keySize, table->hashCount);
-    int curr = table->hashs[hash];
-    int prev = -1;
+    HashTable* table = htNew(size, hashFn);
+    if (table)
+    {
+        table->pool = plNew();
+        if (!table->pool)
+        {
+            htFree(table);
+            return NULL;
+        }
+    }
+
+    return table;
+}
 
-    while (curr > -1)
+void htFree(HashTable* table)
+{
+    if (table->arena)
     {
-        HashTableEntry* entry = &table->entries[curr];
-        if (memcmp(entry->key, key, keySize) == 0)
+        arFree(table->arena);
+    }
+    else if (table->pool)
+    {
+        plFree(table->pool);
+    }
+    else
+    {
+        for (int i = 0, n = table->count; i < n; i++)
         {
-            break;
+            HashTableEntry* entry = &table->entries[i];
+
+            sbFree(&entry->value, entry->valueSize, NULL, NULL);
+            sbFree(&entry->key, entry->keySize, NULL, NULL);
         }
+    }
 
-        prev = curr;
-        curr = entry->next;
+    free(table->entries);
+    free(table->hashs);
+    free(table);
+}
+
+static void rehash(HashTable* table, int hashCount)
+{
+    int* hashs = realloc(table->hashs, hashCount * sizeof(int));
+    if (!hashs)
+    {
+        // Keep the old buckets, the table is still valid with longer chains
+        return;
     }
 
-    if (outHash) *outHash = hash;
-    if (outPrev) *outPrev = prev;
+    table->hashs = hashs;
+    table->hashCount = hashCount;
+    HT_COUNTER_ADD(table, resizes, 1);
+
+    chainsRelink(hashs, hashCount, table->entries, table->count);
+}
+
+static int indexOf(HashTable* table, uint64_t hash, void* key, int keySize, int* outBucket, int* outPrev)
+{
+    int comparisons;
+    int curr = chainsFind(table, table->hashs, table->hashCount, table->entries, hash, key, keySize, outBucket, outPrev, &comparisons);
+
+    HT_COUNT_LOOKUP(table, curr > -1, comparisons);
     return curr;
 }
 
-void htRemove(HashTable* table, void* key, int keySize)
+HashTable* htBuildFromArrays(void** keys, int* keySizes, void** values, int* valueSizes, int count,
+                             HashTableDuplicates duplicates, uint64_t (*hashFn)(void*, int))
 {
-    int prev;
-    int hash;
-    int curr = indexOf(table, key, keySize, &hash, &prev);
-    if (curr > -1)
+    HashTable* table = htNew(count > 0 ? count : 1, hashFn);
+    if (!table)
+    {
+        return NULL;
+    }
+
+    int       hashCount = table->hashCount;
+    uint64_t  mask      = (uint64_t)(hashCount - 1);
+    uint64_t* hashs     = malloc((count > 0 ? count : 1) * sizeof(uint64_t));
+    int*      ends      = calloc(hashCount + 1, sizeof(int));
+
+    table->entries  = malloc((count > 0 ? count : 1) * sizeof(HashTableEntry));
+    table->capacity = count;
+
+    if (!hashs || !ends || !table->entries)
+    {
+        free(ends);
+        free(hashs);
+        htFree(table);
+        return NULL;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        hashs[i] = table->hashFn(keys[i], keySizes[i]);
+        ends[(hashs[i] & mask) + 1]++;
+    }
+
+    for (int b = 0; b < hashCount; b++)
+    {
+        ends[b + 1] += ends[b];
+    }
+
+    // Copy every pair straight into its bucket's range, reading the input in order.
+    // Once out of memory the remaining entries are left empty, so every slot can still be freed.
+    int failed = 0;
+    for (int i = 0; i < count; i++)
     {
-        HashTableEntry entry = table->entries[curr];
-        free(entry.value);
-        free(entry.key);
+        HashTableEntry* entry = &table->entries[ends[hashs[i] & mask]++];
+        entry->hash      = hashs[i];
+        entry->keySize   = failed ? 0 : keySizes[i];
+        entry->valueSize = failed ? 0 : valueSizes[i];
 
-        if (curr < table->count - 1)
+        if (!failed && !sbInit(&entry->key, keys[i], keySizes[i], NULL, NULL))
         {
-            table->entries[curr] = table->entries[table->count - 1];
+            entry->keySize = entry->valueSize = 0;
+            failed = 1;
+        }
+        else if (!failed && !sbInit(&entry->value, values[i], valueSizes[i], NULL, NULL))
+        {
+            sbFree(&entry->key, keySizes[i], NULL, NULL);
+            entry->keySize = entry->valueSize = 0;
+            failed = 1;
+        }
+    }
 
-            HashTableEntry lastEntry = table->entries[curr];
-            indexOf(table, lastEntry.key, lastEntry.keySize, &hash, &prev);
-            if (prev > -1)
-            {
-                table->entries[prev].next = curr;
-            }
-            else
+    free(hashs);
+
+    // Bucket by bucket, drop duplicates and link each entry to the following one.
+    // The scatter above kept input order inside a bucket, so the first copy met is the first one given.
+    int out = 0;
+    for (int b = 0, in = 0; b < hashCount; b++)
+    {
+        int first = out;
+
+        // The scatter left ends[b] at the end of bucket b
+        for (; in < ends[b]; in++)
+        {
+            HashTableEntry entry = table->entries[in];
+
+            HashTableEntry* kept = NULL;
+            for (int j = first; j < out && !failed; j++)
             {
-                table->hashs[hash] = curr;
+                HashTableEntry* other = &table->entries[j];
+                if (other->hash == entry.hash && other->keySize == entry.keySize && memcmp(sbData(&other->key, other->keySize), sbData(&entry.key, entry.keySize), entry.keySize) == 0)
+                {
+                    kept = other;
+                    break;
+                }
             }
-        }
-        else
-        {
-            if (prev > -1)
+
+            if (kept)
             {
-                table->entries[prev].next = -1;
+                if (duplicates == HashTableDuplicates_LastWins)
+                {
+                    HashTableEntry swap = *kept;
+                    kept->value     = entry.value;
+                    kept->valueSize = entry.valueSize;
+                    entry.value     = swap.value;
+                    entry.valueSize = swap.valueSize;
+                }
+
+                sbFree(&entry.value, entry.valueSize, NULL, NULL);
+                sbFree(&entry.key, entry.keySize, NULL, NULL);
+                continue;
             }
-            else
+
+            entry.next = -1;
+            if (out > first)
             {
-                table->hashs[hash] = -1;
+                table->entries[out - 1].next = out;
             }
+
+            table->entries[out++] = entry;
+        }
+
+        if (out > first)
+        {
+            table->hashs[b] = first;
         }
+    }
+
+    free(ends);
+
+    table->count = out;
+    if (failed)
+    {
+        htFree(table);
+        return NULL;
+    }
 
+    return table;
+}
+
+int htCount(HashTable* table)
+{
+    return table->count;
+}
+
+void htRemoveHashed(HashTable* table, uint64_t hash, void* key, int keySize)
+{
+    int prev;
+    int bucket;
+    int curr = indexOf(table, hash, key, keySize, &bucket, &prev);
+    if (curr > -1)
+    {
+        HashTableEntry* entry = &table->entries[curr];
+        sbFree(&entry->value, entry->valueSize, table->arena, table->pool);
+        sbFree(&entry->key, entry->keySize, table->arena, table->pool);
+
+        chainsUnlink(table->hashs, table->hashCount, table->entries, table->count, curr, bucket, prev);
         table->count--;
+
+        if (table->hashCount > table->minHashCount && table->count < table->hashCount * HT_MIN_LOAD_FACTOR)
+        {
+            rehash(table, table->hashCount / 2);
+
+            if (table->capacity > 16 && table->count < table->capacity / 4)
+            {
+                HashTableEntry* entries = realloc(table->entries, (table->capacity / 2) * sizeof(HashTableEntry));
+                if (entries)
+                {
+                    table->entries = entries;
+                    table->capacity /= 2;
+                }
+            }
+        }
     }
 }
 
-void* htSearch(HashTable* table, void* key, int keySize)
+void* htSearchHashed(HashTable* table, uint64_t hash, void* key, int keySize, int* outValueSize)
 {
-    int curr = indexOf(table, key, keySize, NULL, NULL);
+    int curr = indexOf(table, hash, key, keySize, NULL, NULL);
     if (curr > -1)
     {
-        return table->entries[curr].value;
+        HashTableEntry* entry = &table->entries[curr];
+        if (outValueSize) *outValueSize = entry->valueSize;
+        return sbData(&entry->value, entry->valueSize);
     }
 
     return NULL;
 }
 
-void* htInsert(HashTable* table, void* key, int keySize, void* value, int valueSize)
+void* htInsertHashed(HashTable* table, uint64_t hash, void* key, int keySize, void* value, int valueSize)
 {
     int prev;
-    int hash;
-    int curr = indexOf(table, key, keySize, &hash, &prev);
+    int bucket;
+    int curr = indexOf(table, hash, key, keySize, &bucket, &prev);
     if (curr > -1)
     {
         HashTableEntry* entry = &table->entries[curr];
 
-        if (entry->valueSize != valueSize)
-        {
-            free(entry->value);
-
-            entry->value = malloc(valueSize);
-            entry->valueSize = valueSize;
-        }
-        memcpy(entry->value, value, valueSize);
-        return entry->value;
+        void* data = sbAssign(&entry->value, entry->valueSize, value, valueSize, table->arena, table->pool);
+        entry->valueSize = data ? valueSize : 0;
+        return data;
     }
     else
     {
         curr = table->count;
 
         HashTableEntry entry;
+        entry.hash = hash;
         entry.next = -1;
-        entry.key = malloc(keySize);
         entry.keySize = keySize;
-        entry.value = malloc(valueSize);
         entry.valueSize = valueSize;
 
-        memcpy(entry.key, key, keySize);
-        memcpy(entry.value, value, valueSize);
+        if (!sbInit(&entry.key, key, keySize, table->arena, table->pool))
+        {
+            return NULL;
+        }
+
+        if (!sbInit(&entry.value, value, valueSize, table->arena, table->pool))
+        {
+            sbFree(&entry.key, keySize, table->arena, table->pool);
+            return NULL;
+        }
 
         if (table->count + 1 > table->capacity)
         {
@@ -189,34 +421,265 @@ void* htInsert(HashTable* table, void* key, int keySize, void* value, int valueS
         }
         else
         {
-            table->hashs[hash] = curr;
+            table->hashs[bucket] = curr;
         }
 
         table->count++;
-        return entry.value;
+
+        if (table->count > table->hashCount * HT_MAX_LOAD_FACTOR)
+        {
+            rehash(table, table->hashCount * 2);
+        }
+
+        HashTableEntry* newEntry = &table->entries[curr];
+        return sbData(&newEntry->value, valueSize);
     }
 
     return NULL;
 }
 
-int htHash(void* key, int keySize, int tableSize)
+void htRemove(HashTable* table, void* key, int keySize)
+{
+    htRemoveHashed(table, table->hashFn(key, keySize), key, keySize);
+}
+
+void* htSearch(HashTable* table, void* key, int keySize)
+{
+    return htSearchHashed(table, table->hashFn(key, keySize), key, keySize, NULL);
+}
+
+void* htInsert(HashTable* table, void* key, int keySize, void* value, int valueSize)
+{
+    return htInsertHashed(table, table->hashFn(key, keySize), key, keySize, value, valueSize);
+}
+
+void htSearchBatch(HashTable* table, void** keys, int* keySizes, int count, void** outValues)
+{
+    uint64_t hashs[HT_BATCH_SIZE];
+    int      currs[HT_BATCH_SIZE];
+    uint64_t mask = (uint64_t)(table->hashCount - 1);
+
+    for (int base = 0; base < count; base += HT_BATCH_SIZE)
+    {
+        int n = count - base < HT_BATCH_SIZE ? count - base : HT_BATCH_SIZE;
+
+        // Hash every key and start loading its bucket
+        for (int i = 0; i < n; i++)
+        {
+            hashs[i] = table->hashFn(keys[base + i], keySizes[base + i]);
+            HT_PREFETCH(&table->hashs[hashs[i] & mask]);
+        }
+
+        // Read the chain heads and start loading their entries
+        for (int i = 0; i < n; i++)
+        {
+            currs[i] = table->hashs[hashs[i] & mask];
+            if (currs[i] > -1)
+            {
+                HT_PREFETCH(&table->entries[currs[i]]);
+            }
+        }
+
+        // Start loading the out of line keys that are about to be compared
+        for (int i = 0; i < n; i++)
+        {
+            if (currs[i] > -1)
+            {
+                HashTableEntry* entry = &table->entries[currs[i]];
+                if (entry->hash == hashs[i] && entry->keySize > SMALL_BUFFER_SIZE)
+                {
+                    HT_PREFETCH(entry->key.heap);
+                }
+            }
+        }
+
+        // Walk the chains, the heads are in cache by now
+        for (int i = 0; i < n; i++)
+        {
+            void* key     = keys[base + i];
+            int   keySize = keySizes[base + i];
+
+            int curr = currs[i];
+            int comparisons = 0;
+            while (curr > -1)
+            {
+                HashTableEntry* entry = &table->entries[curr];
+                comparisons++;
+                if (entry->hash == hashs[i] && entry->keySize == keySize)
+                {
+                    HT_COUNTER_ADD(table, memcmpCalls, 1);
+                    if (memcmp(sbData(&entry->key, keySize), key, keySize) == 0)
+                    {
+                        break;
+                    }
+                }
+
+                curr = entry->next;
+            }
+
+            HT_COUNT_LOOKUP(table, curr > -1, comparisons);
+
+            if (curr > -1)
+            {
+                HashTableEntry* entry = &table->entries[curr];
+                outValues[base + i] = sbData(&entry->value, entry->valueSize);
+            }
+            else
+            {
+                outValues[base + i] = NULL;
+            }
+        }
+    }
+}
+
+int htInsertBatch(HashTable* table, void** keys, int* keySizes, void** values, int* valueSizes, int count)
+{
+    // Size everything for the whole batch up front, so no rehash moves the prefetched buckets
+    int finalCount = table->count + count;
+    if (finalCount > table->capacity)
+    {
+        HashTableEntry* entries = realloc(table->entries, finalCount * sizeof(HashTableEntry));
+        if (entries)
+        {
+            table->entries = entries;
+            table->capacity = finalCount;
+        }
+    }
+
+    int hashCount = table->hashCount;
+    while (finalCount > hashCount * HT_MAX_LOAD_FACTOR)
+    {
+        hashCount *= 2;
+    }
+
+    if (hashCount != table->hashCount)
+    {
+        rehash(table, hashCount);
+    }
+
+    uint64_t hashs[HT_BATCH_SIZE];
+    int      stored = 0;
+
+    for (int base = 0; base < count; base += HT_BATCH_SIZE)
+    {
+        int n = count - base < HT_BATCH_SIZE ? count - base : HT_BATCH_SIZE;
+
+        uint64_t mask = (uint64_t)(table->hashCount - 1);
+        for (int i = 0; i < n; i++)
+        {
+            hashs[i] = table->hashFn(keys[base + i], keySizes[base + i]);
+            HT_PREFETCH(&table->hashs[hashs[i] & mask]);
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            int j = base + i;
+            if (htInsertHashed(table, hashs[i], keys[j], keySizes[j], values[j], valueSizes[j]))
+            {
+                stored++;
+            }
+        }
+    }
+
+    return stored;
+}
+
+void htGetStats(HashTable* table, HashTableStats* outStats)
 {
-    assert(tableSize > 0);
+    memset(outStats, 0, sizeof(*outStats));
+
+    outStats->count       = table->count;
+    outStats->bucketCount = table->hashCount;
 
-    int sum = 0;
-    for (int i = 0; i < keySize; i++)
+    for (int i = 0; i < table->hashCount; i++)
     {
-        sum += ((unsigned char*)key)[i] * (i + 1);
+        int length = 0;
+        for (int curr = table->hashs[i]; curr > -1; curr = table->entries[curr].next)
+        {
+            length++;
+        }
+
+        outStats->usedBuckets += length > 0;
+        htStatsAddLength(outStats, length);
     }
 
-    return (sum % tableSize);
+#ifdef HT_STATS
+    htCountersCopy(&table->counters, outStats);
+#endif
+
+    outStats->tableBytes = sizeof(HashTable) + (long long)table->hashCount * sizeof(int);
+    outStats->entryBytes = (long long)table->capacity * sizeof(HashTableEntry);
+
+    if (table->arena)
+    {
+        outStats->poolBytes = sizeof(Arena) + table->arena->reserved;
+    }
+    else if (table->pool)
+    {
+        outStats->poolBytes = sizeof(Pool) + table->pool->reserved;
+    }
+    else
+    {
+        for (int i = 0; i < table->count; i++)
+        {
+            HashTableEntry* entry = &table->entries[i];
+            outStats->keyBytes   += entry->keySize > SMALL_BUFFER_SIZE ? entry->keySize : 0;
+            outStats->valueBytes += entry->valueSize > SMALL_BUFFER_SIZE ? entry->valueSize : 0;
+        }
+    }
+}
+
+uint64_t htHash(void* key, int keySize)
+{
+    return murmurHash64(key, keySize, MURMUR_HASH_SEED);
+}
+
+static void iterStart(HashTableIter* iter, HashTable* table, int begin, int end)
+{
+    iter->key       = NULL;
+    iter->value     = NULL;
+    iter->keySize   = 0;
+    iter->valueSize = 0;
+
+    iter->internal.table  = table;
+    iter->internal.node   = NULL;
+    iter->internal.bucket = -1;
+    iter->internal.index  = begin - 1;
+    iter->internal.end    = end;
+}
+
+void htIterInit(HashTableIter* iter, HashTable* table)
+{
+    // No fixed end, the whole table is whatever count is when htIterNext runs
+    iterStart(iter, table, 0, INT_MAX);
+}
+
+void htIterInitRange(HashTableIter* iter, HashTable* table, int part, int partCount)
+{
+    assert(partCount > 0 && part >= 0 && part < partCount);
+
+    // Entries are dense, so parts are equal slices of the entry array
+    iterStart(iter, table, (int)((long long)table->count * part / partCount), (int)((long long)table->count * (part + 1) / partCount));
 }
 
 HashTableIter* htIterNew(HashTable* table)
 {
     HashTableIter* iter = malloc(sizeof(*iter));
-    iter->table = table;
-    iter->index = -1;
+    if (iter)
+    {
+        htIterInit(iter, table);
+    }
+
+    return iter;
+}
+
+HashTableIter* htIterNewRange(HashTable* table, int part, int partCount)
+{
+    HashTableIter* iter = malloc(sizeof(*iter));
+    if (iter)
+    {
+        htIterInitRange(iter, table, part, partCount);
+    }
 
     return iter;
 }
@@ -228,35 +691,55 @@ void htIterFree(HashTableIter* iter)
 
 int htIterNext(HashTableIter* iter)
 {
-    if (iter->index < iter->table->count - 1)
+    HashTable* table = iter->internal.table;
+
+    int end = iter->internal.end < table->count ? iter->internal.end : table->count;
+    if (iter->internal.index >= end - 1)
     {
-        iter->index++;
-        return 1;
+        iter->key       = NULL;
+        iter->value     = NULL;
+        iter->keySize   = 0;
+        iter->valueSize = 0;
+        return 0;
     }
 
-    return 0;
+    HashTableEntry* entry = &table->entries[++iter->internal.index];
+    iter->key       = sbData(&entry->key, entry->keySize);
+    iter->value     = sbData(&entry->value, entry->valueSize);
+    iter->keySize   = entry->keySize;
+    iter->valueSize = entry->valueSize;
+    return 1;
 }
 
 void* htIterGetKey(HashTableIter* iter)
 {
-    if (iter->index < iter->table->count)
-    {
-        return iter->table->entries[iter->index].key;
-    }
-    else
-    {
-        return NULL;
-    }
+    return iter->key;
 }
 
 void* htIterGetValue(HashTableIter* iter)
 {
-    if (iter->index < iter->table->count)
-    {
-        return iter->table->entries[iter->index].value;
-    }
-    else
+    return iter->value;
+}
+
+int htIterGetKeySize(HashTableIter* iter)
+{
+    return iter->keySize;
+}
+
+int htIterGetValueSize(HashTableIter* iter)
+{
+    return iter->valueSize;
+}
+
+void htForEach(HashTable* table, int (*fn)(void* context, void* key, int keySize, void* value, int valueSize), void* context)
+{
+    HashTableEntry* entries = table->entries;
+    for (int i = 0, n = table->count; i < n; i++)
     {
-        return NULL;
+        HashTableEntry* entry = &entries[i];
+        if (fn(context, sbData(&entry->key, entry->keySize), entry->keySize, sbData(&entry->value, entry->valueSize), entry->valueSize))
+        {
+            break;
+        }
     }
 }
@@ -1,52 +1,174 @@
 #include "../include/HashTable.h"
-#include "DynamicArray.h"
+#include "HashTableCounters.h"
+#include "MurmurHash.h"
+#include "SmallBuffer.h"
 
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FINGERPRINT_SSE2
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+// Fingerprints compared together, 8 x 16 bits fill an SSE2 register
+#define FINGERPRINT_GROUP 8
+
+// Size of the first key/value arena chunk of tables made by htNewArena
+#ifndef HT_ARENA_CHUNK_SIZE
+#define HT_ARENA_CHUNK_SIZE 4096
+#endif
+
 typedef struct HashTableNode
 {
-    void* key;
-    int   keySize;
+    uint64_t hash;
 
-    void* value;
-    int   valueSize;
+    SmallBuffer key;
+    SmallBuffer value;
+
+    int keySize;
+    int valueSize;
 } HashTableNode;
 
+// A bucket is a single growable block laid out as structure of arrays:
+// the header, a 16-bit fingerprint per node, then the nodes themselves.
+// Lookups scan the fingerprints, which share cache lines with the header,
+// and only touch the nodes whose fingerprint matches.
+// The fingerprint array is padded to whole groups so it can be loaded a group at a time.
+typedef struct HashTableBucket
+{
+    int      count;
+    int      capacity;
+    uint16_t fingerprints[];
+} HashTableBucket;
+
+static inline uint16_t fingerprintOf(uint64_t hash)
+{
+    // The bucket index comes from the low bits and ConcurrentHashTable picks shards from the top
+    // ones, so the fingerprint is taken from the middle to stay independent of both
+    return (uint16_t)(hash >> 32);
+}
+
+static inline size_t nodesOffset(int capacity)
+{
+    int groups = (capacity + FINGERPRINT_GROUP - 1) / FINGERPRINT_GROUP;
+    return sizeof(HashTableBucket) + (size_t)groups * FINGERPRINT_GROUP * sizeof(uint16_t);
+}
+
+static inline HashTableNode* bucketNodes(HashTableBucket* bucket)
+{
+    return (HashTableNode*)((char*)bucket + nodesOffset(bucket->capacity));
+}
+
+static inline int countTrailingZeros(uint32_t value)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return (int)index;
+#else
+    return __builtin_ctz(value);
+#endif
+}
+
+// Bitmask of the first count fingerprints of the group equal to fingerprint, count <= FINGERPRINT_GROUP
+static inline uint32_t matchFingerprints(const uint16_t* fingerprints, int count, uint16_t fingerprint)
+{
+#ifdef FINGERPRINT_SSE2
+    __m128i group   = _mm_loadu_si128((const __m128i*)fingerprints);
+    __m128i matches = _mm_cmpeq_epi16(group, _mm_set1_epi16((short)fingerprint));
+
+    // Narrow every 16-bit lane to a byte so each fingerprint gives one mask bit
+    uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(matches, _mm_setzero_si128()));
+    return count < FINGERPRINT_GROUP ? mask & ((1u << count) - 1) : mask;
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < count; i++)
+    {
+        mask |= (uint32_t)(fingerprints[i] == fingerprint) << i;
+    }
+    return mask;
+#endif
+}
+
+// Make room for one more node, returns the bucket which may have moved
+static HashTableBucket* bucketReserve(HashTableBucket* bucket)
+{
+    if (bucket && bucket->count < bucket->capacity)
+    {
+        return bucket;
+    }
+
+    // Start small, most buckets hold one or two nodes at the default load
+    int oldCapacity = bucket ? bucket->capacity : 0;
+    int capacity    = bucket ? bucket->capacity * 2 : 2;
+
+    HashTableBucket* newBucket = realloc(bucket, nodesOffset(capacity) + (size_t)capacity * sizeof(HashTableNode));
+    if (!newBucket)
+    {
+        return NULL;
+    }
+
+    if (!bucket)
+    {
+        newBucket->count = 0;
+    }
+
+    // The fingerprints stay in place, the nodes move up behind the larger fingerprint array
+    if (nodesOffset(capacity) != nodesOffset(oldCapacity))
+    {
+        memmove((char*)newBucket + nodesOffset(capacity), (char*)newBucket + nodesOffset(oldCapacity), (size_t)newBucket->count * sizeof(HashTableNode));
+    }
+
+    newBucket->capacity = capacity;
+    return newBucket;
+}
+
 struct HashTable
 {
     int size;
     int count;
-    int (*hashFn)(void*, int, int);
-    DynamicArray* entries[1];
-};
+    uint64_t (*hashFn)(void*, int);
 
-struct HashTableIter
-{
-    void* key;
-    int   keySize;
-    void* value;
-    int   valueSize;
+    Arena*        arena;    // Owns key and value bytes, NULL when they are malloc'd
+    Pool*         pool;     // Same for tables made by htNewPooled
 
-    struct
-    {
-        HashTable*      table;
-        DynamicArray*   entry;
-        int             index;
-        int             entryIndex;
-    } internal;
+#ifdef HT_STATS
+    HashTableCounters counters;
+#endif
+
+    HashTableBucket* entries[1];
 };
 
-HashTable* htNew(int size, int (*hashFn)(void*, int, int))
+HashTable* htNew(int size, uint64_t (*hashFn)(void*, int))
 {
     assert(size > 0);
 
-    HashTable* table = malloc(sizeof(HashTable) + sizeof(HashTableNode) * (size - 1));
+    // Power-of-two bucket count, so the hash is masked instead of divided
+    int powerOfTwo = 1;
+    while (powerOfTwo < size)
+    {
+        powerOfTwo *= 2;
+    }
+    size = powerOfTwo;
+
+    HashTable* table = malloc(sizeof(HashTable) + sizeof(HashTableBucket*) * (size - 1));
     table->size = size;
     table->count = 0;
     table->hashFn = hashFn ? hashFn : &htHash;
-    
+    table->arena = NULL;
+    table->pool = NULL;
+
+#ifdef HT_STATS
+    memset(&table->counters, 0, sizeof(table->counters));
+#endif
+
     for (int i = 0; i < size; i++)
     {
         table->entries[i] = NULL;
@@ -55,159 +177,354 @@ HashTable* htNew(int size, int (*hashFn)(void*, int, int))
     return table;
 }
 
+HashTable* htNewArena(int size, uint64_t (*hashFn)(void*, int))
+{
+    HashTable* table = htNew(size, hashFn);
+    if (table)
+    {
+        table->arena = arNew(HT_ARENA_CHUNK_SIZE);
+        if (!table->arena)
+        {
+            htFree(table);
+            return NULL;
+        }
+    }
+
+    return table;
+}
+
+HashTable* htNewPooled(int size, uint64_t (*hashFn)(void*, int))
+{
+    HashTable* table = htNew(size, hashFn);
+    if (table)
+    {
+        table->pool = plNew();
+        if (!table->pool)
+        {
+            htFree(table);
+            return NULL;
+        }
+    }
+
+    return table;
+}
+
 void htFree(HashTable* table)
 {
     for (int i = 0, n = table->size; i < n; i++)
     {
-        DynamicArray* entry = table->entries[i];
+        HashTableBucket* entry = table->entries[i];
         if (entry)
         {
-            for (int j = 0, m = entry->count; j < m; j++)
+            HashTableNode* nodes = bucketNodes(entry);
+            for (int j = 0, m = table->arena || table->pool ? 0 : entry->count; j < m; j++)
             {
-                HashTableNode* node;
-                daGet(entry, j, &node);
-
-                if (node)
-                {
-                    free(node->value);
-                    free(node->key);
-                    free(node);
-                }
+                sbFree(&nodes[j].value, nodes[j].valueSize, NULL, NULL);
+                sbFree(&nodes[j].key, nodes[j].keySize, NULL, NULL);
             }
 
-            daFree(entry);
+            free(entry);
         }
     }
 
+    arFree(table->arena);
+    plFree(table->pool);
     free(table);
 }
 
-void htRemove(HashTable* table, void* key, int keySize)
+static HashTableNode* searchNode(HashTable* table, HashTableBucket* entry, uint64_t hash, void* key, int keySize)
 {
-    int entryIndex = table->hashFn(key, keySize, table->size);
-    DynamicArray* entry = table->entries[entryIndex];
-    if (entry)
+    int count = entry ? entry->count : 0;
+    int comparisons = 0;
+
+    uint16_t fingerprint = fingerprintOf(hash);
+    for (int group = 0; group < count; group += FINGERPRINT_GROUP)
     {
-        for (int i = 0, n = entry->count; i < n; i++)
+        int groupCount = count - group < FINGERPRINT_GROUP ? count - group : FINGERPRINT_GROUP;
+
+        uint32_t mask = matchFingerprints(&entry->fingerprints[group], groupCount, fingerprint);
+        while (mask)
         {
-            HashTableNode* node;
-            daGet(entry, i, &node);
+            HashTableNode* node = &bucketNodes(entry)[group + countTrailingZeros(mask)];
+            mask &= mask - 1;
 
-            if (node && node->keySize == keySize && memcmp(key, node->key, keySize) == 0)
+            comparisons++;
+            if (node->hash == hash && node->keySize == keySize)
             {
-                if (i < entry->count - 1)
+                HT_COUNTER_ADD(table, memcmpCalls, 1);
+                if (memcmp(key, sbData(&node->key, keySize), keySize) == 0)
                 {
-                    HashTableNode* lastNode;
-                    daGet(entry, entry->count - 1, &lastNode);
-                    daSet(entry, i, &lastNode);
+                    HT_COUNT_LOOKUP(table, 1, comparisons);
+                    return node;
                 }
-
-                table->count--;
-                entry->count--;
-                
-                free(node->value);
-                free(node->key);
-                free(node);
             }
         }
     }
+
+    HT_COUNT_LOOKUP(table, 0, comparisons);
+    return NULL;
 }
 
-void* htSearch(HashTable* table, void* key, int keySize)
+HashTable* htBuildFromArrays(void** keys, int* keySizes, void** values, int* valueSizes, int count,
+                             HashTableDuplicates duplicates, uint64_t (*hashFn)(void*, int))
 {
-    int entryIndex = table->hashFn(key, keySize, table->size);
-    DynamicArray* entry = table->entries[entryIndex];
-    if (entry)
+    // Sized once for every pair, so no insert below grows the table
+    HashTable* table = htNew(count > 0 ? count : 1, hashFn);
+    if (!table)
     {
-        for (int i = 0, n = entry->count; i < n; i++)
+        return NULL;
+    }
+
+    uint64_t* hashs = malloc((count > 0 ? count : 1) * sizeof(uint64_t));
+    if (!hashs)
+    {
+        htFree(table);
+        return NULL;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        hashs[i] = table->hashFn(keys[i], keySizes[i]);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (duplicates == HashTableDuplicates_FirstWins && htSearchHashed(table, hashs[i], keys[i], keySizes[i], NULL))
         {
-            HashTableNode* node;
-            daGet(entry, i, &node);
+            continue;
+        }
 
-            if (node->keySize == keySize && memcmp(key, node->key, keySize) == 0)
-            {
-                return node->value;
-            }
+        if (!htInsertHashed(table, hashs[i], keys[i], keySizes[i], values[i], valueSizes[i]))
+        {
+            free(hashs);
+            htFree(table);
+            return NULL;
+        }
+    }
+
+    free(hashs);
+    return table;
+}
+
+int htCount(HashTable* table)
+{
+    return table->count;
+}
+
+void htRemoveHashed(HashTable* table, uint64_t hash, void* key, int keySize)
+{
+    int entryIndex = (int)(hash & (uint64_t)(table->size - 1));
+    HashTableBucket* entry = table->entries[entryIndex];
+
+    HashTableNode* node = searchNode(table, entry, hash, key, keySize);
+    if (node)
+    {
+        sbFree(&node->value, node->valueSize, table->arena, table->pool);
+        sbFree(&node->key, node->keySize, table->arena, table->pool);
+
+        // Move the last node and its fingerprint into the hole
+        HashTableNode* nodes = bucketNodes(entry);
+        int index = (int)(node - nodes);
+        int last  = --entry->count;
+        if (index != last)
+        {
+            nodes[index] = nodes[last];
+            entry->fingerprints[index] = entry->fingerprints[last];
         }
+
+        table->count--;
+    }
+}
+
+void* htSearchHashed(HashTable* table, uint64_t hash, void* key, int keySize, int* outValueSize)
+{
+    int entryIndex = (int)(hash & (uint64_t)(table->size - 1));
+    HashTableNode* node = searchNode(table, table->entries[entryIndex], hash, key, keySize);
+    if (node)
+    {
+        if (outValueSize) *outValueSize = node->valueSize;
+        return sbData(&node->value, node->valueSize);
     }
 
     return NULL;
 }
 
-void* htInsert(HashTable* table, void* key, int keySize, void* value, int valueSize)
+void* htInsertHashed(HashTable* table, uint64_t hash, void* key, int keySize, void* value, int valueSize)
 {
-    int entryIndex = table->hashFn(key, keySize, table->size);
-    DynamicArray* entry = table->entries[entryIndex];
+    int entryIndex = (int)(hash & (uint64_t)(table->size - 1));
+    HashTableBucket* entry = table->entries[entryIndex];
+
+    HashTableNode* node = searchNode(table, entry, hash, key, keySize);
+    if (node)
+    {
+        void* data = sbAssign(&node->value, node->valueSize, value, valueSize, table->arena, table->pool);
+        node->valueSize = data ? valueSize : 0;
+        return data;
+    }
 
-    HashTableNode* currNode = NULL;
+    entry = bucketReserve(entry);
     if (!entry)
     {
-        table->entries[entryIndex] = entry = daNew(8, sizeof(HashTableNode*));
-        if (!entry)
+        return NULL;
+    }
+    table->entries[entryIndex] = entry;
+
+    // Nodes are stored by value in the bucket, the new one goes at the end
+    node = &bucketNodes(entry)[entry->count];
+    node->hash = hash;
+    node->keySize = keySize;
+    node->valueSize = valueSize;
+
+    if (!sbInit(&node->key, key, keySize, table->arena, table->pool))
+    {
+        return NULL;
+    }
+
+    if (!sbInit(&node->value, value, valueSize, table->arena, table->pool))
+    {
+        sbFree(&node->key, keySize, table->arena, table->pool);
+        return NULL;
+    }
+
+    entry->fingerprints[entry->count++] = fingerprintOf(hash);
+    table->count++;
+
+    return sbData(&node->value, valueSize);
+}
+
+void htRemove(HashTable* table, void* key, int keySize)
+{
+    htRemoveHashed(table, table->hashFn(key, keySize), key, keySize);
+}
+
+void* htSearch(HashTable* table, void* key, int keySize)
+{
+    return htSearchHashed(table, table->hashFn(key, keySize), key, keySize, NULL);
+}
+
+void* htInsert(HashTable* table, void* key, int keySize, void* value, int valueSize)
+{
+    return htInsertHashed(table, table->hashFn(key, keySize), key, keySize, value, valueSize);
+}
+
+void htSearchBatch(HashTable* table, void** keys, int* keySizes, int count, void** outValues)
+{
+    for (int i = 0; i < count; i++)
+    {
+        outValues[i] = htSearch(table, keys[i], keySizes[i]);
+    }
+}
+
+int htInsertBatch(HashTable* table, void** keys, int* keySizes, void** values, int* valueSizes, int count)
+{
+    int stored = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (htInsert(table, keys[i], keySizes[i], values[i], valueSizes[i]))
         {
-            return NULL;
+            stored++;
         }
     }
-    else
+
+    return stored;
+}
+
+void htGetStats(HashTable* table, HashTableStats* outStats)
+{
+    memset(outStats, 0, sizeof(*outStats));
+
+    outStats->count       = table->count;
+    outStats->bucketCount = table->size;
+    outStats->tableBytes  = sizeof(HashTable) + (long long)(table->size - 1) * sizeof(HashTableBucket*);
+
+    for (int i = 0; i < table->size; i++)
     {
-        for (int i = 0, n = entry->count; i < n; i++)
+        HashTableBucket* entry = table->entries[i];
+        int length = entry ? entry->count : 0;
+
+        outStats->usedBuckets += length > 0;
+        htStatsAddLength(outStats, length);
+
+        if (entry)
         {
-            HashTableNode* node;
-            daGet(entry, i, &node);
+            // Bucket headers and fingerprints count as table, the nodes as entries
+            outStats->tableBytes += nodesOffset(entry->capacity);
+            outStats->entryBytes += (long long)entry->capacity * sizeof(HashTableNode);
 
-            if (node->keySize == keySize && memcmp(key, node->key, keySize) == 0)
+            HashTableNode* nodes = bucketNodes(entry);
+            for (int j = 0; j < entry->count && !table->arena && !table->pool; j++)
             {
-                currNode = node;
-                break;
+                outStats->keyBytes   += nodes[j].keySize > SMALL_BUFFER_SIZE ? nodes[j].keySize : 0;
+                outStats->valueBytes += nodes[j].valueSize > SMALL_BUFFER_SIZE ? nodes[j].valueSize : 0;
             }
         }
     }
 
-    if (!currNode)
+#ifdef HT_STATS
+    htCountersCopy(&table->counters, outStats);
+#endif
+
+    if (table->arena)
     {
-        currNode = malloc(sizeof(HashTableNode));
-        currNode->key = malloc(keySize);
-        currNode->keySize = keySize; 
-        currNode->value = NULL;
-        currNode->valueSize = 0;
-        memcpy(currNode->key, key, keySize);
-
-        daPush(entry, &currNode);
-        table->count++;
+        outStats->poolBytes = sizeof(Arena) + table->arena->reserved;
     }
 
-    if (!currNode->value || currNode->valueSize != valueSize)
+    if (table->pool)
     {
-        free(currNode->value);
-
-        currNode->value = malloc(valueSize);
-        currNode->valueSize = valueSize;
+        outStats->poolBytes = sizeof(Pool) + table->pool->reserved;
     }
+}
 
-    memcpy(currNode->value, value, valueSize);
-    return currNode->value;
+uint64_t htHash(void* key, int keySize)
+{
+    return murmurHash64(key, keySize, MURMUR_HASH_SEED);
 }
 
-int htHash(void* key, int keySize, int tableSize)
+static void iterStart(HashTableIter* iter, HashTable* table, int begin, int end)
 {
-    assert(tableSize > 0);
+    iter->key       = NULL;
+    iter->value     = NULL;
+    iter->keySize   = 0;
+    iter->valueSize = 0;
+
+    iter->internal.table  = table;
+    iter->internal.node   = NULL;
+    iter->internal.bucket = begin - 1;
+    iter->internal.index  = -1;
+    iter->internal.end    = end;
+}
 
-    int sum = 0;
-    for (int i = 0; i < keySize; i++)
+void htIterInit(HashTableIter* iter, HashTable* table)
+{
+    iterStart(iter, table, 0, table->size);
+}
+
+void htIterInitRange(HashTableIter* iter, HashTable* table, int part, int partCount)
+{
+    assert(partCount > 0 && part >= 0 && part < partCount);
+
+    // Parts are bucket ranges, a bucket is never split
+    iterStart(iter, table, (int)((long long)table->size * part / partCount), (int)((long long)table->size * (part + 1) / partCount));
+}
+
+HashTableIter* htIterNew(HashTable* table)
+{
+    HashTableIter* iter = malloc(sizeof(*iter));
+    if (iter)
     {
-        sum += ((unsigned char*)key)[i] * (i + 1);
+        htIterInit(iter, table);
     }
 
-    return (sum % tableSize);
+    return iter;
 }
 
-HashTableIter* htIterNew(HashTable* table)
+HashTableIter* htIterNewRange(HashTable* table, int part, int partCount)
 {
     HashTableIter* iter = malloc(sizeof(*iter));
-    iter->internal.table = table;
-    iter->internal.entry = NULL;
-    iter->internal.index = -1;
-    iter->internal.entryIndex = -1;
+    if (iter)
+    {
+        htIterInitRange(iter, table, part, partCount);
+    }
 
     return iter;
 }
@@ -219,50 +536,34 @@ void htIterFree(HashTableIter* iter)
 
 int htIterNext(HashTableIter* iter)
 {
-    HashTable* table = iter->internal.table;
+    HashTable*       table = iter->internal.table;
+    HashTableBucket* entry = iter->internal.node;
 
-    int entryIndex = iter->internal.entryIndex;
-    if (iter->internal.entry == NULL || iter->internal.index < 0 || iter->internal.index >= iter->internal.entry->count - 1)
+    int index = iter->internal.index + 1;
+    while (!entry || index >= entry->count)
     {
-        entryIndex++;
-        while (iter->internal.table->entries[entryIndex] == NULL && entryIndex < table->size)
+        if (iter->internal.bucket >= iter->internal.end - 1)
         {
-            entryIndex++;
-        }
-
-        if (entryIndex >= table->size)
-        {
-            iter->internal.entry = NULL;
-            iter->internal.entryIndex = entryIndex;
-
-            iter->key = NULL;
-            iter->keySize = 0;
-
-            iter->value = NULL;
+            iter->internal.node = NULL;
+            iter->key       = NULL;
+            iter->value     = NULL;
+            iter->keySize   = 0;
             iter->valueSize = 0;
-
             return 0;
         }
-        else
-        {
-            iter->internal.index = 0;
-            iter->internal.entry = table->entries[entryIndex];
-            iter->internal.entryIndex = entryIndex;
-        }
-    }
-    else
-    {
-        iter->internal.index++;
+
+        entry = table->entries[++iter->internal.bucket];
+        index = 0;
     }
-    
-    HashTableNode* node;
-    daGet(iter->internal.entry, iter->internal.index, &node);
 
-    iter->key = node->key;
-    iter->value = node->value;
-    iter->keySize = node->keySize;
-    iter->valueSize = node->valueSize;
+    iter->internal.node  = entry;
+    iter->internal.index = index;
 
+    HashTableNode* node = &bucketNodes(entry)[index];
+    iter->key       = sbData(&node->key, node->keySize);
+    iter->value     = sbData(&node->value, node->valueSize);
+    iter->keySize   = node->keySize;
+    iter->valueSize = node->valueSize;
     return 1;
 }
 
@@ -275,3 +576,35 @@ void* htIterGetValue(HashTableIter* iter)
 {
     return iter->value;
 }
+
+int htIterGetKeySize(HashTableIter* iter)
+{
+    return iter->keySize;
+}
+
+int htIterGetValueSize(HashTableIter* iter)
+{
+    return iter->valueSize;
+}
+
+void htForEach(HashTable* table, int (*fn)(void* context, void* key, int keySize, void* value, int valueSize), void* context)
+{
+    for (int i = 0, n = table->size; i < n; i++)
+    {
+        HashTableBucket* entry = table->entries[i];
+        if (!entry)
+        {
+            continue;
+        }
+
+        HashTableNode* nodes = bucketNodes(entry);
+        for (int j = 0, m = entry->count; j < m; j++)
+        {
+            HashTableNode* node = &nodes[j];
+            if (fn(context, sbData(&node->key, node->keySize), node->keySize, sbData(&node->value, node->valueSize), node->valueSize))
+            {
+                return;
+            }
+        }
+    }
+}
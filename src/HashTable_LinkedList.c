@@ -1,17 +1,26 @@
 #include "../include/HashTable.h"
-#include "Obstack.h"
+#include "HashTableCounters.h"
+#include "MurmurHash.h"
+#include "SmallBuffer.h"
 
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 
+// Size of the first key/value arena chunk of tables made by htNewArena
+#ifndef HT_ARENA_CHUNK_SIZE
+#define HT_ARENA_CHUNK_SIZE 4096
+#endif
+
 typedef struct HashTableNode
 {
-    void* key;
-    int   keySize;
+    uint64_t hash;
+
+    SmallBuffer key;
+    SmallBuffer value;
 
-    void* value;
-    int   valueSize;
+    int keySize;
+    int valueSize;
 
     struct HashTableNode* next;    
 } HashTableNode;
@@ -20,37 +29,43 @@ struct HashTable
 {
     int size;
     int count;
-    int (*hashFn)(void*, int, int);
+    uint64_t (*hashFn)(void*, int);
 
-    Obstack*       nodePool;
-    HashTableNode* entries[1];
-};
+    Pool*          nodePool;
+    Arena*         arena;       // Owns key and value bytes, NULL when they are malloc'd
+    Pool*          pool;        // Owns key and value bytes in tables made by htNewPooled, same as nodePool
 
-struct HashTableIter
-{
-    void* key;
-    int   keySize;
-    void* value;
-    int   valueSize;
+#ifdef HT_STATS
+    HashTableCounters counters;
+#endif
 
-    struct
-    {
-        HashTable*      table;
-        HashTableNode*  entry;
-        int             index;
-    } internal;
+    HashTableNode* entries[1];
 };
 
-HashTable* htNew(int size, int (*hashFn)(void*, int, int))
+HashTable* htNew(int size, uint64_t (*hashFn)(void*, int))
 {
     assert(size > 0);
 
-    HashTable* table = malloc(sizeof(HashTable) + sizeof(HashTableNode) * (size - 1));
+    // Power-of-two bucket count, so the hash is masked instead of divided
+    int powerOfTwo = 1;
+    while (powerOfTwo < size)
+    {
+        powerOfTwo *= 2;
+    }
+    size = powerOfTwo;
+
+    HashTable* table = malloc(sizeof(HashTable) + sizeof(HashTableNode*) * (size - 1));
     table->size = size;
     table->count = 0;
     table->hashFn = hashFn ? hashFn : &htHash;
-    table->nodePool = obNew(sizeof(HashTableNode), 64);
-    
+    table->nodePool = plNew();
+    table->arena = NULL;
+    table->pool = NULL;
+
+#ifdef HT_STATS
+    memset(&table->counters, 0, sizeof(table->counters));
+#endif
+
     for (int i = 0; i < size; i++)
     {
         table->entries[i] = NULL;
@@ -59,205 +74,353 @@ HashTable* htNew(int size, int (*hashFn)(void*, int, int))
     return table;
 }
 
-void htFree(HashTable* table)
+HashTable* htNewArena(int size, uint64_t (*hashFn)(void*, int))
 {
-    for (int i = 0, n = table->size; i < n; i++)
+    HashTable* table = htNew(size, hashFn);
+    if (table)
     {
-        HashTableNode* node = table->entries[i];
-        while (node)
+        table->arena = arNew(HT_ARENA_CHUNK_SIZE);
+        if (!table->arena)
         {
-            HashTableNode* next = node->next;
+            htFree(table);
+            return NULL;
+        }
+    }
 
-            free(node->key);
-            free(node->value);
+    return table;
+}
 
-            node = next;
-        }
+HashTable* htNewPooled(int size, uint64_t (*hashFn)(void*, int))
+{
+    HashTable* table = htNew(size, hashFn);
+    if (table)
+    {
+        // Nodes, keys and values share the pool, nodes are a size class like any other
+        table->pool = table->nodePool;
     }
 
-    obFree(table->nodePool);
-    free(table);
+    return table;
 }
 
-void htRemove(HashTable* table, void* key, int keySize)
+void htFree(HashTable* table)
 {
-    int entryIndex = table->hashFn(key, keySize, table->size);
-    HashTableNode* entry = table->entries[entryIndex];
-    if (entry)
+    if (table->arena)
     {
-        HashTableNode* currNode = entry;
-        HashTableNode* prevNode = NULL;
-        while (currNode)
+        arFree(table->arena);
+    }
+    else if (!table->pool)
+    {
+        for (int i = 0, n = table->size; i < n; i++)
         {
-            if (currNode->keySize == keySize && memcmp(key, currNode->key, keySize) == 0)
+            HashTableNode* node = table->entries[i];
+            while (node)
             {
-                table->count--;
+                HashTableNode* next = node->next;
 
-                free(currNode->key);
-                free(currNode->value);
+                sbFree(&node->key, node->keySize, NULL, NULL);
+                sbFree(&node->value, node->valueSize, NULL, NULL);
 
-                if (prevNode)
-                {
-                    prevNode->next = currNode->next;
-                }
-                else
-                {
-                    table->entries[entryIndex] = currNode->next;
-                }
-
-                obRelease(table->nodePool, currNode);
-                break;
+                node = next;
             }
-
-            prevNode = currNode;
-            currNode = currNode->next;
         }
     }
+
+    plFree(table->nodePool);
+    free(table);
 }
 
-void* htSearch(HashTable* table, void* key, int keySize)
+HashTable* htBuildFromArrays(void** keys, int* keySizes, void** values, int* valueSizes, int count,
+                             HashTableDuplicates duplicates, uint64_t (*hashFn)(void*, int))
 {
-    int entryIndex = table->hashFn(key, keySize, table->size);
-    HashTableNode* entry = table->entries[entryIndex];
-    if (!entry)
+    // Sized once for every pair, so no insert below grows the table
+    HashTable* table = htNew(count > 0 ? count : 1, hashFn);
+    if (!table)
+    {
+        return NULL;
+    }
+
+    uint64_t* hashs = malloc((count > 0 ? count : 1) * sizeof(uint64_t));
+    if (!hashs)
     {
+        htFree(table);
         return NULL;
     }
 
-    HashTableNode* node = entry;
-    while (node)
+    for (int i = 0; i < count; i++)
     {
-        if (node->keySize == keySize && memcmp(key, node->key, keySize) == 0)
+        hashs[i] = table->hashFn(keys[i], keySizes[i]);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (duplicates == HashTableDuplicates_FirstWins && htSearchHashed(table, hashs[i], keys[i], keySizes[i], NULL))
+        {
+            continue;
+        }
+
+        if (!htInsertHashed(table, hashs[i], keys[i], keySizes[i], values[i], valueSizes[i]))
         {
-            return node->value;
+            free(hashs);
+            htFree(table);
+            return NULL;
         }
-        node = node->next;
     }
 
-    return NULL;
+    free(hashs);
+    return table;
 }
 
-void* htInsert(HashTable* table, void* key, int keySize, void* value, int valueSize)
+int htCount(HashTable* table)
 {
-    if (!value)
-    {
-        return NULL;
-    }
+    return table->count;
+}
 
-    int entryIndex = table->hashFn(key, keySize, table->size);
-    HashTableNode* entry = table->entries[entryIndex];
-    if (entry)
+static HashTableNode* searchNode(HashTable* table, uint64_t hash, void* key, int keySize, HashTableNode** outPrev)
+{
+    int entryIndex = (int)(hash & (uint64_t)(table->size - 1));
+
+    HashTableNode* currNode = table->entries[entryIndex];
+    HashTableNode* prevNode = NULL;
+    int comparisons = 0;
+    while (currNode)
     {
-        HashTableNode* currNode = entry;
-        HashTableNode* prevNode = NULL;
-        while (currNode)
+        comparisons++;
+        if (currNode->hash == hash && currNode->keySize == keySize)
         {
-            if (currNode->keySize == keySize && memcmp(key, currNode->key, keySize) == 0)
+            HT_COUNTER_ADD(table, memcmpCalls, 1);
+            if (memcmp(key, sbData(&currNode->key, keySize), keySize) == 0)
             {
-                free(currNode->value);
-
-                currNode->value = malloc(valueSize);
-                currNode->valueSize = valueSize;
-                
-                memcpy(currNode->value, value, valueSize);
-                return currNode->value;
+                break;
             }
-
-            prevNode = currNode;
-            currNode = currNode->next;
         }
 
-        HashTableNode* newNode = obAcquire(table->nodePool);
-        if (!newNode)
-        {
-            Obstack* newPool = obNew(table->nodePool->objectSize, table->nodePool->objectCount);
-            if (newPool) 
-            {
-                newPool->next = table->nodePool;
-                table->nodePool = newPool;
+        prevNode = currNode;
+        currNode = currNode->next;
+    }
 
-                newNode = obAcquire(newPool);
-            }
-            else
-            {
-                return NULL;
-            }
-        }
+    HT_COUNT_LOOKUP(table, currNode != NULL, comparisons);
 
-        newNode->key = malloc(keySize);
-        newNode->keySize = keySize;
-        newNode->value = malloc(valueSize);
-        newNode->valueSize = valueSize;
-        newNode->next = NULL;
+    if (outPrev) *outPrev = prevNode;
+    return currNode;
+}
+
+void htRemoveHashed(HashTable* table, uint64_t hash, void* key, int keySize)
+{
+    HashTableNode* prevNode;
+    HashTableNode* currNode = searchNode(table, hash, key, keySize, &prevNode);
+    if (currNode)
+    {
+        table->count--;
+
+        sbFree(&currNode->key, currNode->keySize, table->arena, table->pool);
+        sbFree(&currNode->value, currNode->valueSize, table->arena, table->pool);
 
         if (prevNode)
         {
-            prevNode->next = newNode;
+            prevNode->next = currNode->next;
+        }
+        else
+        {
+            table->entries[hash & (uint64_t)(table->size - 1)] = currNode->next;
         }
 
-        memcpy(newNode->key, key, keySize);
-        memcpy(newNode->value, value, valueSize);
-        return newNode->value;
+        plRelease(table->nodePool, currNode, sizeof(HashTableNode));
+    }
+}
+
+void* htSearchHashed(HashTable* table, uint64_t hash, void* key, int keySize, int* outValueSize)
+{
+    HashTableNode* node = searchNode(table, hash, key, keySize, NULL);
+    if (!node)
+    {
+        return NULL;
+    }
+
+    if (outValueSize) *outValueSize = node->valueSize;
+    return sbData(&node->value, node->valueSize);
+}
+
+void* htInsertHashed(HashTable* table, uint64_t hash, void* key, int keySize, void* value, int valueSize)
+{
+    if (!value)
+    {
+        return NULL;
+    }
+
+    HashTableNode* prevNode;
+    HashTableNode* currNode = searchNode(table, hash, key, keySize, &prevNode);
+    if (currNode)
+    {
+        void* data = sbAssign(&currNode->value, currNode->valueSize, value, valueSize, table->arena, table->pool);
+        currNode->valueSize = data ? valueSize : 0;
+        return data;
+    }
+
+    HashTableNode* newNode = plAlloc(table->nodePool, sizeof(HashTableNode));
+    if (!newNode)
+    {
+        return NULL;
+    }
+
+    if (!sbInit(&newNode->key, key, keySize, table->arena, table->pool))
+    {
+        plRelease(table->nodePool, newNode, sizeof(HashTableNode));
+        return NULL;
+    }
+
+    if (!sbInit(&newNode->value, value, valueSize, table->arena, table->pool))
+    {
+        sbFree(&newNode->key, keySize, table->arena, table->pool);
+        plRelease(table->nodePool, newNode, sizeof(HashTableNode));
+        return NULL;
+    }
+
+    newNode->hash = hash;
+    newNode->keySize = keySize;
+    newNode->valueSize = valueSize;
+    newNode->next = NULL;
+
+    if (prevNode)
+    {
+        prevNode->next = newNode;
     }
     else
     {
-        entry = obAcquire(table->nodePool);
-        if (!entry)
+        table->entries[hash & (uint64_t)(table->size - 1)] = newNode;
+    }
+
+    table->count++;
+    return sbData(&newNode->value, valueSize);
+}
+
+void htRemove(HashTable* table, void* key, int keySize)
+{
+    htRemoveHashed(table, table->hashFn(key, keySize), key, keySize);
+}
+
+void* htSearch(HashTable* table, void* key, int keySize)
+{
+    return htSearchHashed(table, table->hashFn(key, keySize), key, keySize, NULL);
+}
+
+void* htInsert(HashTable* table, void* key, int keySize, void* value, int valueSize)
+{
+    return htInsertHashed(table, table->hashFn(key, keySize), key, keySize, value, valueSize);
+}
+
+void htSearchBatch(HashTable* table, void** keys, int* keySizes, int count, void** outValues)
+{
+    for (int i = 0; i < count; i++)
+    {
+        outValues[i] = htSearch(table, keys[i], keySizes[i]);
+    }
+}
+
+int htInsertBatch(HashTable* table, void** keys, int* keySizes, void** values, int* valueSizes, int count)
+{
+    int stored = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (htInsert(table, keys[i], keySizes[i], values[i], valueSizes[i]))
         {
-            Obstack* newPool = obNew(table->nodePool->objectSize, table->nodePool->objectCount);
-            if (newPool) 
-            {
-                newPool->next = table->nodePool;
-                table->nodePool = newPool;
-                
-                entry = obAcquire(newPool);
-            }
-            else
+            stored++;
+        }
+    }
+
+    return stored;
+}
+
+void htGetStats(HashTable* table, HashTableStats* outStats)
+{
+    memset(outStats, 0, sizeof(*outStats));
+
+    outStats->count       = table->count;
+    outStats->bucketCount = table->size;
+
+    for (int i = 0; i < table->size; i++)
+    {
+        int length = 0;
+        for (HashTableNode* node = table->entries[i]; node; node = node->next)
+        {
+            if (!table->arena && !table->pool)
             {
-                return NULL;
+                outStats->keyBytes   += node->keySize > SMALL_BUFFER_SIZE ? node->keySize : 0;
+                outStats->valueBytes += node->valueSize > SMALL_BUFFER_SIZE ? node->valueSize : 0;
             }
+
+            length++;
         }
 
-        entry->key = malloc(keySize);
-        entry->keySize = keySize;
-        entry->value = malloc(valueSize);
-        entry->valueSize = valueSize;
-        entry->next = NULL;
+        outStats->usedBuckets += length > 0;
+        htStatsAddLength(outStats, length);
+    }
+
+#ifdef HT_STATS
+    htCountersCopy(&table->counters, outStats);
+#endif
+
+    // Nodes live in the pool chunks, so they are accounted there rather than in entryBytes
+    outStats->tableBytes = sizeof(HashTable) + (long long)(table->size - 1) * sizeof(HashTableNode*);
 
-        table->count++;
-        table->entries[entryIndex] = entry;
+    outStats->poolBytes = sizeof(Pool) + table->nodePool->reserved;
 
-        memcpy(entry->key, key, keySize);
-        memcpy(entry->value, value, valueSize);
-        return entry->value;
+    if (table->arena)
+    {
+        outStats->poolBytes += sizeof(Arena) + table->arena->reserved;
     }
 }
 
-int htHash(void* key, int keySize, int tableSize)
+uint64_t htHash(void* key, int keySize)
 {
-    assert(tableSize > 0);
+    return murmurHash64(key, keySize, MURMUR_HASH_SEED);
+}
 
-    int sum = 0;
-    for (int i = 0; i < keySize; i++)
-    {
-        sum += ((unsigned char*)key)[i] * (i + 1);
-    }
+static void iterStart(HashTableIter* iter, HashTable* table, int begin, int end)
+{
+    iter->key       = NULL;
+    iter->value     = NULL;
+    iter->keySize   = 0;
+    iter->valueSize = 0;
 
-    return (sum % tableSize);
+    iter->internal.table  = table;
+    iter->internal.node   = NULL;
+    iter->internal.bucket = begin - 1;
+    iter->internal.index  = 0;
+    iter->internal.end    = end;
+}
+
+void htIterInit(HashTableIter* iter, HashTable* table)
+{
+    iterStart(iter, table, 0, table->size);
+}
+
+void htIterInitRange(HashTableIter* iter, HashTable* table, int part, int partCount)
+{
+    assert(partCount > 0 && part >= 0 && part < partCount);
+
+    // Parts are bucket ranges, a chain is never split
+    iterStart(iter, table, (int)((long long)table->size * part / partCount), (int)((long long)table->size * (part + 1) / partCount));
 }
 
 HashTableIter* htIterNew(HashTable* table)
 {
     HashTableIter* iter = malloc(sizeof(*iter));
-    iter->key = NULL;
-    iter->keySize = 0;
+    if (iter)
+    {
+        htIterInit(iter, table);
+    }
 
-    iter->value = NULL;
-    iter->valueSize = 0;
+    return iter;
+}
+
+HashTableIter* htIterNewRange(HashTable* table, int part, int partCount)
+{
+    HashTableIter* iter = malloc(sizeof(*iter));
+    if (iter)
+    {
+        htIterInitRange(iter, table, part, partCount);
+    }
 
-    iter->internal.table = table;
-    iter->internal.entry = NULL;
-    iter->internal.index = -1;
     return iter;
 }
 
@@ -268,52 +431,30 @@ void htIterFree(HashTableIter* iter)
 
 int htIterNext(HashTableIter* iter)
 {
-    HashTable* table = iter->internal.table;
+    HashTable*     table = iter->internal.table;
+    HashTableNode* node  = iter->internal.node;
 
-    int index = iter->internal.index;
-    if (iter->internal.entry == NULL || iter->internal.entry->next == NULL)
+    node = node ? node->next : NULL;
+    while (!node && iter->internal.bucket < iter->internal.end - 1)
     {
-        index++;
-        while (table->entries[index] == NULL && index < table->size)
-        {
-            index++;
-        }
-
-        if (index >= table->size)
-        {
-            iter->internal.entry = NULL;
-            iter->internal.index = table->size;
-
-            iter->key = NULL;
-            iter->keySize = 0;
-
-            iter->value = NULL;
-            iter->valueSize = 0;
-
-            return 0;
-        }
-        else
-        {
-            iter->internal.entry = table->entries[index];
-            iter->internal.index = index;
-
-            iter->key = iter->internal.entry->key;
-            iter->value = iter->internal.entry->value;
-            iter->keySize = iter->internal.entry->keySize;
-            iter->valueSize = iter->internal.entry->valueSize;
-
-            return 1;
-        }
+        node = table->entries[++iter->internal.bucket];
     }
-    else
+
+    iter->internal.node = node;
+    if (!node)
     {
-        iter->internal.entry = iter->internal.entry->next;
-        iter->key = iter->internal.entry->key;
-        iter->value = iter->internal.entry->value;
-        iter->keySize = iter->internal.entry->keySize;
-        iter->valueSize = iter->internal.entry->valueSize;
-        return 1;
+        iter->key       = NULL;
+        iter->value     = NULL;
+        iter->keySize   = 0;
+        iter->valueSize = 0;
+        return 0;
     }
+
+    iter->key       = sbData(&node->key, node->keySize);
+    iter->value     = sbData(&node->value, node->valueSize);
+    iter->keySize   = node->keySize;
+    iter->valueSize = node->valueSize;
+    return 1;
 }
 
 void* htIterGetKey(HashTableIter* iter)
@@ -325,3 +466,27 @@ void* htIterGetValue(HashTableIter* iter)
 {
     return iter->value;
 }
+
+int htIterGetKeySize(HashTableIter* iter)
+{
+    return iter->keySize;
+}
+
+int htIterGetValueSize(HashTableIter* iter)
+{
+    return iter->valueSize;
+}
+
+void htForEach(HashTable* table, int (*fn)(void* context, void* key, int keySize, void* value, int valueSize), void* context)
+{
+    for (int i = 0, n = table->size; i < n; i++)
+    {
+        for (HashTableNode* node = table->entries[i]; node; node = node->next)
+        {
+            if (fn(context, sbData(&node->key, node->keySize), node->keySize, sbData(&node->value, node->valueSize), node->valueSize))
+            {
+                return;
+            }
+        }
+    }
+}
@@ -0,0 +1,673 @@
+#include "../include/HashTable.h"
+#include "HashTableCounters.h"
+#include "MurmurHash.h"
+#include "SmallBuffer.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Grow the slot array when count / capacity would go above HT_MAX_LOAD_FACTOR.
+// Robin Hood probing keeps probe lengths short and even up to high loads.
+#ifndef HT_MAX_LOAD_FACTOR
+#define HT_MAX_LOAD_FACTOR 0.9f
+#endif
+
+// Number of keys htSearchBatch and htInsertBatch move through each stage together.
+#ifndef HT_BATCH_SIZE
+#define HT_BATCH_SIZE 16
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <xmmintrin.h>
+#define HT_PREFETCH(address) _mm_prefetch((const char*)(address), _MM_HINT_T0)
+#else
+#define HT_PREFETCH(address) __builtin_prefetch(address)
+#endif
+
+// Size of the first key/value arena chunk of tables made by htNewArena
+#ifndef HT_ARENA_CHUNK_SIZE
+#define HT_ARENA_CHUNK_SIZE 4096
+#endif
+
+#define MIN_CAPACITY 8
+
+// Distance bytes, one per slot: 0 for an empty slot, otherwise 1 + the number of slots
+// between the entry and its home slot. Longer distances, only reached with a poor hashFn,
+// saturate and are recomputed from the cached hash.
+#define DISTANCE_EMPTY      0
+#define DISTANCE_SATURATED  255
+
+typedef struct HashTableSlot
+{
+    uint64_t hash;
+
+    SmallBuffer key;
+    SmallBuffer value;
+
+    int keySize;
+    int valueSize;
+} HashTableSlot;
+
+struct HashTable
+{
+    uint64_t (*hashFn)(void*, int);
+
+    int count;
+    int capacity;       // Number of slots, power of two
+    int growthLimit;    // Count at which the next insert grows the table
+
+    uint8_t*       distances;
+    HashTableSlot* slots;
+
+    Arena*         arena;   // Owns key and value bytes, NULL when they are malloc'd
+    Pool*          pool;    // Same for tables made by htNewPooled
+
+#ifdef HT_STATS
+    HashTableCounters counters;
+#endif
+};
+
+static inline int growthOf(int capacity)
+{
+    int limit = (int)(capacity * HT_MAX_LOAD_FACTOR);
+    return limit < capacity ? limit : capacity - 1;
+}
+
+static inline uint8_t distanceByte(int distance)
+{
+    return (uint8_t)(distance < DISTANCE_SATURATED ? distance : DISTANCE_SATURATED);
+}
+
+// Probe distance of the entry in the full slot at index
+static inline int distanceAt(const HashTable* table, int index)
+{
+    int distance = table->distances[index];
+    if (distance == DISTANCE_SATURATED)
+    {
+        int mask = table->capacity - 1;
+        distance = ((index - (int)(table->slots[index].hash & (uint64_t)mask)) & mask) + 1;
+    }
+
+    return distance;
+}
+
+static int allocateSlots(HashTable* table, int capacity)
+{
+    uint8_t* distances = calloc(capacity, sizeof(uint8_t));
+    HashTableSlot* slots = malloc(capacity * sizeof(HashTableSlot));
+    if (!distances || !slots)
+    {
+        free(distances);
+        free(slots);
+        return 0;
+    }
+
+    table->distances   = distances;
+    table->slots       = slots;
+    table->capacity    = capacity;
+    table->growthLimit = growthOf(capacity);
+    return 1;
+}
+
+// Robin Hood insertion of an entry that is not in the table: walking its probe sequence,
+// every resident closer to its home than the carried entry gives up its slot and is carried on.
+// Returns the slot the entry ended up in.
+static int placeSlot(HashTable* table, const HashTableSlot* entry)
+{
+    int mask     = table->capacity - 1;
+    int index    = (int)(entry->hash & (uint64_t)mask);
+    int distance = 1;
+    int placed   = -1;
+
+    HashTableSlot carried = *entry;
+    for (;; index = (index + 1) & mask, distance++)
+    {
+        if (table->distances[index] == DISTANCE_EMPTY)
+        {
+            table->slots[index]     = carried;
+            table->distances[index] = distanceByte(distance);
+            return placed > -1 ? placed : index;
+        }
+
+        int residentDistance = distanceAt(table, index);
+        if (residentDistance < distance)
+        {
+            HashTableSlot resident = table->slots[index];
+            table->slots[index]     = carried;
+            table->distances[index] = distanceByte(distance);
+
+            carried  = resident;
+            distance = residentDistance;
+            if (placed < 0)
+            {
+                placed = index;
+            }
+        }
+    }
+}
+
+static int rehash(HashTable* table, int capacity)
+{
+    uint8_t*       oldDistances = table->distances;
+    HashTableSlot* oldSlots     = table->slots;
+    int            oldCapacity  = table->capacity;
+
+    if (!allocateSlots(table, capacity))
+    {
+        return 0;
+    }
+
+    HT_COUNTER_ADD(table, resizes, 1);
+
+    // Hashes are cached in the slots, hashFn is not called again
+    for (int i = 0; i < oldCapacity; i++)
+    {
+        if (oldDistances[i] != DISTANCE_EMPTY)
+        {
+            placeSlot(table, &oldSlots[i]);
+        }
+    }
+
+    free(oldDistances);
+    free(oldSlots);
+    return 1;
+}
+
+HashTable* htNew(int size, uint64_t (*hashFn)(void*, int))
+{
+    assert(size > 0);
+
+    int capacity = MIN_CAPACITY;
+    while (growthOf(capacity) < size)
+    {
+        capacity *= 2;
+    }
+
+    HashTable* table = malloc(sizeof(HashTable));
+    table->hashFn = hashFn ? hashFn : &htHash;
+    table->count  = 0;
+    table->arena  = NULL;
+    table->pool   = NULL;
+
+#ifdef HT_STATS
+    memset(&table->counters, 0, sizeof(table->counters));
+#endif
+
+    if (!allocateSlots(table, capacity))
+    {
+        free(table);
+        return NULL;
+    }
+
+    return table;
+}
+
+HashTable* htNewArena(int size, uint64_t (*hashFn)(void*, int))
+{
+    HashTable* table = htNew(size, hashFn);
+    if (table)
+    {
+        table->arena = arNew(HT_ARENA_CHUNK_SIZE);
+        if (!table->arena)
+        {
+            htFree(table);
+            return NULL;
+        }
+    }
+
+    return table;
+}
+
+HashTable* htNewPooled(int size, uint64_t (*hashFn)(void*, int))
+{
+    HashTable* table = htNew(size, hashFn);
+    if (table)
+    {
+        table->pool = plNew();
+        if (!table->pool)
+        {
+            htFree(table);
+            return NULL;
+        }
+    }
+
+    return table;
+}
+
+void htFree(HashTable* table)
+{
+    if (table->arena)
+    {
+        arFree(table->arena);
+    }
+    else if (table->pool)
+    {
+        plFree(table->pool);
+    }
+    else
+    {
+        for (int i = 0, n = table->capacity; i < n; i++)
+        {
+            if (table->distances[i] != DISTANCE_EMPTY)
+            {
+                HashTableSlot* slot = &table->slots[i];
+                sbFree(&slot->value, slot->valueSize, NULL, NULL);
+                sbFree(&slot->key, slot->keySize, NULL, NULL);
+            }
+        }
+    }
+
+    free(table->distances);
+    free(table->slots);
+    free(table);
+}
+
+static int indexOf(HashTable* table, void* key, int keySize, uint64_t hash)
+{
+    int mask        = table->capacity - 1;
+    int index       = (int)(hash & (uint64_t)mask);
+    int comparisons = 0;
+
+    for (int distance = 1; ; index = (index + 1) & mask, distance++)
+    {
+        // Entries are ordered by distance along a probe sequence: once a slot is empty or
+        // closer to its home than the key would be, the key would have taken that slot.
+        int slotDistance = table->distances[index];
+        if (slotDistance < distance && slotDistance != DISTANCE_SATURATED)
+        {
+            break;
+        }
+
+        // Only entries with the same home slot can hold the key
+        if (slotDistance == distanceByte(distance))
+        {
+            HashTableSlot* slot = &table->slots[index];
+            comparisons++;
+            if (slot->hash == hash && slot->keySize == keySize)
+            {
+                HT_COUNTER_ADD(table, memcmpCalls, 1);
+                if (memcmp(sbData(&slot->key, keySize), key, keySize) == 0)
+                {
+                    HT_COUNT_LOOKUP(table, 1, comparisons);
+                    return index;
+                }
+            }
+        }
+    }
+
+    HT_COUNT_LOOKUP(table, 0, comparisons);
+    return -1;
+}
+
+void* htInsertHashed(HashTable* table, uint64_t hash, void* key, int keySize, void* value, int valueSize)
+{
+    int index = indexOf(table, key, keySize, hash);
+    if (index > -1)
+    {
+        HashTableSlot* slot = &table->slots[index];
+
+        void* data = sbAssign(&slot->value, slot->valueSize, value, valueSize, table->arena, table->pool);
+        slot->valueSize = data ? valueSize : 0;
+        return data;
+    }
+
+    if (table->count >= table->growthLimit && !rehash(table, table->capacity * 2))
+    {
+        return NULL;
+    }
+
+    // Copy the key and value before placing, so a failed copy leaves the table untouched
+    HashTableSlot entry;
+    entry.hash      = hash;
+    entry.keySize   = keySize;
+    entry.valueSize = valueSize;
+
+    if (!sbInit(&entry.key, key, keySize, table->arena, table->pool))
+    {
+        return NULL;
+    }
+
+    if (!sbInit(&entry.value, value, valueSize, table->arena, table->pool))
+    {
+        sbFree(&entry.key, keySize, table->arena, table->pool);
+        return NULL;
+    }
+
+    HashTableSlot* slot = &table->slots[placeSlot(table, &entry)];
+    table->count++;
+    return sbData(&slot->value, valueSize);
+}
+
+HashTable* htBuildFromArrays(void** keys, int* keySizes, void** values, int* valueSizes, int count,
+                             HashTableDuplicates duplicates, uint64_t (*hashFn)(void*, int))
+{
+    // Sized once for every pair, so no insert below rehashes
+    HashTable* table = htNew(count > 0 ? count : 1, hashFn);
+    if (!table)
+    {
+        return NULL;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        uint64_t hash = table->hashFn(keys[i], keySizes[i]);
+        if (duplicates == HashTableDuplicates_FirstWins && indexOf(table, keys[i], keySizes[i], hash) > -1)
+        {
+            continue;
+        }
+
+        if (!htInsertHashed(table, hash, keys[i], keySizes[i], values[i], valueSizes[i]))
+        {
+            htFree(table);
+            return NULL;
+        }
+    }
+
+    return table;
+}
+
+int htCount(HashTable* table)
+{
+    return table->count;
+}
+
+void htRemoveHashed(HashTable* table, uint64_t hash, void* key, int keySize)
+{
+    int index = indexOf(table, key, keySize, hash);
+    if (index < 0)
+    {
+        return;
+    }
+
+    HashTableSlot* slot = &table->slots[index];
+    sbFree(&slot->value, slot->valueSize, table->arena, table->pool);
+    sbFree(&slot->key, slot->keySize, table->arena, table->pool);
+
+    // Backward shift: the entries following it in the probe sequence move one slot closer
+    // to their home, up to an empty slot or an entry already at home. No tombstone is left,
+    // so later probes are as short as if the key had never been inserted.
+    int mask = table->capacity - 1;
+    int next = (index + 1) & mask;
+    while (table->distances[next] > 1)
+    {
+        table->slots[index]     = table->slots[next];
+        table->distances[index] = distanceByte(distanceAt(table, next) - 1);
+
+        index = next;
+        next  = (next + 1) & mask;
+    }
+
+    table->distances[index] = DISTANCE_EMPTY;
+    table->count--;
+}
+
+void* htSearchHashed(HashTable* table, uint64_t hash, void* key, int keySize, int* outValueSize)
+{
+    int index = indexOf(table, key, keySize, hash);
+    if (index > -1)
+    {
+        HashTableSlot* slot = &table->slots[index];
+        if (outValueSize) *outValueSize = slot->valueSize;
+        return sbData(&slot->value, slot->valueSize);
+    }
+
+    return NULL;
+}
+
+void htRemove(HashTable* table, void* key, int keySize)
+{
+    htRemoveHashed(table, table->hashFn(key, keySize), key, keySize);
+}
+
+void* htSearch(HashTable* table, void* key, int keySize)
+{
+    return htSearchHashed(table, table->hashFn(key, keySize), key, keySize, NULL);
+}
+
+void* htInsert(HashTable* table, void* key, int keySize, void* value, int valueSize)
+{
+    return htInsertHashed(table, table->hashFn(key, keySize), key, keySize, value, valueSize);
+}
+
+void htSearchBatch(HashTable* table, void** keys, int* keySizes, int count, void** outValues)
+{
+    uint64_t hashs[HT_BATCH_SIZE];
+    uint64_t mask = (uint64_t)(table->capacity - 1);
+
+    for (int base = 0; base < count; base += HT_BATCH_SIZE)
+    {
+        int n = count - base < HT_BATCH_SIZE ? count - base : HT_BATCH_SIZE;
+
+        // Hash every key and start loading its home slot, probes rarely go past the next line
+        for (int i = 0; i < n; i++)
+        {
+            hashs[i] = table->hashFn(keys[base + i], keySizes[base + i]);
+            HT_PREFETCH(&table->distances[hashs[i] & mask]);
+            HT_PREFETCH(&table->slots[hashs[i] & mask]);
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            int index = indexOf(table, keys[base + i], keySizes[base + i], hashs[i]);
+            if (index > -1)
+            {
+                HashTableSlot* slot = &table->slots[index];
+                outValues[base + i] = sbData(&slot->value, slot->valueSize);
+            }
+            else
+            {
+                outValues[base + i] = NULL;
+            }
+        }
+    }
+}
+
+int htInsertBatch(HashTable* table, void** keys, int* keySizes, void** values, int* valueSizes, int count)
+{
+    // Size everything for the whole batch up front, so no rehash moves the prefetched slots
+    int capacity = table->capacity;
+    while (growthOf(capacity) < table->count + count)
+    {
+        capacity *= 2;
+    }
+
+    if (capacity != table->capacity)
+    {
+        rehash(table, capacity);
+    }
+
+    uint64_t hashs[HT_BATCH_SIZE];
+    int      stored = 0;
+
+    for (int base = 0; base < count; base += HT_BATCH_SIZE)
+    {
+        int n = count - base < HT_BATCH_SIZE ? count - base : HT_BATCH_SIZE;
+
+        uint64_t mask = (uint64_t)(table->capacity - 1);
+        for (int i = 0; i < n; i++)
+        {
+            hashs[i] = table->hashFn(keys[base + i], keySizes[base + i]);
+            HT_PREFETCH(&table->distances[hashs[i] & mask]);
+            HT_PREFETCH(&table->slots[hashs[i] & mask]);
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            int j = base + i;
+            if (htInsertHashed(table, hashs[i], keys[j], keySizes[j], values[j], valueSizes[j]))
+            {
+                stored++;
+            }
+        }
+    }
+
+    return stored;
+}
+
+void htGetStats(HashTable* table, HashTableStats* outStats)
+{
+    memset(outStats, 0, sizeof(*outStats));
+
+    outStats->count       = table->count;
+    outStats->bucketCount = table->capacity;
+    outStats->usedBuckets = table->count;
+
+    // Probe length of an entry: slots visited from its home slot to the one holding it
+    for (int i = 0; i < table->capacity; i++)
+    {
+        if (table->distances[i] != DISTANCE_EMPTY)
+        {
+            HashTableSlot* slot = &table->slots[i];
+            htStatsAddLength(outStats, distanceAt(table, i));
+
+            if (!table->arena && !table->pool)
+            {
+                outStats->keyBytes   += slot->keySize > SMALL_BUFFER_SIZE ? slot->keySize : 0;
+                outStats->valueBytes += slot->valueSize > SMALL_BUFFER_SIZE ? slot->valueSize : 0;
+            }
+        }
+    }
+
+#ifdef HT_STATS
+    htCountersCopy(&table->counters, outStats);
+#endif
+
+    outStats->tableBytes = sizeof(HashTable) + table->capacity;
+    outStats->entryBytes = (long long)table->capacity * sizeof(HashTableSlot);
+
+    if (table->arena)
+    {
+        outStats->poolBytes = sizeof(Arena) + table->arena->reserved;
+    }
+
+    if (table->pool)
+    {
+        outStats->poolBytes = sizeof(Pool) + table->pool->reserved;
+    }
+}
+
+uint64_t htHash(void* key, int keySize)
+{
+    return murmurHash64(key, keySize, MURMUR_HASH_SEED);
+}
+
+static void iterStart(HashTableIter* iter, HashTable* table, int begin, int end)
+{
+    iter->key       = NULL;
+    iter->value     = NULL;
+    iter->keySize   = 0;
+    iter->valueSize = 0;
+
+    iter->internal.table  = table;
+    iter->internal.node   = NULL;
+    iter->internal.bucket = -1;
+    iter->internal.index  = begin - 1;
+    iter->internal.end    = end;
+}
+
+void htIterInit(HashTableIter* iter, HashTable* table)
+{
+    iterStart(iter, table, 0, table->capacity);
+}
+
+void htIterInitRange(HashTableIter* iter, HashTable* table, int part, int partCount)
+{
+    assert(partCount > 0 && part >= 0 && part < partCount);
+
+    // Parts are slot ranges, full slots are spread evenly by the hash
+    iterStart(iter, table, (int)((long long)table->capacity * part / partCount), (int)((long long)table->capacity * (part + 1) / partCount));
+}
+
+HashTableIter* htIterNew(HashTable* table)
+{
+    HashTableIter* iter = malloc(sizeof(*iter));
+    if (iter)
+    {
+        htIterInit(iter, table);
+    }
+
+    return iter;
+}
+
+HashTableIter* htIterNewRange(HashTable* table, int part, int partCount)
+{
+    HashTableIter* iter = malloc(sizeof(*iter));
+    if (iter)
+    {
+        htIterInitRange(iter, table, part, partCount);
+    }
+
+    return iter;
+}
+
+void htIterFree(HashTableIter* iter)
+{
+    free(iter);
+}
+
+int htIterNext(HashTableIter* iter)
+{
+    HashTable* table = iter->internal.table;
+
+    int index = iter->internal.index + 1;
+    while (index < iter->internal.end && table->distances[index] == DISTANCE_EMPTY)
+    {
+        index++;
+    }
+
+    if (index >= iter->internal.end)
+    {
+        iter->internal.index = iter->internal.end;
+        iter->key       = NULL;
+        iter->value     = NULL;
+        iter->keySize   = 0;
+        iter->valueSize = 0;
+        return 0;
+    }
+
+    iter->internal.index = index;
+
+    HashTableSlot* slot = &table->slots[index];
+    iter->key       = sbData(&slot->key, slot->keySize);
+    iter->value     = sbData(&slot->value, slot->valueSize);
+    iter->keySize   = slot->keySize;
+    iter->valueSize = slot->valueSize;
+    return 1;
+}
+
+void* htIterGetKey(HashTableIter* iter)
+{
+    return iter->key;
+}
+
+void* htIterGetValue(HashTableIter* iter)
+{
+    return iter->value;
+}
+
+int htIterGetKeySize(HashTableIter* iter)
+{
+    return iter->keySize;
+}
+
+int htIterGetValueSize(HashTableIter* iter)
+{
+    return iter->valueSize;
+}
+
+void htForEach(HashTable* table, int (*fn)(void* context, void* key, int keySize, void* value, int valueSize), void* context)
+{
+    for (int i = 0, n = table->capacity; i < n; i++)
+    {
+        if (table->distances[i] != DISTANCE_EMPTY)
+        {
+            HashTableSlot* slot = &table->slots[i];
+            if (fn(context, sbData(&slot->key, slot->keySize), slot->keySize, sbData(&slot->value, slot->valueSize), slot->valueSize))
+            {
+                return;
+            }
+        }
+    }
+}
@@ -0,0 +1,755 @@
+#include "../include/HashTable.h"
+#include "HashTableCounters.h"
+#include "MurmurHash.h"
+#include "SmallBuffer.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define GROUP_WIDTH 32
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GROUP_WIDTH 16
+#else
+#define GROUP_WIDTH 8
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+// Control bytes, one per slot.
+// Full slots store the low 7 bits of the hash (the fingerprint), so the high bit is clear.
+#define CTRL_EMPTY      ((int8_t)-128)  // 0b10000000
+#define CTRL_DELETED    ((int8_t)-2)    // 0b11111110
+
+// Size of the first key/value arena chunk of tables made by htNewArena
+#ifndef HT_ARENA_CHUNK_SIZE
+#define HT_ARENA_CHUNK_SIZE 4096
+#endif
+
+typedef struct HashTableSlot
+{
+    uint64_t hash;      // Cached so rehashing and htGetStats never call hashFn
+
+    SmallBuffer key;
+    SmallBuffer value;
+
+    int keySize;
+    int valueSize;
+} HashTableSlot;
+
+struct HashTable
+{
+    uint64_t (*hashFn)(void*, int);
+
+    int count;
+    int deleted;
+    int capacity;       // Number of slots, power of two and multiple of GROUP_WIDTH
+    int growthLeft;     // Slots that can be filled before a rehash
+
+    int8_t*        ctrls;
+    HashTableSlot* slots;
+
+    Arena*         arena;   // Owns key and value bytes, NULL when they are malloc'd
+    Pool*          pool;    // Same for tables made by htNewPooled
+
+#ifdef HT_STATS
+    HashTableCounters counters;
+#endif
+};
+
+static inline int countTrailingZeros(uint64_t value)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return (int)index;
+#else
+    return __builtin_ctzll(value);
+#endif
+}
+
+// Group matching: each function returns a bitmask of the slots in the group that match.
+// Use groupMaskNext() to pop the lowest matching slot index.
+
+#if GROUP_WIDTH == 32
+
+typedef uint32_t GroupMask;
+
+static inline GroupMask groupMatch(const int8_t* ctrl, int8_t h2)
+{
+    __m256i group = _mm256_loadu_si256((const __m256i*)ctrl);
+    return (GroupMask)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_set1_epi8(h2), group));
+}
+
+static inline GroupMask groupMatchEmpty(const int8_t* ctrl)
+{
+    return groupMatch(ctrl, CTRL_EMPTY);
+}
+
+static inline GroupMask groupMatchEmptyOrDeleted(const int8_t* ctrl)
+{
+    // Empty and deleted are the only negative control bytes
+    __m256i group = _mm256_loadu_si256((const __m256i*)ctrl);
+    return (GroupMask)_mm256_movemask_epi8(group);
+}
+
+static inline GroupMask groupMatchFull(const int8_t* ctrl)
+{
+    return ~groupMatchEmptyOrDeleted(ctrl);
+}
+
+#define GROUP_MASK_SHIFT 0
+
+#elif GROUP_WIDTH == 16
+
+typedef uint32_t GroupMask;
+
+static inline GroupMask groupMatch(const int8_t* ctrl, int8_t h2)
+{
+    __m128i group = _mm_loadu_si128((const __m128i*)ctrl);
+    return (GroupMask)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), group));
+}
+
+static inline GroupMask groupMatchEmpty(const int8_t* ctrl)
+{
+    return groupMatch(ctrl, CTRL_EMPTY);
+}
+
+static inline GroupMask groupMatchEmptyOrDeleted(const int8_t* ctrl)
+{
+    __m128i group = _mm_loadu_si128((const __m128i*)ctrl);
+    return (GroupMask)_mm_movemask_epi8(group);
+}
+
+static inline GroupMask groupMatchFull(const int8_t* ctrl)
+{
+    return ~groupMatchEmptyOrDeleted(ctrl) & 0xffffu;
+}
+
+#define GROUP_MASK_SHIFT 0
+
+#else
+
+// Portable fallback: SWAR over 8 control bytes packed in a 64-bit word.
+// Matches are reported in the high bit of each byte.
+
+typedef uint64_t GroupMask;
+
+#define GROUP_LSBS 0x0101010101010101ull
+#define GROUP_MSBS 0x8080808080808080ull
+
+static inline uint64_t groupLoad(const int8_t* ctrl)
+{
+    uint64_t group;
+    memcpy(&group, ctrl, sizeof(group));
+    return group;
+}
+
+static inline GroupMask groupMatch(const int8_t* ctrl, int8_t h2)
+{
+    // May report false positives, they are rejected by the key comparison
+    uint64_t x = groupLoad(ctrl) ^ (GROUP_LSBS * (uint8_t)h2);
+    return (x - GROUP_LSBS) & ~x & GROUP_MSBS;
+}
+
+static inline GroupMask groupMatchEmpty(const int8_t* ctrl)
+{
+    uint64_t group = groupLoad(ctrl);
+    return group & ~(group << 6) & GROUP_MSBS;
+}
+
+static inline GroupMask groupMatchEmptyOrDeleted(const int8_t* ctrl)
+{
+    uint64_t group = groupLoad(ctrl);
+    return group & ~(group << 7) & GROUP_MSBS;
+}
+
+static inline GroupMask groupMatchFull(const int8_t* ctrl)
+{
+    // Full slots are the only ones with the high bit clear
+    return ~groupLoad(ctrl) & GROUP_MSBS;
+}
+
+#define GROUP_MASK_SHIFT 3
+
+#endif
+
+static inline int groupMaskNext(GroupMask* mask)
+{
+    int index = countTrailingZeros(*mask) >> GROUP_MASK_SHIFT;
+    *mask &= *mask - 1;
+    return index;
+}
+
+static inline int8_t h2Of(uint64_t hash)
+{
+    return (int8_t)(hash & 0x7f);
+}
+
+static inline int growthOf(int capacity)
+{
+    return capacity - capacity / 8;
+}
+
+static int allocateSlots(HashTable* table, int capacity)
+{
+    int8_t* ctrls = malloc(capacity);
+    HashTableSlot* slots = malloc(capacity * sizeof(HashTableSlot));
+    if (!ctrls || !slots)
+    {
+        free(ctrls);
+        free(slots);
+        return 0;
+    }
+
+    memset(ctrls, CTRL_EMPTY, capacity);
+
+    table->ctrls      = ctrls;
+    table->slots      = slots;
+    table->capacity   = capacity;
+    table->deleted    = 0;
+    table->growthLeft = growthOf(capacity) - table->count;
+    return 1;
+}
+
+// Find the first empty or deleted slot in the probe sequence of hash.
+static int findInsertSlot(HashTable* table, uint64_t hash)
+{
+    int groupMask = table->capacity / GROUP_WIDTH - 1;
+    int group     = (int)(hash >> 7) & groupMask;
+
+    for (int step = 1; ; step++)
+    {
+        int8_t*   ctrl = table->ctrls + group * GROUP_WIDTH;
+        GroupMask mask = groupMatchEmptyOrDeleted(ctrl);
+        if (mask)
+        {
+            return group * GROUP_WIDTH + groupMaskNext(&mask);
+        }
+
+        // Triangular probing over groups visits every group once for power-of-two counts
+        group = (group + step) & groupMask;
+    }
+}
+
+static int rehash(HashTable* table, int capacity)
+{
+    int8_t*        oldCtrls    = table->ctrls;
+    HashTableSlot* oldSlots    = table->slots;
+    int            oldCapacity = table->capacity;
+
+    if (!allocateSlots(table, capacity))
+    {
+        return 0;
+    }
+
+    HT_COUNTER_ADD(table, resizes, 1);
+
+    for (int i = 0; i < oldCapacity; i++)
+    {
+        if (oldCtrls[i] >= 0)
+        {
+            HashTableSlot* slot = &oldSlots[i];
+
+            int index = findInsertSlot(table, slot->hash);
+            table->ctrls[index] = h2Of(slot->hash);
+            table->slots[index] = *slot;
+        }
+    }
+
+    free(oldCtrls);
+    free(oldSlots);
+    return 1;
+}
+
+HashTable* htNew(int size, uint64_t (*hashFn)(void*, int))
+{
+    assert(size > 0);
+
+    int capacity = GROUP_WIDTH;
+    while (growthOf(capacity) < size)
+    {
+        capacity *= 2;
+    }
+
+    HashTable* table = malloc(sizeof(HashTable));
+    table->hashFn = hashFn ? hashFn : &htHash;
+    table->count  = 0;
+    table->arena  = NULL;
+    table->pool   = NULL;
+
+#ifdef HT_STATS
+    memset(&table->counters, 0, sizeof(table->counters));
+#endif
+
+    if (!allocateSlots(table, capacity))
+    {
+        free(table);
+        return NULL;
+    }
+
+    return table;
+}
+
+HashTable* htNewArena(int size, uint64_t (*hashFn)(void*, int))
+{
+    HashTable* table = htNew(size, hashFn);
+    if (table)
+    {
+        table->arena = arNew(HT_ARENA_CHUNK_SIZE);
+        if (!table->arena)
+        {
+            htFree(table);
+            return NULL;
+        }
+    }
+
+    return table;
+}
+
+HashTable* htNewPooled(int size, uint64_t (*hashFn)(void*, int))
+{
+    HashTable* table = htNew(size, hashFn);
+    if (table)
+    {
+        table->pool = plNew();
+        if (!table->pool)
+        {
+            htFree(table);
+            return NULL;
+        }
+    }
+
+    return table;
+}
+
+void htFree(HashTable* table)
+{
+    if (table->arena)
+    {
+        arFree(table->arena);
+    }
+    else if (table->pool)
+    {
+        plFree(table->pool);
+    }
+    else
+    {
+        for (int i = 0, n = table->capacity; i < n; i++)
+        {
+            if (table->ctrls[i] >= 0)
+            {
+                HashTableSlot* slot = &table->slots[i];
+                sbFree(&slot->value, slot->valueSize, NULL, NULL);
+                sbFree(&slot->key, slot->keySize, NULL, NULL);
+            }
+        }
+    }
+
+    free(table->ctrls);
+    free(table->slots);
+    free(table);
+}
+
+static int indexOf(HashTable* table, void* key, int keySize, uint64_t hash)
+{
+    int8_t h2        = h2Of(hash);
+    int    groupMask = table->capacity / GROUP_WIDTH - 1;
+    int    group     = (int)(hash >> 7) & groupMask;
+    int    comparisons = 0;
+
+    for (int step = 1; step <= groupMask + 1; step++)
+    {
+        int8_t*   ctrl = table->ctrls + group * GROUP_WIDTH;
+        GroupMask mask = groupMatch(ctrl, h2);
+        while (mask)
+        {
+            int index = group * GROUP_WIDTH + groupMaskNext(&mask);
+
+            // Only slots whose fingerprint matched are looked at
+            HashTableSlot* slot = &table->slots[index];
+            comparisons++;
+            if (slot->hash == hash && slot->keySize == keySize)
+            {
+                HT_COUNTER_ADD(table, memcmpCalls, 1);
+                if (memcmp(sbData(&slot->key, keySize), key, keySize) == 0)
+                {
+                    HT_COUNT_LOOKUP(table, 1, comparisons);
+                    return index;
+                }
+            }
+        }
+
+        if (groupMatchEmpty(ctrl))
+        {
+            break;
+        }
+
+        group = (group + step) & groupMask;
+    }
+
+    HT_COUNT_LOOKUP(table, 0, comparisons);
+    return -1;
+}
+
+HashTable* htBuildFromArrays(void** keys, int* keySizes, void** values, int* valueSizes, int count,
+                             HashTableDuplicates duplicates, uint64_t (*hashFn)(void*, int))
+{
+    // Sized once for every pair, so no insert below grows the table
+    HashTable* table = htNew(count > 0 ? count : 1, hashFn);
+    if (!table)
+    {
+        return NULL;
+    }
+
+    uint64_t* hashs = malloc((count > 0 ? count : 1) * sizeof(uint64_t));
+    if (!hashs)
+    {
+        htFree(table);
+        return NULL;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        hashs[i] = table->hashFn(keys[i], keySizes[i]);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (duplicates == HashTableDuplicates_FirstWins && htSearchHashed(table, hashs[i], keys[i], keySizes[i], NULL))
+        {
+            continue;
+        }
+
+        if (!htInsertHashed(table, hashs[i], keys[i], keySizes[i], values[i], valueSizes[i]))
+        {
+            free(hashs);
+            htFree(table);
+            return NULL;
+        }
+    }
+
+    free(hashs);
+    return table;
+}
+
+int htCount(HashTable* table)
+{
+    return table->count;
+}
+
+void htRemoveHashed(HashTable* table, uint64_t hash, void* key, int keySize)
+{
+    int index = indexOf(table, key, keySize, hash);
+    if (index > -1)
+    {
+        HashTableSlot* slot = &table->slots[index];
+        sbFree(&slot->value, slot->valueSize, table->arena, table->pool);
+        sbFree(&slot->key, slot->keySize, table->arena, table->pool);
+
+        // A group that still has an empty slot ends every probe sequence passing through it,
+        // so the slot can go back to empty. Otherwise leave a tombstone to keep probes going.
+        int8_t* group = table->ctrls + (index & ~(GROUP_WIDTH - 1));
+        if (groupMatchEmpty(group))
+        {
+            table->ctrls[index] = CTRL_EMPTY;
+            table->growthLeft++;
+        }
+        else
+        {
+            table->ctrls[index] = CTRL_DELETED;
+            table->deleted++;
+        }
+
+        table->count--;
+    }
+}
+
+void* htSearchHashed(HashTable* table, uint64_t hash, void* key, int keySize, int* outValueSize)
+{
+    int index = indexOf(table, key, keySize, hash);
+    if (index > -1)
+    {
+        HashTableSlot* slot = &table->slots[index];
+        if (outValueSize) *outValueSize = slot->valueSize;
+        return sbData(&slot->value, slot->valueSize);
+    }
+
+    return NULL;
+}
+
+void* htInsertHashed(HashTable* table, uint64_t hash, void* key, int keySize, void* value, int valueSize)
+{
+    int index = indexOf(table, key, keySize, hash);
+    if (index > -1)
+    {
+        HashTableSlot* slot = &table->slots[index];
+
+        void* data = sbAssign(&slot->value, slot->valueSize, value, valueSize, table->arena, table->pool);
+        slot->valueSize = data ? valueSize : 0;
+        return data;
+    }
+
+    index = findInsertSlot(table, hash);
+    if (table->growthLeft == 0 && table->ctrls[index] != CTRL_DELETED)
+    {
+        // Drop tombstones in place when they make up most of the load, grow otherwise
+        int capacity = table->count * 2 < growthOf(table->capacity) ? table->capacity : table->capacity * 2;
+        if (!rehash(table, capacity))
+        {
+            return NULL;
+        }
+
+        index = findInsertSlot(table, hash);
+    }
+
+    HashTableSlot* slot = &table->slots[index];
+    slot->hash = hash;
+    slot->keySize = keySize;
+    slot->valueSize = valueSize;
+
+    if (!sbInit(&slot->key, key, keySize, table->arena, table->pool))
+    {
+        return NULL;
+    }
+
+    if (!sbInit(&slot->value, value, valueSize, table->arena, table->pool))
+    {
+        sbFree(&slot->key, keySize, table->arena, table->pool);
+        return NULL;
+    }
+
+    if (table->ctrls[index] == CTRL_DELETED)
+    {
+        table->deleted--;
+    }
+    else
+    {
+        table->growthLeft--;
+    }
+
+    table->ctrls[index] = h2Of(hash);
+    table->count++;
+    return sbData(&slot->value, valueSize);
+}
+
+void htRemove(HashTable* table, void* key, int keySize)
+{
+    htRemoveHashed(table, table->hashFn(key, keySize), key, keySize);
+}
+
+void* htSearch(HashTable* table, void* key, int keySize)
+{
+    return htSearchHashed(table, table->hashFn(key, keySize), key, keySize, NULL);
+}
+
+void* htInsert(HashTable* table, void* key, int keySize, void* value, int valueSize)
+{
+    return htInsertHashed(table, table->hashFn(key, keySize), key, keySize, value, valueSize);
+}
+
+void htSearchBatch(HashTable* table, void** keys, int* keySizes, int count, void** outValues)
+{
+    for (int i = 0; i < count; i++)
+    {
+        outValues[i] = htSearch(table, keys[i], keySizes[i]);
+    }
+}
+
+int htInsertBatch(HashTable* table, void** keys, int* keySizes, void** values, int* valueSizes, int count)
+{
+    int stored = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (htInsert(table, keys[i], keySizes[i], values[i], valueSizes[i]))
+        {
+            stored++;
+        }
+    }
+
+    return stored;
+}
+
+void htGetStats(HashTable* table, HashTableStats* outStats)
+{
+    memset(outStats, 0, sizeof(*outStats));
+
+    outStats->count       = table->count;
+    outStats->bucketCount = table->capacity;
+    outStats->usedBuckets = table->count;
+
+    // Probe length of an entry: groups visited from its home group to the one holding it
+    int groupMask = table->capacity / GROUP_WIDTH - 1;
+    for (int i = 0; i < table->capacity; i++)
+    {
+        if (table->ctrls[i] >= 0)
+        {
+            HashTableSlot* slot = &table->slots[i];
+            int group = (int)(slot->hash >> 7) & groupMask;
+
+            int length = 1;
+            while (group != i / GROUP_WIDTH)
+            {
+                group = (group + length) & groupMask;
+                length++;
+            }
+
+            htStatsAddLength(outStats, length);
+
+            if (!table->arena && !table->pool)
+            {
+                outStats->keyBytes   += slot->keySize > SMALL_BUFFER_SIZE ? slot->keySize : 0;
+                outStats->valueBytes += slot->valueSize > SMALL_BUFFER_SIZE ? slot->valueSize : 0;
+            }
+        }
+    }
+
+#ifdef HT_STATS
+    htCountersCopy(&table->counters, outStats);
+#endif
+
+    outStats->tableBytes = sizeof(HashTable) + table->capacity;
+    outStats->entryBytes = (long long)table->capacity * sizeof(HashTableSlot);
+
+    if (table->arena)
+    {
+        outStats->poolBytes = sizeof(Arena) + table->arena->reserved;
+    }
+
+    if (table->pool)
+    {
+        outStats->poolBytes = sizeof(Pool) + table->pool->reserved;
+    }
+}
+
+uint64_t htHash(void* key, int keySize)
+{
+    return murmurHash64(key, keySize, MURMUR_HASH_SEED);
+}
+
+static void iterStart(HashTableIter* iter, HashTable* table, int begin, int end)
+{
+    iter->key       = NULL;
+    iter->value     = NULL;
+    iter->keySize   = 0;
+    iter->valueSize = 0;
+
+    iter->internal.table  = table;
+    iter->internal.node   = NULL;
+    iter->internal.bucket = -1;
+    iter->internal.index  = begin - 1;
+    iter->internal.end    = end;
+}
+
+void htIterInit(HashTableIter* iter, HashTable* table)
+{
+    iterStart(iter, table, 0, table->capacity);
+}
+
+void htIterInitRange(HashTableIter* iter, HashTable* table, int part, int partCount)
+{
+    assert(partCount > 0 && part >= 0 && part < partCount);
+
+    // Parts are slot ranges, full slots are spread evenly by the hash
+    iterStart(iter, table, (int)((long long)table->capacity * part / partCount), (int)((long long)table->capacity * (part + 1) / partCount));
+}
+
+HashTableIter* htIterNew(HashTable* table)
+{
+    HashTableIter* iter = malloc(sizeof(*iter));
+    if (iter)
+    {
+        htIterInit(iter, table);
+    }
+
+    return iter;
+}
+
+HashTableIter* htIterNewRange(HashTable* table, int part, int partCount)
+{
+    HashTableIter* iter = malloc(sizeof(*iter));
+    if (iter)
+    {
+        htIterInitRange(iter, table, part, partCount);
+    }
+
+    return iter;
+}
+
+void htIterFree(HashTableIter* iter)
+{
+    free(iter);
+}
+
+int htIterNext(HashTableIter* iter)
+{
+    HashTable* table = iter->internal.table;
+
+    int index = iter->internal.index + 1;
+    while (index < iter->internal.end && table->ctrls[index] < 0)
+    {
+        index++;
+    }
+
+    if (index >= iter->internal.end)
+    {
+        iter->internal.index = iter->internal.end;
+        iter->key       = NULL;
+        iter->value     = NULL;
+        iter->keySize   = 0;
+        iter->valueSize = 0;
+        return 0;
+    }
+
+    iter->internal.index = index;
+
+    HashTableSlot* slot = &table->slots[index];
+    iter->key       = sbData(&slot->key, slot->keySize);
+    iter->value     = sbData(&slot->value, slot->valueSize);
+    iter->keySize   = slot->keySize;
+    iter->valueSize = slot->valueSize;
+    return 1;
+}
+
+void* htIterGetKey(HashTableIter* iter)
+{
+    return iter->key;
+}
+
+void* htIterGetValue(HashTableIter* iter)
+{
+    return iter->value;
+}
+
+int htIterGetKeySize(HashTableIter* iter)
+{
+    return iter->keySize;
+}
+
+int htIterGetValueSize(HashTableIter* iter)
+{
+    return iter->valueSize;
+}
+
+void htForEach(HashTable* table, int (*fn)(void* context, void* key, int keySize, void* value, int valueSize), void* context)
+{
+    // Whole groups of control bytes at a time, empty and deleted runs are skipped in one step
+    for (int group = 0; group < table->capacity; group += GROUP_WIDTH)
+    {
+        GroupMask mask = groupMatchFull(table->ctrls + group);
+        while (mask)
+        {
+            HashTableSlot* slot = &table->slots[group + groupMaskNext(&mask)];
+            if (fn(context, sbData(&slot->key, slot->keySize), slot->keySize, sbData(&slot->value, slot->valueSize), slot->valueSize))
+            {
+                return;
+            }
+        }
+    }
+}
@@ -0,0 +1,481 @@
+#include "../include/MappedHashTable.h"
+#include "../include/HashTable.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Image layout, every section starts on an IMAGE_ALIGNMENT boundary:
+//   ImageHeader
+//   uint32_t    buckets[bucketCount + 1]   first entry of each bucket, the last one is count
+//   ImageEntry  entries[count]             sorted by bucket, offsets are from the file start
+//   key and value bytes
+#define IMAGE_MAGIC         "HTIMAGE"
+#define IMAGE_VERSION       1
+#define IMAGE_BYTE_ORDER    0x01020304u
+#define IMAGE_ALIGNMENT     8
+
+typedef struct ImageHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t byteOrder;     // Reads back differently on a machine with the other byte order
+
+    uint64_t fileSize;
+    uint64_t count;
+    uint64_t bucketCount;   // Power of two
+    uint64_t bucketsOffset;
+    uint64_t entriesOffset;
+} ImageHeader;
+
+typedef struct ImageEntry
+{
+    uint64_t hash;
+    uint64_t keyOffset;
+    uint64_t valueOffset;
+    uint32_t keySize;
+    uint32_t valueSize;
+} ImageEntry;
+
+struct MappedHashTable
+{
+    const char*         base;
+    size_t              size;
+
+    int                 count;
+    uint64_t            bucketMask;
+    const uint32_t*     buckets;
+    const ImageEntry*   entries;
+};
+
+struct MappedHashTableIter
+{
+    MappedHashTable*    table;
+    int                 index;
+};
+
+typedef struct SaveItem
+{
+    void* key;
+    void* value;
+    int   keySize;
+    int   valueSize;
+} SaveItem;
+
+static inline uint64_t alignOffset(uint64_t offset)
+{
+    return (offset + IMAGE_ALIGNMENT - 1) & ~(uint64_t)(IMAGE_ALIGNMENT - 1);
+}
+
+// Write size bytes followed by zeros up to the next aligned offset
+static int writePadded(FILE* file, const void* data, uint64_t size)
+{
+    static const char zeros[IMAGE_ALIGNMENT];
+
+    uint64_t padding = alignOffset(size) - size;
+    return fwrite(data, 1, (size_t)size, file) == size
+        && fwrite(zeros, 1, (size_t)padding, file) == padding;
+}
+
+static int writeImage(FILE* file, int count, SaveItem* items, int* order, uint32_t* buckets, uint64_t bucketCount)
+{
+    ImageHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+    header.version       = IMAGE_VERSION;
+    header.byteOrder     = IMAGE_BYTE_ORDER;
+    header.count         = (uint64_t)count;
+    header.bucketCount   = bucketCount;
+    header.bucketsOffset = alignOffset(sizeof(ImageHeader));
+    header.entriesOffset = header.bucketsOffset + alignOffset((bucketCount + 1) * sizeof(uint32_t));
+
+    // Lay out the key and value bytes in entry order, so a bucket's data is close together
+    uint64_t offset = header.entriesOffset + (uint64_t)count * sizeof(ImageEntry);
+    for (int i = 0; i < count; i++)
+    {
+        SaveItem* item = &items[order[i]];
+        offset = alignOffset(offset + item->keySize) + alignOffset(item->valueSize);
+    }
+    header.fileSize = offset;
+
+    if (!writePadded(file, &header, sizeof(header))
+        || !writePadded(file, buckets, (bucketCount + 1) * sizeof(uint32_t)))
+    {
+        return 0;
+    }
+
+    offset = header.entriesOffset + (uint64_t)count * sizeof(ImageEntry);
+    for (int i = 0; i < count; i++)
+    {
+        SaveItem* item = &items[order[i]];
+
+        ImageEntry entry;
+        entry.hash        = htHash(item->key, item->keySize);
+        entry.keyOffset   = offset;
+        entry.valueOffset = alignOffset(offset + item->keySize);
+        entry.keySize     = (uint32_t)item->keySize;
+        entry.valueSize   = (uint32_t)item->valueSize;
+
+        if (fwrite(&entry, sizeof(entry), 1, file) != 1)
+        {
+            return 0;
+        }
+
+        offset = entry.valueOffset + alignOffset(item->valueSize);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        SaveItem* item = &items[order[i]];
+        if (!writePadded(file, item->key, item->keySize) || !writePadded(file, item->value, item->valueSize))
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+int htSave(HashTable* table, const char* path)
+{
+    int count = htCount(table);
+
+    uint64_t bucketCount = 1;
+    while (bucketCount < (uint64_t)count)
+    {
+        bucketCount *= 2;
+    }
+
+    SaveItem* items   = malloc((count > 0 ? count : 1) * sizeof(SaveItem));
+    int*      order   = malloc((count > 0 ? count : 1) * sizeof(int));
+    uint32_t* buckets = calloc(bucketCount + 1, sizeof(uint32_t));
+    uint32_t* cursors = malloc(bucketCount * sizeof(uint32_t));
+    char*     tmpPath = malloc(strlen(path) + sizeof(".tmp"));
+    int       result  = 0;
+
+    if (!items || !order || !buckets || !cursors || !tmpPath)
+    {
+        goto cleanup;
+    }
+
+    // Counting sort of the entries by bucket, buckets[b + 1] first counts bucket b
+    int n = 0;
+    HT_FOREACH(iter, table)
+    {
+        if (n == count)
+        {
+            break;
+        }
+
+        SaveItem* item = &items[n++];
+        item->key       = iter.key;
+        item->keySize   = iter.keySize;
+        item->value     = iter.value;
+        item->valueSize = iter.valueSize;
+
+        buckets[(htHash(item->key, item->keySize) & (bucketCount - 1)) + 1]++;
+    }
+
+    for (uint64_t b = 0; b < bucketCount; b++)
+    {
+        buckets[b + 1] += buckets[b];
+        cursors[b] = buckets[b];
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        uint64_t bucket = htHash(items[i].key, items[i].keySize) & (bucketCount - 1);
+        order[cursors[bucket]++] = i;
+    }
+
+    sprintf(tmpPath, "%s.tmp", path);
+
+    FILE* file = fopen(tmpPath, "wb");
+    if (!file)
+    {
+        goto cleanup;
+    }
+
+    result = writeImage(file, n, items, order, buckets, bucketCount);
+    result = fclose(file) == 0 && result;
+
+#ifdef _WIN32
+    result = result && MoveFileExA(tmpPath, path, MOVEFILE_REPLACE_EXISTING);
+#else
+    result = result && rename(tmpPath, path) == 0;
+#endif
+
+    if (!result)
+    {
+        remove(tmpPath);
+    }
+
+cleanup:
+    free(tmpPath);
+    free(cursors);
+    free(buckets);
+    free(order);
+    free(items);
+    return result;
+}
+
+static void unmapImage(const char* base, size_t size)
+{
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(base);
+#else
+    munmap((void*)base, size);
+#endif
+}
+
+static const char* mapImage(const char* path, size_t* outSize)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return NULL;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)sizeof(ImageHeader))
+    {
+        CloseHandle(file);
+        return NULL;
+    }
+
+    // The view keeps the mapping alive, both handles can be closed right away
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping)
+    {
+        return NULL;
+    }
+
+    const char* base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+
+    *outSize = (size_t)size.QuadPart;
+    return base;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(ImageHeader))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    // The mapping keeps the file alive, the descriptor can be closed right away
+    void* base = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    *outSize = (size_t)info.st_size;
+    return base;
+#endif
+}
+
+// Every offset and index read by lookups and iteration is checked once here, so a truncated
+// or corrupted image is rejected instead of being read out of bounds later.
+static int validImage(const ImageHeader* header, size_t size)
+{
+    if (memcmp(header->magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0
+        || header->version != IMAGE_VERSION
+        || header->byteOrder != IMAGE_BYTE_ORDER
+        || header->fileSize != size)
+    {
+        return 0;
+    }
+
+    uint64_t bucketCount = header->bucketCount;
+    if (bucketCount == 0 || (bucketCount & (bucketCount - 1)) != 0 || bucketCount > size / sizeof(uint32_t))
+    {
+        return 0;
+    }
+
+    if (header->count > (uint64_t)0x7fffffff || header->count > size / sizeof(ImageEntry))
+    {
+        return 0;
+    }
+
+    if (header->bucketsOffset % IMAGE_ALIGNMENT != 0
+        || header->entriesOffset % IMAGE_ALIGNMENT != 0
+        || header->bucketsOffset > size
+        || header->entriesOffset > size
+        || (bucketCount + 1) * sizeof(uint32_t) > size - header->bucketsOffset
+        || header->count * sizeof(ImageEntry) > size - header->entriesOffset)
+    {
+        return 0;
+    }
+
+    // Buckets are ranges of entries: they start at 0, never go back and end at count
+    const uint32_t* buckets = (const uint32_t*)((const char*)header + header->bucketsOffset);
+    if (buckets[0] != 0 || buckets[bucketCount] != header->count)
+    {
+        return 0;
+    }
+
+    for (uint64_t b = 0; b < bucketCount; b++)
+    {
+        if (buckets[b] > buckets[b + 1])
+        {
+            return 0;
+        }
+    }
+
+    const ImageEntry* entries = (const ImageEntry*)((const char*)header + header->entriesOffset);
+    for (uint64_t i = 0; i < header->count; i++)
+    {
+        const ImageEntry* entry = &entries[i];
+        if (entry->keyOffset > size || entry->keySize > size - entry->keyOffset
+            || entry->valueOffset > size || entry->valueSize > size - entry->valueOffset)
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+MappedHashTable* htOpenMapped(const char* path)
+{
+    size_t size;
+    const char* base = mapImage(path, &size);
+    if (!base)
+    {
+        return NULL;
+    }
+
+    const ImageHeader* header = (const ImageHeader*)base;
+    if (!validImage(header, size))
+    {
+        unmapImage(base, size);
+        return NULL;
+    }
+
+    MappedHashTable* table = malloc(sizeof(MappedHashTable));
+    if (!table)
+    {
+        unmapImage(base, size);
+        return NULL;
+    }
+
+    table->base       = base;
+    table->size       = size;
+    table->count      = (int)header->count;
+    table->bucketMask = header->bucketCount - 1;
+    table->buckets    = (const uint32_t*)(base + header->bucketsOffset);
+    table->entries    = (const ImageEntry*)(base + header->entriesOffset);
+    return table;
+}
+
+void mhtClose(MappedHashTable* table)
+{
+    if (table)
+    {
+        unmapImage(table->base, table->size);
+        free(table);
+    }
+}
+
+int mhtCount(MappedHashTable* table)
+{
+    return table->count;
+}
+
+const void* mhtSearch(MappedHashTable* table, const void* key, int keySize)
+{
+    uint64_t hash   = htHash((void*)key, keySize);
+    uint64_t bucket = hash & table->bucketMask;
+
+    for (uint32_t i = table->buckets[bucket], n = table->buckets[bucket + 1]; i < n; i++)
+    {
+        const ImageEntry* entry = &table->entries[i];
+        if (entry->hash == hash && entry->keySize == (uint32_t)keySize && memcmp(table->base + entry->keyOffset, key, keySize) == 0)
+        {
+            return table->base + entry->valueOffset;
+        }
+    }
+
+    return NULL;
+}
+
+MappedHashTableIter* mhtIterNew(MappedHashTable* table)
+{
+    MappedHashTableIter* iter = malloc(sizeof(*iter));
+    iter->table = table;
+    iter->index = -1;
+
+    return iter;
+}
+
+void mhtIterFree(MappedHashTableIter* iter)
+{
+    free(iter);
+}
+
+int mhtIterNext(MappedHashTableIter* iter)
+{
+    if (iter->index < iter->table->count - 1)
+    {
+        iter->index++;
+        return 1;
+    }
+
+    iter->index = iter->table->count;
+    return 0;
+}
+
+static const ImageEntry* iterEntry(MappedHashTableIter* iter)
+{
+    if (iter->index > -1 && iter->index < iter->table->count)
+    {
+        return &iter->table->entries[iter->index];
+    }
+
+    return NULL;
+}
+
+const void* mhtIterGetKey(MappedHashTableIter* iter)
+{
+    const ImageEntry* entry = iterEntry(iter);
+    return entry ? iter->table->base + entry->keyOffset : NULL;
+}
+
+const void* mhtIterGetValue(MappedHashTableIter* iter)
+{
+    const ImageEntry* entry = iterEntry(iter);
+    return entry ? iter->table->base + entry->valueOffset : NULL;
+}
+
+int mhtIterGetKeySize(MappedHashTableIter* iter)
+{
+    const ImageEntry* entry = iterEntry(iter);
+    return entry ? (int)entry->keySize : 0;
+}
+
+int mhtIterGetValueSize(MappedHashTableIter* iter)
+{
+    const ImageEntry* entry = iterEntry(iter);
+    return entry ? (int)entry->valueSize : 0;
+}
@@ -1,11 +1,110 @@
 #include "MurmurHash.h"
 
+#include <string.h>
+
+// MurmurHash3 x86_32 and MurmurHash64A by Austin Appleby, public domain.
+// Blocks are read with memcpy so unaligned keys are fine on every platform.
+
+static inline uint32_t rotl32(uint32_t x, int r)
+{
+    return (x << r) | (x >> (32 - r));
+}
+
+static inline uint32_t fmix32(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
 uint32_t murmurHash32(void* buffer, int length, uint32_t seed)
 {
-    return seed;   
+    const uint8_t* data = (const uint8_t*)buffer;
+    const int nblocks = length / 4;
+
+    const uint32_t c1 = 0xcc9e2d51u;
+    const uint32_t c2 = 0x1b873593u;
+
+    uint32_t h = seed;
+
+    for (int i = 0; i < nblocks; i++)
+    {
+        uint32_t k;
+        memcpy(&k, data + i * 4, sizeof(k));
+
+        k *= c1;
+        k = rotl32(k, 15);
+        k *= c2;
+
+        h ^= k;
+        h = rotl32(h, 13);
+        h = h * 5 + 0xe6546b64u;
+    }
+
+    const uint8_t* tail = data + nblocks * 4;
+    uint32_t k = 0;
+    switch (length & 3)
+    {
+        case 3:
+            k ^= (uint32_t)tail[2] << 16;
+            /* fallthrough */
+        case 2:
+            k ^= (uint32_t)tail[1] << 8;
+            /* fallthrough */
+        case 1:
+            k ^= (uint32_t)tail[0];
+            k *= c1;
+            k = rotl32(k, 15);
+            k *= c2;
+            h ^= k;
+    }
+
+    h ^= (uint32_t)length;
+    return fmix32(h);
 }
 
 uint64_t murmurHash64(void* buffer, int length, uint64_t seed)
 {
-    return seed;
+    const uint64_t m = 0xc6a4a7935bd1e995ull;
+    const int      r = 47;
+
+    const uint8_t* data = (const uint8_t*)buffer;
+    const int nblocks = length / 8;
+
+    uint64_t h = seed ^ ((uint64_t)length * m);
+
+    // Bulk path, 8 bytes per round
+    for (int i = 0; i < nblocks; i++)
+    {
+        uint64_t k;
+        memcpy(&k, data + i * 8, sizeof(k));
+
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+
+        h ^= k;
+        h *= m;
+    }
+
+    const uint8_t* tail = data + nblocks * 8;
+    switch (length & 7)
+    {
+        case 7: h ^= (uint64_t)tail[6] << 48; /* fallthrough */
+        case 6: h ^= (uint64_t)tail[5] << 40; /* fallthrough */
+        case 5: h ^= (uint64_t)tail[4] << 32; /* fallthrough */
+        case 4: h ^= (uint64_t)tail[3] << 24; /* fallthrough */
+        case 3: h ^= (uint64_t)tail[2] << 16; /* fallthrough */
+        case 2: h ^= (uint64_t)tail[1] << 8;  /* fallthrough */
+        case 1: h ^= (uint64_t)tail[0];
+                h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
 }
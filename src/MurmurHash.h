@@ -2,5 +2,7 @@
 
 #include <stdint.h>
 
+#define MURMUR_HASH_SEED 0x9747b28cu
+
 uint32_t murmurHash32(void* buffer, int length, uint32_t seed);
-uint64_t murmurHash64(void* buffer, int length, uint64_t seed);
\ No newline at end of file
+uint64_t murmurHash64(void* buffer, int length, uint64_t seed);
@@ -0,0 +1,892 @@
+#include "PersistentBundle.h"
+#include "MurmurHash.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define strdup _strdup
+#endif
+
+// Each branch level consumes TRIE_BITS of the key hash, keys whose 64 bits are all equal
+// end up together in a collision node below the last level
+#define TRIE_BITS       5
+#define TRIE_MASK       ((1u << TRIE_BITS) - 1)
+#define TRIE_HASH_BITS  64
+
+typedef enum TrieKind
+{
+    TrieKind_Leaf,
+    TrieKind_Branch,
+    TrieKind_Collision,
+} TrieKind;
+
+// Nodes are never changed once reachable from a version, they are shared instead
+typedef struct TrieNode
+{
+    int32_t     refCount;
+    uint8_t     kind;
+    uint8_t     type;       // Type of a leaf value
+    uint16_t    count;      // Children of a branch or collision node
+} TrieNode;
+
+// Variant, with the child versions Type_Bundle holds here
+typedef union TrieValue
+{
+    Variant             variant;
+    PersistentBundle*   bundle;
+} TrieValue;
+
+typedef struct TrieLeaf
+{
+    TrieNode    header;
+    const char* key;        // Interned
+    TrieValue   value;
+} TrieLeaf;
+
+// Branches keep only the children present in bitmap, in hash fragment order.
+// Collision nodes hold leaves of identical hashes and leave bitmap at 0.
+typedef struct TrieBranch
+{
+    TrieNode    header;
+    uint32_t    bitmap;
+    TrieNode*   children[];
+} TrieBranch;
+
+struct PersistentBundle
+{
+    int32_t     refCount;
+    int32_t     count;
+    TrieNode*   root;       // NULL when empty
+};
+
+static inline int popCount(uint32_t value)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    return (int)__popcnt(value);
+#else
+    return __builtin_popcount(value);
+#endif
+}
+
+static inline TrieNode* retainNode(TrieNode* node)
+{
+    node->refCount++;
+    return node;
+}
+
+static void releaseValue(uint8_t type, TrieValue* value)
+{
+    switch (type)
+    {
+        case Type_String:
+            free((char*)value->variant.asString);
+            break;
+
+        case Type_Bundle:
+            pbRelease(value->bundle);
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void releaseNode(TrieNode* node)
+{
+    if (!node || --node->refCount > 0)
+    {
+        return;
+    }
+
+    if (node->kind == TrieKind_Leaf)
+    {
+        releaseValue(node->type, &((TrieLeaf*)node)->value);
+    }
+    else
+    {
+        TrieBranch* branch = (TrieBranch*)node;
+        for (int i = 0; i < node->count; i++)
+        {
+            releaseNode(branch->children[i]);
+        }
+    }
+
+    free(node);
+}
+
+static TrieBranch* newBranch(TrieKind kind, int count)
+{
+    TrieBranch* branch = malloc(sizeof(TrieBranch) + count * sizeof(TrieNode*));
+    if (!branch)
+    {
+        return NULL;
+    }
+
+    branch->header.refCount = 1;
+    branch->header.kind     = (uint8_t)kind;
+    branch->header.type     = 0;
+    branch->header.count    = (uint16_t)count;
+    branch->bitmap          = 0;
+    return branch;
+}
+
+static inline int keyMatches(const char* leafKey, const char* key, int interned)
+{
+    return interned ? leafKey == key : strcmp(leafKey, key) == 0;
+}
+
+// key is compared by pointer when interned, by content otherwise
+static const TrieLeaf* trieFind(const TrieNode* node, const char* key, uint64_t hash, int interned)
+{
+    for (int shift = 0; node; shift += TRIE_BITS)
+    {
+        if (node->kind == TrieKind_Leaf)
+        {
+            const TrieLeaf* leaf = (const TrieLeaf*)node;
+            return keyMatches(leaf->key, key, interned) ? leaf : NULL;
+        }
+
+        const TrieBranch* branch = (const TrieBranch*)node;
+        if (node->kind == TrieKind_Collision)
+        {
+            for (int i = 0; i < node->count; i++)
+            {
+                const TrieLeaf* leaf = (const TrieLeaf*)branch->children[i];
+                if (keyMatches(leaf->key, key, interned))
+                {
+                    return leaf;
+                }
+            }
+
+            return NULL;
+        }
+
+        uint32_t bit = 1u << ((hash >> shift) & TRIE_MASK);
+        if (!(branch->bitmap & bit))
+        {
+            return NULL;
+        }
+
+        node = branch->children[popCount(branch->bitmap & (bit - 1))];
+    }
+
+    return NULL;
+}
+
+// Node holding both leaves, whose hashes agree below shift. Retains existing and takes over
+// the reference to leaf, returns a new reference or NULL when out of memory.
+static TrieNode* mergeLeaves(TrieLeaf* existing, uint64_t existingHash, TrieLeaf* leaf, uint64_t hash, int shift)
+{
+    if (shift >= TRIE_HASH_BITS)
+    {
+        TrieBranch* collision = newBranch(TrieKind_Collision, 2);
+        if (!collision)
+        {
+            releaseNode(&leaf->header);
+            return NULL;
+        }
+
+        collision->children[0] = retainNode(&existing->header);
+        collision->children[1] = &leaf->header;
+        return &collision->header;
+    }
+
+    uint32_t existingFragment = (existingHash >> shift) & TRIE_MASK;
+    uint32_t fragment         = (hash >> shift) & TRIE_MASK;
+    if (existingFragment == fragment)
+    {
+        TrieNode* child = mergeLeaves(existing, existingHash, leaf, hash, shift + TRIE_BITS);
+        if (!child)
+        {
+            return NULL;
+        }
+
+        TrieBranch* branch = newBranch(TrieKind_Branch, 1);
+        if (!branch)
+        {
+            releaseNode(child);
+            return NULL;
+        }
+
+        branch->bitmap      = 1u << fragment;
+        branch->children[0] = child;
+        return &branch->header;
+    }
+
+    TrieBranch* branch = newBranch(TrieKind_Branch, 2);
+    if (!branch)
+    {
+        releaseNode(&leaf->header);
+        return NULL;
+    }
+
+    branch->bitmap = (1u << existingFragment) | (1u << fragment);
+    branch->children[existingFragment < fragment ? 0 : 1] = retainNode(&existing->header);
+    branch->children[existingFragment < fragment ? 1 : 0] = &leaf->header;
+    return &branch->header;
+}
+
+// Copy of branch with child at index, replacing the child there or inserted before it.
+// Takes over the reference to child, retains the others.
+static TrieNode* copyBranchWith(const TrieBranch* branch, uint32_t bitmap, int index, TrieNode* child, int insert)
+{
+    int count = branch->header.count + (insert ? 1 : 0);
+
+    TrieBranch* copy = newBranch((TrieKind)branch->header.kind, count);
+    if (!copy)
+    {
+        releaseNode(child);
+        return NULL;
+    }
+
+    copy->bitmap = bitmap;
+    for (int i = 0, from = 0; i < count; i++)
+    {
+        if (i == index)
+        {
+            copy->children[i] = child;
+            from += insert ? 0 : 1;
+        }
+        else
+        {
+            copy->children[i] = retainNode(branch->children[from++]);
+        }
+    }
+
+    return &copy->header;
+}
+
+// Copy of branch without the child at index, retaining the others
+static TrieNode* copyBranchWithout(const TrieBranch* branch, uint32_t bitmap, int index)
+{
+    TrieBranch* copy = newBranch((TrieKind)branch->header.kind, branch->header.count - 1);
+    if (!copy)
+    {
+        return NULL;
+    }
+
+    copy->bitmap = bitmap;
+    for (int i = 0, to = 0; i < branch->header.count; i++)
+    {
+        if (i != index)
+        {
+            copy->children[to++] = retainNode(branch->children[i]);
+        }
+    }
+
+    return &copy->header;
+}
+
+// Copy of the path from node to the key of leaf with leaf at its end, every other node shared.
+// Takes over the reference to leaf, returns a new reference or NULL when out of memory.
+static TrieNode* trieSet(TrieNode* node, TrieLeaf* leaf, uint64_t hash, int shift, int* added)
+{
+    if (!node)
+    {
+        *added = 1;
+        return &leaf->header;
+    }
+
+    if (node->kind == TrieKind_Leaf)
+    {
+        TrieLeaf* existing = (TrieLeaf*)node;
+        if (existing->key == leaf->key)
+        {
+            return &leaf->header;
+        }
+
+        *added = 1;
+        return mergeLeaves(existing, bundleKeyHash(existing->key), leaf, hash, shift);
+    }
+
+    TrieBranch* branch = (TrieBranch*)node;
+    if (node->kind == TrieKind_Collision)
+    {
+        for (int i = 0; i < node->count; i++)
+        {
+            if (((TrieLeaf*)branch->children[i])->key == leaf->key)
+            {
+                return copyBranchWith(branch, 0, i, &leaf->header, 0);
+            }
+        }
+
+        *added = 1;
+        return copyBranchWith(branch, 0, node->count, &leaf->header, 1);
+    }
+
+    uint32_t bit   = 1u << ((hash >> shift) & TRIE_MASK);
+    int      index = popCount(branch->bitmap & (bit - 1));
+    if (!(branch->bitmap & bit))
+    {
+        *added = 1;
+        return copyBranchWith(branch, branch->bitmap | bit, index, &leaf->header, 1);
+    }
+
+    TrieNode* child = trieSet(branch->children[index], leaf, hash, shift + TRIE_BITS, added);
+    if (!child)
+    {
+        return NULL;
+    }
+
+    return copyBranchWith(branch, branch->bitmap, index, child, 0);
+}
+
+// Copy of the path from node to key without it, NULL when nothing is left.
+// status is 1 when the key was removed, 0 when it is not there and -1 when out of memory.
+// A branch left with a single leaf is replaced by the leaf, keeping paths as short as the keys require.
+static TrieNode* trieRemove(TrieNode* node, const char* key, uint64_t hash, int interned, int shift, int* status)
+{
+    *status = 0;
+    if (!node)
+    {
+        return NULL;
+    }
+
+    if (node->kind == TrieKind_Leaf)
+    {
+        *status = keyMatches(((TrieLeaf*)node)->key, key, interned);
+        return NULL;
+    }
+
+    TrieBranch* branch = (TrieBranch*)node;
+    TrieNode*   result = NULL;
+    if (node->kind == TrieKind_Collision)
+    {
+        int index = -1;
+        for (int i = 0; i < node->count && index < 0; i++)
+        {
+            index = keyMatches(((TrieLeaf*)branch->children[i])->key, key, interned) ? i : -1;
+        }
+
+        if (index < 0)
+        {
+            return NULL;
+        }
+
+        result = node->count == 2 ? retainNode(branch->children[1 - index]) : copyBranchWithout(branch, 0, index);
+        *status = result ? 1 : -1;
+        return result;
+    }
+
+    uint32_t bit   = 1u << ((hash >> shift) & TRIE_MASK);
+    int      index = popCount(branch->bitmap & (bit - 1));
+    if (!(branch->bitmap & bit))
+    {
+        return NULL;
+    }
+
+    TrieNode* child = trieRemove(branch->children[index], key, hash, interned, shift + TRIE_BITS, status);
+    if (*status != 1)
+    {
+        return NULL;
+    }
+
+    if (!child)
+    {
+        TrieNode* other = node->count == 2 ? branch->children[1 - index] : NULL;
+        if (node->count == 1)
+        {
+            return NULL;
+        }
+
+        result = other && other->kind == TrieKind_Leaf ? retainNode(other) : copyBranchWithout(branch, branch->bitmap & ~bit, index);
+    }
+    else if (node->count == 1 && child->kind == TrieKind_Leaf)
+    {
+        return child;
+    }
+    else
+    {
+        result = copyBranchWith(branch, branch->bitmap, index, child, 0);
+    }
+
+    *status = result ? 1 : -1;
+    return result;
+}
+
+static PersistentBundle* newVersion(TrieNode* root, int count)
+{
+    PersistentBundle* version = malloc(sizeof(PersistentBundle));
+    if (!version)
+    {
+        releaseNode(root);
+        return NULL;
+    }
+
+    version->refCount = 1;
+    version->count    = count;
+    version->root     = root;
+    return version;
+}
+
+PersistentBundle* pbNew(void)
+{
+    return newVersion(NULL, 0);
+}
+
+PersistentBundle* pbRetain(PersistentBundle* bundle)
+{
+    if (bundle)
+    {
+        bundle->refCount++;
+    }
+
+    return bundle;
+}
+
+void pbRelease(PersistentBundle* bundle)
+{
+    if (bundle && --bundle->refCount == 0)
+    {
+        releaseNode(bundle->root);
+        free(bundle);
+    }
+}
+
+int pbCount(const PersistentBundle* bundle)
+{
+    return bundle->count;
+}
+
+// New version with key holding value, takes over the string or child version in value
+static PersistentBundle* setValue(PersistentBundle* bundle, BundleKey key, Type type, TrieValue value)
+{
+    TrieLeaf* leaf = key.string ? malloc(sizeof(TrieLeaf)) : NULL;
+    if (!leaf)
+    {
+        releaseValue((uint8_t)type, &value);
+        return NULL;
+    }
+
+    leaf->header.refCount = 1;
+    leaf->header.kind     = TrieKind_Leaf;
+    leaf->header.type     = (uint8_t)type;
+    leaf->header.count    = 0;
+    leaf->key             = key.string;
+    leaf->value           = value;
+
+    int added = 0;
+    TrieNode* root = trieSet(bundle->root, leaf, key.hash, 0, &added);
+    if (!root)
+    {
+        return NULL;
+    }
+
+    return newVersion(root, bundle->count + added);
+}
+
+static PersistentBundle* removeValue(PersistentBundle* bundle, const char* key, uint64_t hash, int interned)
+{
+    int status = 0;
+    TrieNode* root = trieRemove(bundle->root, key, hash, interned, 0, &status);
+    if (status <= 0)
+    {
+        return status == 0 ? pbRetain(bundle) : NULL;
+    }
+
+    return newVersion(root, bundle->count - 1);
+}
+
+PersistentBundle* pbRemove(PersistentBundle* bundle, const char* key)
+{
+    return removeValue(bundle, key, murmurHash64((void*)key, (int)strlen(key), MURMUR_HASH_SEED), 0);
+}
+
+PersistentBundle* pbRemoveKey(PersistentBundle* bundle, BundleKey key)
+{
+    return key.string ? removeValue(bundle, key.string, key.hash, 1) : pbRetain(bundle);
+}
+
+PersistentBundle* pbFromBundle(const Bundle* bundle)
+{
+    PersistentBundle* version = pbNew();
+
+    const uint8_t* types = bundleTypes(bundle);
+    for (int i = 0; version && i < bundle->count; i++)
+    {
+        const char* key = bundle->shape->keys[i];
+
+        TrieValue value;
+        value.variant = bundle->values[i];
+        if (types[i] == Type_String)
+        {
+            value.variant.asString = strdup(value.variant.asString);
+            if (!value.variant.asString)
+            {
+                pbRelease(version);
+                return NULL;
+            }
+        }
+        else if (types[i] == Type_Bundle && value.variant.asBundle)
+        {
+            value.bundle = pbFromBundle(bundle->values[i].asBundle);
+            if (!value.bundle)
+            {
+                pbRelease(version);
+                return NULL;
+            }
+        }
+        else if (types[i] == Type_Bundle)
+        {
+            value.bundle = NULL;
+        }
+
+        // Versions in between are only referenced here, each one is released as soon as it is replaced
+        BundleKey         bundleKey = { key, bundleKeyHash(key) };
+        PersistentBundle* next      = setValue(version, bundleKey, (Type)types[i], value);
+        pbRelease(version);
+        version = next;
+    }
+
+    return version;
+}
+
+static const TrieLeaf* findLeaf(const PersistentBundle* bundle, const char* key)
+{
+    return trieFind(bundle->root, key, murmurHash64((void*)key, (int)strlen(key), MURMUR_HASH_SEED), 0);
+}
+
+static const TrieLeaf* findLeafKey(const PersistentBundle* bundle, BundleKey key)
+{
+    return key.string ? trieFind(bundle->root, key.string, key.hash, 1) : NULL;
+}
+
+int8_t pbGetI8(const PersistentBundle* bundle, const char* key)
+{
+    const TrieLeaf* leaf = findLeaf(bundle, key);
+    return leaf && leaf->header.type == Type_I8 ? leaf->value.variant.asI8 : 0;
+}
+
+uint8_t pbGetU8(const PersistentBundle* bundle, const char* key)
+{
+    const TrieLeaf* leaf = findLeaf(bundle, key);
+    return leaf && leaf->header.type == Type_U8 ? leaf->value.variant.asU8 : 0;
+}
+
+int16_t pbGetI16(const PersistentBundle* bundle, const char* key)
+{
+    const TrieLeaf* leaf = findLeaf(bundle, key);
+    return leaf && leaf->header.type == Type_I16 ? leaf->value.variant.asI16 : 0;
+}
+
+uint16_t pbGetU16(const PersistentBundle* bundle, const char* key)
+{
+    const TrieLeaf* leaf = findLeaf(bundle, key);
+    return leaf && leaf->header.type == Type_U16 ? leaf->value.variant.asU16 : 0;
+}
+
+int32_t pbGetI32(const PersistentBundle* bundle, const char* key)
+{
+    const TrieLeaf* leaf = findLeaf(bundle, key);
+    return leaf && leaf->header.type == Type_I32 ? leaf->value.variant.asI32 : 0;
+}
+
+uint32_t pbGetU32(const PersistentBundle* bundle, const char* key)
+{
+    const TrieLeaf* leaf = findLeaf(bundle, key);
+    return leaf && leaf->header.type == Type_U32 ? leaf->value.variant.asU32 : 0;
+}
+
+int64_t pbGetI64(const PersistentBundle* bundle, const char* key)
+{
+    const TrieLeaf* leaf = findLeaf(bundle, key);
+    return leaf && leaf->header.type == Type_I64 ? leaf->value.variant.asI64 : 0;
+}
+
+uint64_t pbGetU64(const PersistentBundle* bundle, const char* key)
+{
+    const TrieLeaf* leaf = findLeaf(bundle, key);
+    return leaf && leaf->header.type == Type_U64 ? leaf->value.variant.asU64 : 0;
+}
+
+float pbGetFloat(const PersistentBundle* bundle, const char* key)
+{
+    const TrieLeaf* leaf = findLeaf(bundle, key);
+    return leaf && leaf->header.type == Type_Float ? leaf->value.variant.asFloat : 0;
+}
+
+double pbGetDouble(const PersistentBundle* bundle, const char* key)
+{
+    const TrieLeaf* leaf = findLeaf(bundle, key);
+    return leaf && leaf->header.type == Type_Double ? leaf->value.variant.asDouble : 0;
+}
+
+const char* pbGetString(const PersistentBundle* bundle, const char* key)
+{
+    const TrieLeaf* leaf = findLeaf(bundle, key);
+    return leaf && leaf->header.type == Type_String ? leaf->value.variant.asString : "";
+}
+
+PersistentBundle* pbGetBundle(const PersistentBundle* bundle, const char* key)
+{
+    const TrieLeaf* leaf = findLeaf(bundle, key);
+    return leaf && leaf->header.type == Type_Bundle ? leaf->value.bundle : NULL;
+}
+
+void* pbGetCustom(const PersistentBundle* bundle, const char* key)
+{
+    const TrieLeaf* leaf = findLeaf(bundle, key);
+    return leaf && leaf->header.type == Type_Custom ? leaf->value.variant.asCustom : NULL;
+}
+
+int8_t pbGetI8Key(const PersistentBundle* bundle, BundleKey key)
+{
+    const TrieLeaf* leaf = findLeafKey(bundle, key);
+    return leaf && leaf->header.type == Type_I8 ? leaf->value.variant.asI8 : 0;
+}
+
+uint8_t pbGetU8Key(const PersistentBundle* bundle, BundleKey key)
+{
+    const TrieLeaf* leaf = findLeafKey(bundle, key);
+    return leaf && leaf->header.type == Type_U8 ? leaf->value.variant.asU8 : 0;
+}
+
+int16_t pbGetI16Key(const PersistentBundle* bundle, BundleKey key)
+{
+    const TrieLeaf* leaf = findLeafKey(bundle, key);
+    return leaf && leaf->header.type == Type_I16 ? leaf->value.variant.asI16 : 0;
+}
+
+uint16_t pbGetU16Key(const PersistentBundle* bundle, BundleKey key)
+{
+    const TrieLeaf* leaf = findLeafKey(bundle, key);
+    return leaf && leaf->header.type == Type_U16 ? leaf->value.variant.asU16 : 0;
+}
+
+int32_t pbGetI32Key(const PersistentBundle* bundle, BundleKey key)
+{
+    const TrieLeaf* leaf = findLeafKey(bundle, key);
+    return leaf && leaf->header.type == Type_I32 ? leaf->value.variant.asI32 : 0;
+}
+
+uint32_t pbGetU32Key(const PersistentBundle* bundle, BundleKey key)
+{
+    const TrieLeaf* leaf = findLeafKey(bundle, key);
+    return leaf && leaf->header.type == Type_U32 ? leaf->value.variant.asU32 : 0;
+}
+
+int64_t pbGetI64Key(const PersistentBundle* bundle, BundleKey key)
+{
+    const TrieLeaf* leaf = findLeafKey(bundle, key);
+    return leaf && leaf->header.type == Type_I64 ? leaf->value.variant.asI64 : 0;
+}
+
+uint64_t pbGetU64Key(const PersistentBundle* bundle, BundleKey key)
+{
+    const TrieLeaf* leaf = findLeafKey(bundle, key);
+    return leaf && leaf->header.type == Type_U64 ? leaf->value.variant.asU64 : 0;
+}
+
+float pbGetFloatKey(const PersistentBundle* bundle, BundleKey key)
+{
+    const TrieLeaf* leaf = findLeafKey(bundle, key);
+    return leaf && leaf->header.type == Type_Float ? leaf->value.variant.asFloat : 0;
+}
+
+double pbGetDoubleKey(const PersistentBundle* bundle, BundleKey key)
+{
+    const TrieLeaf* leaf = findLeafKey(bundle, key);
+    return leaf && leaf->header.type == Type_Double ? leaf->value.variant.asDouble : 0;
+}
+
+const char* pbGetStringKey(const PersistentBundle* bundle, BundleKey key)
+{
+    const TrieLeaf* leaf = findLeafKey(bundle, key);
+    return leaf && leaf->header.type == Type_String ? leaf->value.variant.asString : "";
+}
+
+PersistentBundle* pbGetBundleKey(const PersistentBundle* bundle, BundleKey key)
+{
+    const TrieLeaf* leaf = findLeafKey(bundle, key);
+    return leaf && leaf->header.type == Type_Bundle ? leaf->value.bundle : NULL;
+}
+
+void* pbGetCustomKey(const PersistentBundle* bundle, BundleKey key)
+{
+    const TrieLeaf* leaf = findLeafKey(bundle, key);
+    return leaf && leaf->header.type == Type_Custom ? leaf->value.variant.asCustom : NULL;
+}
+
+PersistentBundle* pbSetI8(PersistentBundle* bundle, const char* key, int8_t value)
+{
+    TrieValue scalar;
+    scalar.variant.asI8 = value;
+    return setValue(bundle, bundleIntern(key), Type_I8, scalar);
+}
+
+PersistentBundle* pbSetU8(PersistentBundle* bundle, const char* key, uint8_t value)
+{
+    TrieValue scalar;
+    scalar.variant.asU8 = value;
+    return setValue(bundle, bundleIntern(key), Type_U8, scalar);
+}
+
+PersistentBundle* pbSetI16(PersistentBundle* bundle, const char* key, int16_t value)
+{
+    TrieValue scalar;
+    scalar.variant.asI16 = value;
+    return setValue(bundle, bundleIntern(key), Type_I16, scalar);
+}
+
+PersistentBundle* pbSetU16(PersistentBundle* bundle, const char* key, uint16_t value)
+{
+    TrieValue scalar;
+    scalar.variant.asU16 = value;
+    return setValue(bundle, bundleIntern(key), Type_U16, scalar);
+}
+
+PersistentBundle* pbSetI32(PersistentBundle* bundle, const char* key, int32_t value)
+{
+    TrieValue scalar;
+    scalar.variant.asI32 = value;
+    return setValue(bundle, bundleIntern(key), Type_I32, scalar);
+}
+
+PersistentBundle* pbSetU32(PersistentBundle* bundle, const char* key, uint32_t value)
+{
+    TrieValue scalar;
+    scalar.variant.asU32 = value;
+    return setValue(bundle, bundleIntern(key), Type_U32, scalar);
+}
+
+PersistentBundle* pbSetI64(PersistentBundle* bundle, const char* key, int64_t value)
+{
+    TrieValue scalar;
+    scalar.variant.asI64 = value;
+    return setValue(bundle, bundleIntern(key), Type_I64, scalar);
+}
+
+PersistentBundle* pbSetU64(PersistentBundle* bundle, const char* key, uint64_t value)
+{
+    TrieValue scalar;
+    scalar.variant.asU64 = value;
+    return setValue(bundle, bundleIntern(key), Type_U64, scalar);
+}
+
+PersistentBundle* pbSetFloat(PersistentBundle* bundle, const char* key, float value)
+{
+    TrieValue scalar;
+    scalar.variant.asFloat = value;
+    return setValue(bundle, bundleIntern(key), Type_Float, scalar);
+}
+
+PersistentBundle* pbSetDouble(PersistentBundle* bundle, const char* key, double value)
+{
+    TrieValue scalar;
+    scalar.variant.asDouble = value;
+    return setValue(bundle, bundleIntern(key), Type_Double, scalar);
+}
+
+PersistentBundle* pbSetString(PersistentBundle* bundle, const char* key, const char* value)
+{
+    TrieValue copy;
+    copy.variant.asString = strdup(value);
+    return copy.variant.asString ? setValue(bundle, bundleIntern(key), Type_String, copy) : NULL;
+}
+
+PersistentBundle* pbSetBundle(PersistentBundle* bundle, const char* key, PersistentBundle* value)
+{
+    TrieValue child;
+    child.bundle = pbRetain(value);
+    return setValue(bundle, bundleIntern(key), Type_Bundle, child);
+}
+
+PersistentBundle* pbSetCustom(PersistentBundle* bundle, const char* key, void* value)
+{
+    TrieValue scalar;
+    scalar.variant.asCustom = value;
+    return setValue(bundle, bundleIntern(key), Type_Custom, scalar);
+}
+
+PersistentBundle* pbSetI8Key(PersistentBundle* bundle, BundleKey key, int8_t value)
+{
+    TrieValue scalar;
+    scalar.variant.asI8 = value;
+    return setValue(bundle, key, Type_I8, scalar);
+}
+
+PersistentBundle* pbSetU8Key(PersistentBundle* bundle, BundleKey key, uint8_t value)
+{
+    TrieValue scalar;
+    scalar.variant.asU8 = value;
+    return setValue(bundle, key, Type_U8, scalar);
+}
+
+PersistentBundle* pbSetI16Key(PersistentBundle* bundle, BundleKey key, int16_t value)
+{
+    TrieValue scalar;
+    scalar.variant.asI16 = value;
+    return setValue(bundle, key, Type_I16, scalar);
+}
+
+PersistentBundle* pbSetU16Key(PersistentBundle* bundle, BundleKey key, uint16_t value)
+{
+    TrieValue scalar;
+    scalar.variant.asU16 = value;
+    return setValue(bundle, key, Type_U16, scalar);
+}
+
+PersistentBundle* pbSetI32Key(PersistentBundle* bundle, BundleKey key, int32_t value)
+{
+    TrieValue scalar;
+    scalar.variant.asI32 = value;
+    return setValue(bundle, key, Type_I32, scalar);
+}
+
+PersistentBundle* pbSetU32Key(PersistentBundle* bundle, BundleKey key, uint32_t value)
+{
+    TrieValue scalar;
+    scalar.variant.asU32 = value;
+    return setValue(bundle, key, Type_U32, scalar);
+}
+
+PersistentBundle* pbSetI64Key(PersistentBundle* bundle, BundleKey key, int64_t value)
+{
+    TrieValue scalar;
+    scalar.variant.asI64 = value;
+    return setValue(bundle, key, Type_I64, scalar);
+}
+
+PersistentBundle* pbSetU64Key(PersistentBundle* bundle, BundleKey key, uint64_t value)
+{
+    TrieValue scalar;
+    scalar.variant.asU64 = value;
+    return setValue(bundle, key, Type_U64, scalar);
+}
+
+PersistentBundle* pbSetFloatKey(PersistentBundle* bundle, BundleKey key, float value)
+{
+    TrieValue scalar;
+    scalar.variant.asFloat = value;
+    return setValue(bundle, key, Type_Float, scalar);
+}
+
+PersistentBundle* pbSetDoubleKey(PersistentBundle* bundle, BundleKey key, double value)
+{
+    TrieValue scalar;
+    scalar.variant.asDouble = value;
+    return setValue(bundle, key, Type_Double, scalar);
+}
+
+PersistentBundle* pbSetStringKey(PersistentBundle* bundle, BundleKey key, const char* value)
+{
+    TrieValue copy;
+    copy.variant.asString = strdup(value);
+    return copy.variant.asString ? setValue(bundle, key, Type_String, copy) : NULL;
+}
+
+PersistentBundle* pbSetBundleKey(PersistentBundle* bundle, BundleKey key, PersistentBundle* value)
+{
+    TrieValue child;
+    child.bundle = pbRetain(value);
+    return setValue(bundle, key, Type_Bundle, child);
+}
+
+PersistentBundle* pbSetCustomKey(PersistentBundle* bundle, BundleKey key, void* value)
+{
+    TrieValue scalar;
+    scalar.variant.asCustom = value;
+    return setValue(bundle, key, Type_Custom, scalar);
+}
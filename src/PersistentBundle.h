@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Bundle.h"
+
+// Immutable Bundle versions stored in a hash array mapped trie.
+// A setter returns a new version and leaves the one it was given untouched: only the
+// path from the root to the changed key is copied, one small node per 5 bits of hash,
+// and every other subtree, key and string is shared with the old version.
+// Copying a version is pbRetain, changing a field costs O(log n) allocations.
+//
+// Versions and the nodes they share are reference counted. Every version returned by
+// pbNew, pbFromBundle or a setter holds one reference and must be given to pbRelease.
+// Setters return NULL when out of memory, the version passed in stays valid either way.
+// Reference counts are not atomic, share versions between threads behind a lock.
+//
+// Keys are interned like Bundle keys and values use the same Types and defaults.
+// Type_Bundle values are child versions, retained by the version holding them.
+
+typedef struct PersistentBundle PersistentBundle;
+
+PersistentBundle*       pbNew(void);
+
+// Deep conversion of a mutable bundle, child bundles become child versions
+PersistentBundle*       pbFromBundle(const Bundle* bundle);
+
+PersistentBundle*       pbRetain(PersistentBundle* bundle);
+void                    pbRelease(PersistentBundle* bundle);
+
+int                     pbCount(const PersistentBundle* bundle);
+
+// Returns a new reference to bundle itself when key is not there
+PersistentBundle*       pbRemove(PersistentBundle* bundle, const char* key);
+PersistentBundle*       pbRemoveKey(PersistentBundle* bundle, BundleKey key);
+
+int8_t                  pbGetI8(const PersistentBundle* bundle, const char* key);
+uint8_t                 pbGetU8(const PersistentBundle* bundle, const char* key);
+int16_t                 pbGetI16(const PersistentBundle* bundle, const char* key);
+uint16_t                pbGetU16(const PersistentBundle* bundle, const char* key);
+int32_t                 pbGetI32(const PersistentBundle* bundle, const char* key);
+uint32_t                pbGetU32(const PersistentBundle* bundle, const char* key);
+int64_t                 pbGetI64(const PersistentBundle* bundle, const char* key);
+uint64_t                pbGetU64(const PersistentBundle* bundle, const char* key);
+float                   pbGetFloat(const PersistentBundle* bundle, const char* key);
+double                  pbGetDouble(const PersistentBundle* bundle, const char* key);
+const char*             pbGetString(const PersistentBundle* bundle, const char* key);
+PersistentBundle*       pbGetBundle(const PersistentBundle* bundle, const char* key);
+void*                   pbGetCustom(const PersistentBundle* bundle, const char* key);
+
+int8_t                  pbGetI8Key(const PersistentBundle* bundle, BundleKey key);
+uint8_t                 pbGetU8Key(const PersistentBundle* bundle, BundleKey key);
+int16_t                 pbGetI16Key(const PersistentBundle* bundle, BundleKey key);
+uint16_t                pbGetU16Key(const PersistentBundle* bundle, BundleKey key);
+int32_t                 pbGetI32Key(const PersistentBundle* bundle, BundleKey key);
+uint32_t                pbGetU32Key(const PersistentBundle* bundle, BundleKey key);
+int64_t                 pbGetI64Key(const PersistentBundle* bundle, BundleKey key);
+uint64_t                pbGetU64Key(const PersistentBundle* bundle, BundleKey key);
+float                   pbGetFloatKey(const PersistentBundle* bundle, BundleKey key);
+double                  pbGetDoubleKey(const PersistentBundle* bundle, BundleKey key);
+const char*             pbGetStringKey(const PersistentBundle* bundle, BundleKey key);
+PersistentBundle*       pbGetBundleKey(const PersistentBundle* bundle, BundleKey key);
+void*                   pbGetCustomKey(const PersistentBundle* bundle, BundleKey key);
+
+// Strings are copied once into the new version and shared by the versions derived from it.
+// A child version is retained, the caller keeps its own reference.
+PersistentBundle*       pbSetI8(PersistentBundle* bundle, const char* key, int8_t value);
+PersistentBundle*       pbSetU8(PersistentBundle* bundle, const char* key, uint8_t value);
+PersistentBundle*       pbSetI16(PersistentBundle* bundle, const char* key, int16_t value);
+PersistentBundle*       pbSetU16(PersistentBundle* bundle, const char* key, uint16_t value);
+PersistentBundle*       pbSetI32(PersistentBundle* bundle, const char* key, int32_t value);
+PersistentBundle*       pbSetU32(PersistentBundle* bundle, const char* key, uint32_t value);
+PersistentBundle*       pbSetI64(PersistentBundle* bundle, const char* key, int64_t value);
+PersistentBundle*       pbSetU64(PersistentBundle* bundle, const char* key, uint64_t value);
+PersistentBundle*       pbSetFloat(PersistentBundle* bundle, const char* key, float value);
+PersistentBundle*       pbSetDouble(PersistentBundle* bundle, const char* key, double value);
+PersistentBundle*       pbSetString(PersistentBundle* bundle, const char* key, const char* value);
+PersistentBundle*       pbSetBundle(PersistentBundle* bundle, const char* key, PersistentBundle* value);
+PersistentBundle*       pbSetCustom(PersistentBundle* bundle, const char* key, void* value);
+
+PersistentBundle*       pbSetI8Key(PersistentBundle* bundle, BundleKey key, int8_t value);
+PersistentBundle*       pbSetU8Key(PersistentBundle* bundle, BundleKey key, uint8_t value);
+PersistentBundle*       pbSetI16Key(PersistentBundle* bundle, BundleKey key, int16_t value);
+PersistentBundle*       pbSetU16Key(PersistentBundle* bundle, BundleKey key, uint16_t value);
+PersistentBundle*       pbSetI32Key(PersistentBundle* bundle, BundleKey key, int32_t value);
+PersistentBundle*       pbSetU32Key(PersistentBundle* bundle, BundleKey key, uint32_t value);
+PersistentBundle*       pbSetI64Key(PersistentBundle* bundle, BundleKey key, int64_t value);
+PersistentBundle*       pbSetU64Key(PersistentBundle* bundle, BundleKey key, uint64_t value);
+PersistentBundle*       pbSetFloatKey(PersistentBundle* bundle, BundleKey key, float value);
+PersistentBundle*       pbSetDoubleKey(PersistentBundle* bundle, BundleKey key, double value);
+PersistentBundle*       pbSetStringKey(PersistentBundle* bundle, BundleKey key, const char* value);
+PersistentBundle*       pbSetBundleKey(PersistentBundle* bundle, BundleKey key, PersistentBundle* value);
+PersistentBundle*       pbSetCustomKey(PersistentBundle* bundle, BundleKey key, void* value);
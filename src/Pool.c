@@ -0,0 +1,347 @@
+#include "Pool.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define POOL_ALIGNMENT      16
+#define POOL_MIN_CHUNK      4096
+#define POOL_MAX_CHUNK      (256 << 10)
+
+struct PoolChunk
+{
+    PoolChunk*  prev;           // Neighbours in the partial list of the class
+    PoolChunk*  next;
+    void*       free;           // Released blocks, linked through their first bytes
+
+    int         classIndex;
+    int         blockCount;
+    int         used;           // Blocks handed out
+    int         fresh;          // Blocks at the end of the chunk never handed out yet
+    int         inPartial;
+};
+
+struct PoolLarge
+{
+    PoolLarge*  prev;
+    PoolLarge*  next;
+};
+
+// Keep the blocks aligned
+#define POOL_CHUNK_HEADER   ((sizeof(PoolChunk) + POOL_ALIGNMENT - 1) & ~(POOL_ALIGNMENT - 1))
+#define POOL_LARGE_HEADER   ((sizeof(PoolLarge) + POOL_ALIGNMENT - 1) & ~(POOL_ALIGNMENT - 1))
+
+// 16 byte steps up to 128, then four classes per power of two up to POOL_MAX_BLOCK
+static int classOf(int size)
+{
+    if (size <= 128)
+    {
+        return (size - 1) >> 4;
+    }
+
+    int shift = 7;
+    while ((size - 1) >> (shift + 1))
+    {
+        shift++;
+    }
+
+    return 8 + (shift - 7) * 4 + (((size - 1) >> (shift - 2)) & 3);
+}
+
+static int classSize(int classIndex)
+{
+    if (classIndex < 8)
+    {
+        return (classIndex + 1) * 16;
+    }
+
+    int shift = 7 + (classIndex - 8) / 4;
+    return (1 << shift) + ((classIndex - 8) % 4 + 1) * (1 << (shift - 2));
+}
+
+Pool* plNew(void)
+{
+    Pool* pool = malloc(sizeof(Pool));
+    if (pool)
+    {
+        for (int i = 0; i < POOL_CLASS_COUNT; i++)
+        {
+            PoolClass* poolClass = &pool->classes[i];
+            poolClass->blockSize   = classSize(i);
+            poolClass->chunkBlocks = POOL_MIN_CHUNK / poolClass->blockSize;
+            poolClass->emptyChunks = 0;
+            poolClass->partial     = NULL;
+        }
+
+        pool->chunks        = NULL;
+        pool->chunkCount    = 0;
+        pool->chunkCapacity = 0;
+        pool->large         = NULL;
+        pool->reserved      = 0;
+        pool->allocated     = 0;
+    }
+
+    return pool;
+}
+
+void plFree(Pool* pool)
+{
+    if (pool)
+    {
+        for (int i = 0; i < pool->chunkCount; i++)
+        {
+            free(pool->chunks[i]);
+        }
+        free(pool->chunks);
+
+        PoolLarge* large = pool->large;
+        while (large)
+        {
+            PoolLarge* next = large->next;
+            free(large);
+            large = next;
+        }
+
+        free(pool);
+    }
+}
+
+static void partialPush(PoolClass* poolClass, PoolChunk* chunk)
+{
+    chunk->prev = NULL;
+    chunk->next = poolClass->partial;
+    if (poolClass->partial)
+    {
+        poolClass->partial->prev = chunk;
+    }
+
+    poolClass->partial = chunk;
+    chunk->inPartial = 1;
+}
+
+static void partialRemove(PoolClass* poolClass, PoolChunk* chunk)
+{
+    if (chunk->prev)
+    {
+        chunk->prev->next = chunk->next;
+    }
+    else
+    {
+        poolClass->partial = chunk->next;
+    }
+
+    if (chunk->next)
+    {
+        chunk->next->prev = chunk->prev;
+    }
+
+    chunk->inPartial = 0;
+}
+
+// Index of the last chunk starting at or below address
+static int chunkIndexOf(Pool* pool, uintptr_t address)
+{
+    int low  = 0;
+    int high = pool->chunkCount - 1;
+    while (low < high)
+    {
+        int mid = (low + high + 1) / 2;
+        if ((uintptr_t)pool->chunks[mid] <= address)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+
+    return low;
+}
+
+static PoolChunk* newChunk(Pool* pool, int classIndex)
+{
+    PoolClass* poolClass = &pool->classes[classIndex];
+
+    if (pool->chunkCount == pool->chunkCapacity)
+    {
+        int capacity = pool->chunkCapacity > 0 ? pool->chunkCapacity * 2 : 16;
+        PoolChunk** chunks = realloc(pool->chunks, capacity * sizeof(PoolChunk*));
+        if (!chunks)
+        {
+            return NULL;
+        }
+
+        pool->chunks = chunks;
+        pool->chunkCapacity = capacity;
+    }
+
+    size_t size = POOL_CHUNK_HEADER + (size_t)poolClass->chunkBlocks * poolClass->blockSize;
+    PoolChunk* chunk = malloc(size);
+    if (!chunk)
+    {
+        return NULL;
+    }
+
+    chunk->free       = NULL;
+    chunk->classIndex = classIndex;
+    chunk->blockCount = poolClass->chunkBlocks;
+    chunk->used       = 0;
+    chunk->fresh      = poolClass->chunkBlocks;
+
+    // Keep the chunk array sorted by address, new chunks usually land near the end
+    int index = pool->chunkCount;
+    while (index > 0 && (uintptr_t)pool->chunks[index - 1] > (uintptr_t)chunk)
+    {
+        pool->chunks[index] = pool->chunks[index - 1];
+        index--;
+    }
+    pool->chunks[index] = chunk;
+    pool->chunkCount++;
+    pool->reserved += size;
+
+    if (poolClass->chunkBlocks * poolClass->blockSize * 2 <= POOL_MAX_CHUNK)
+    {
+        poolClass->chunkBlocks *= 2;
+    }
+
+    poolClass->emptyChunks++;
+    partialPush(poolClass, chunk);
+    return chunk;
+}
+
+static void releaseChunk(Pool* pool, PoolChunk* chunk)
+{
+    PoolClass* poolClass = &pool->classes[chunk->classIndex];
+    partialRemove(poolClass, chunk);
+
+    int index = chunkIndexOf(pool, (uintptr_t)chunk);
+    memmove(&pool->chunks[index], &pool->chunks[index + 1], (pool->chunkCount - index - 1) * sizeof(PoolChunk*));
+    pool->chunkCount--;
+
+    pool->reserved -= POOL_CHUNK_HEADER + (size_t)chunk->blockCount * poolClass->blockSize;
+    free(chunk);
+}
+
+void* plAlloc(Pool* pool, int size)
+{
+    assert(size > 0);
+
+    if (size > POOL_MAX_BLOCK)
+    {
+        PoolLarge* large = malloc(POOL_LARGE_HEADER + size);
+        if (!large)
+        {
+            return NULL;
+        }
+
+        large->prev = NULL;
+        large->next = pool->large;
+        if (pool->large)
+        {
+            pool->large->prev = large;
+        }
+        pool->large = large;
+
+        pool->reserved  += POOL_LARGE_HEADER + size;
+        pool->allocated += size;
+        return (char*)large + POOL_LARGE_HEADER;
+    }
+
+    int        classIndex = classOf(size);
+    PoolClass* poolClass  = &pool->classes[classIndex];
+
+    PoolChunk* chunk = poolClass->partial;
+    if (!chunk)
+    {
+        chunk = newChunk(pool, classIndex);
+        if (!chunk)
+        {
+            return NULL;
+        }
+    }
+
+    void* block;
+    if (chunk->free)
+    {
+        block = chunk->free;
+        chunk->free = *(void**)block;
+    }
+    else
+    {
+        // Blocks are handed out in address order before any is reused, no free list to build up front
+        block = (char*)chunk + POOL_CHUNK_HEADER + (size_t)(chunk->blockCount - chunk->fresh) * poolClass->blockSize;
+        chunk->fresh--;
+    }
+
+    if (chunk->used++ == 0)
+    {
+        poolClass->emptyChunks--;
+    }
+
+    if (!chunk->free && chunk->fresh == 0)
+    {
+        partialRemove(poolClass, chunk);
+    }
+
+    pool->allocated += poolClass->blockSize;
+    return block;
+}
+
+void plRelease(Pool* pool, void* block, int size)
+{
+    if (!block)
+    {
+        return;
+    }
+
+    if (size > POOL_MAX_BLOCK)
+    {
+        PoolLarge* large = (PoolLarge*)((char*)block - POOL_LARGE_HEADER);
+        if (large->prev)
+        {
+            large->prev->next = large->next;
+        }
+        else
+        {
+            pool->large = large->next;
+        }
+
+        if (large->next)
+        {
+            large->next->prev = large->prev;
+        }
+
+        pool->reserved  -= POOL_LARGE_HEADER + size;
+        pool->allocated -= size;
+        free(large);
+        return;
+    }
+
+    PoolChunk* chunk     = pool->chunks[chunkIndexOf(pool, (uintptr_t)block)];
+    PoolClass* poolClass = &pool->classes[chunk->classIndex];
+    assert(chunk->classIndex == classOf(size));
+
+    *(void**)block = chunk->free;
+    chunk->free = block;
+    pool->allocated -= poolClass->blockSize;
+
+    if (!chunk->inPartial)
+    {
+        partialPush(poolClass, chunk);
+    }
+
+    if (--chunk->used == 0)
+    {
+        // Keep one empty chunk per class, give the others back
+        if (poolClass->emptyChunks > 0)
+        {
+            releaseChunk(pool, chunk);
+        }
+        else
+        {
+            poolClass->emptyChunks++;
+        }
+    }
+}
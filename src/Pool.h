@@ -0,0 +1,46 @@
+#pragma once
+
+typedef struct PoolChunk PoolChunk;
+typedef struct PoolLarge PoolLarge;
+
+// Size class allocator for many small blocks of mixed sizes.
+// Blocks up to POOL_MAX_BLOCK bytes are carved from chunks holding a single size class,
+// each new chunk of a class twice as large as the previous one up to POOL_MAX_CHUNK.
+// Released blocks go on the free list of their chunk, and every chunk with free blocks
+// is on its class list, so allocations reuse space from any chunk of the class.
+// A chunk whose blocks are all free again goes back to the system, except for one
+// spare per class so a class hovering around a chunk boundary does not thrash.
+// Larger blocks come from malloc, and every block is released by plFree.
+// Not thread safe, like the tables owning a pool.
+
+#define POOL_CLASS_COUNT    20
+#define POOL_MAX_BLOCK      1024
+
+typedef struct PoolClass
+{
+    int         blockSize;
+    int         chunkBlocks;    // Blocks in the next chunk of this class
+    int         emptyChunks;    // Chunks with no block in use, kept as spares
+    PoolChunk*  partial;        // Chunks with at least one free block
+} PoolClass;
+
+typedef struct Pool
+{
+    PoolClass   classes[POOL_CLASS_COUNT];
+
+    PoolChunk** chunks;         // All chunks sorted by address, to find the chunk of a block
+    int         chunkCount;
+    int         chunkCapacity;
+
+    PoolLarge*  large;          // Blocks above POOL_MAX_BLOCK
+
+    long long   reserved;       // Bytes of all chunks and large blocks, headers included
+    long long   allocated;      // Bytes of the blocks in use, rounded up to their class
+} Pool;
+
+Pool*       plNew(void);
+void        plFree(Pool* pool);
+
+// The size given to plRelease must be the one given to plAlloc
+void*       plAlloc(Pool* pool, int size);
+void        plRelease(Pool* pool, void* block, int size);
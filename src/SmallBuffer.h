@@ -0,0 +1,89 @@
+#pragma once
+
+#include "Arena.h"
+#include "Pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Bytes stored inline before spilling to the heap
+#ifndef SMALL_BUFFER_SIZE
+#define SMALL_BUFFER_SIZE 16
+#endif
+
+// Storage for a copy of a key or value.
+// Small data lives inside the buffer itself, larger data in a separate block
+// taken from the arena or the pool when one is given, from malloc otherwise.
+// The size is kept by the owner, every call takes it so the buffer stays pointer sized.
+typedef struct SmallBuffer
+{
+    union
+    {
+        void* heap;
+        char  inlined[SMALL_BUFFER_SIZE];
+    };
+} SmallBuffer;
+
+static inline void* sbData(SmallBuffer* buffer, int size)
+{
+    return size <= SMALL_BUFFER_SIZE ? buffer->inlined : buffer->heap;
+}
+
+static inline void* sbInit(SmallBuffer* buffer, const void* data, int size, Arena* arena, Pool* pool)
+{
+    void* dest = buffer->inlined;
+    if (size > SMALL_BUFFER_SIZE)
+    {
+        dest = buffer->heap = arena ? arAlloc(arena, size) : pool ? plAlloc(pool, size) : malloc(size);
+        if (!dest)
+        {
+            return NULL;
+        }
+    }
+
+    memcpy(dest, data, size);
+    return dest;
+}
+
+static inline void sbFree(SmallBuffer* buffer, int size, Arena* arena, Pool* pool)
+{
+    if (size > SMALL_BUFFER_SIZE)
+    {
+        if (arena)
+        {
+            // Arena blocks are only released with the arena, keep count of the garbage
+            arWaste(arena, size);
+        }
+        else if (pool)
+        {
+            plRelease(pool, buffer->heap, size);
+        }
+        else
+        {
+            free(buffer->heap);
+        }
+    }
+}
+
+// Replace the content, reusing the storage when the new data fits in it
+static inline void* sbAssign(SmallBuffer* buffer, int oldSize, const void* data, int size, Arena* arena, Pool* pool)
+{
+    if (oldSize != size)
+    {
+        if (arena && size > SMALL_BUFFER_SIZE && size < oldSize)
+        {
+            // Shrink in place, only the tail of the block turns into garbage.
+            // Count rounded sizes, so the later sbFree of size bytes adds up to the whole block.
+            arWaste(arena, arRoundSize(oldSize) - arRoundSize(size));
+            memmove(buffer->heap, data, size);
+            return buffer->heap;
+        }
+
+        sbFree(buffer, oldSize, arena, pool);
+        return sbInit(buffer, data, size, arena, pool);
+    }
+
+    void* dest = sbData(buffer, size);
+    memmove(dest, data, size);
+    return dest;
+}
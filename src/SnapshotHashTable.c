@@ -0,0 +1,614 @@
+#include "../include/SnapshotHashTable.h"
+#include "HashChains.h"
+#include "MurmurHash.h"
+
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+typedef SRWLOCK Mutex;
+
+#define mutexInit(mutex)        InitializeSRWLock(mutex)
+#define mutexDestroy(mutex)     ((void)(mutex))
+#define mutexLock(mutex)        AcquireSRWLockExclusive(mutex)
+#define mutexUnlock(mutex)      ReleaseSRWLockExclusive(mutex)
+#else
+#include <pthread.h>
+
+typedef pthread_mutex_t Mutex;
+
+#define mutexInit(mutex)        pthread_mutex_init(mutex, NULL)
+#define mutexDestroy(mutex)     pthread_mutex_destroy(mutex)
+#define mutexLock(mutex)        pthread_mutex_lock(mutex)
+#define mutexUnlock(mutex)      pthread_mutex_unlock(mutex)
+#endif
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+// Key and value bytes of an entry are stored back to back in the version data,
+// the value starts at the next 8-byte boundary after the key.
+#define DATA_ALIGN(size) (((size) + 7) & ~7)
+
+typedef struct SnapshotEntry
+{
+    uint64_t hash;
+
+    int offset;
+    int keySize;
+    int valueSize;
+
+    int next;
+} SnapshotEntry;
+
+// Same layout as the DOD backend: entries in one flat array, chained from a power-of-two bucket array.
+// Published versions are never written again, a draft is a private copy being edited.
+typedef struct SnapshotVersion
+{
+    int             count;
+    int             capacity;
+    SnapshotEntry*  entries;
+
+    int             hashCount;
+    int*            hashs;
+
+    int             dataSize;
+    int             dataCapacity;
+    int             garbage;        // Data bytes no longer referenced by an entry
+    char*           data;
+
+    uint64_t                retiredEpoch;
+    struct SnapshotVersion* nextRetired;
+} SnapshotVersion;
+
+struct SnapshotReader
+{
+    _Atomic uint64_t        epoch;      // Epoch seen when entering the read section, 0 when outside
+    SnapshotVersion*        version;
+
+    SnapshotHashTable*      table;
+    struct SnapshotReader*  next;
+    void*                   memory;     // Unaligned block holding the reader
+};
+
+struct SnapshotHashTable
+{
+    uint64_t (*hashFn)(void*, int);
+
+    _Atomic(SnapshotVersion*)   current;
+    _Atomic uint64_t            epoch;
+
+    Mutex               writeLock;      // Guards draft, retired and readers
+    SnapshotVersion*    draft;
+    SnapshotVersion*    retired;
+    SnapshotReader*     readers;
+};
+
+struct SnapshotHashTableIter
+{
+    SnapshotVersion*    version;
+    int                 index;
+};
+
+static inline int entryKeyEquals(const SnapshotVersion* version, SnapshotEntry* entry, void* key, int keySize)
+{
+    return memcmp(version->data + entry->offset, key, keySize) == 0;
+}
+
+HASH_CHAINS_DEFINE(const SnapshotVersion, SnapshotEntry, entryKeyEquals)
+
+static uint64_t defaultHash(void* key, int keySize)
+{
+    return murmurHash64(key, keySize, MURMUR_HASH_SEED);
+}
+
+static SnapshotVersion* newVersion(int hashCount)
+{
+    SnapshotVersion* version = calloc(1, sizeof(SnapshotVersion));
+    if (!version)
+    {
+        return NULL;
+    }
+
+    version->hashCount = hashCount;
+    version->hashs = malloc(hashCount * sizeof(int));
+    if (!version->hashs)
+    {
+        free(version);
+        return NULL;
+    }
+
+    for (int i = 0; i < hashCount; i++)
+    {
+        version->hashs[i] = -1;
+    }
+
+    return version;
+}
+
+static void freeVersion(SnapshotVersion* version)
+{
+    if (version)
+    {
+        free(version->entries);
+        free(version->hashs);
+        free(version->data);
+        free(version);
+    }
+}
+
+static SnapshotVersion* copyVersion(const SnapshotVersion* source)
+{
+    SnapshotVersion* version = calloc(1, sizeof(SnapshotVersion));
+    if (!version)
+    {
+        return NULL;
+    }
+
+    version->count        = source->count;
+    version->capacity     = source->count;
+    version->hashCount    = source->hashCount;
+    version->dataSize     = source->dataSize;
+    version->dataCapacity = source->dataSize;
+    version->garbage      = source->garbage;
+
+    version->hashs   = malloc(source->hashCount * sizeof(int));
+    version->entries = source->count > 0 ? malloc(source->count * sizeof(SnapshotEntry)) : NULL;
+    version->data    = source->dataSize > 0 ? malloc(source->dataSize) : NULL;
+    if (!version->hashs || (source->count > 0 && !version->entries) || (source->dataSize > 0 && !version->data))
+    {
+        freeVersion(version);
+        return NULL;
+    }
+
+    memcpy(version->hashs, source->hashs, source->hashCount * sizeof(int));
+    if (source->count > 0)
+    {
+        memcpy(version->entries, source->entries, source->count * sizeof(SnapshotEntry));
+    }
+    if (source->dataSize > 0)
+    {
+        memcpy(version->data, source->data, source->dataSize);
+    }
+
+    return version;
+}
+
+static int indexOf(const SnapshotVersion* version, uint64_t hash, void* key, int keySize, int* outBucket, int* outPrev)
+{
+    return chainsFind(version, version->hashs, version->hashCount, version->entries, hash, key, keySize, outBucket, outPrev, NULL);
+}
+
+static void rehash(SnapshotVersion* version, int hashCount)
+{
+    int* hashs = realloc(version->hashs, hashCount * sizeof(int));
+    if (!hashs)
+    {
+        return;
+    }
+
+    version->hashs = hashs;
+    version->hashCount = hashCount;
+
+    chainsRelink(hashs, hashCount, version->entries, version->count);
+}
+
+// Append key and value bytes to the draft data, returns the offset or -1
+static int appendData(SnapshotVersion* version, void* key, int keySize, void* value, int valueSize)
+{
+    int size = DATA_ALIGN(DATA_ALIGN(keySize) + valueSize);
+    if (version->dataSize + size > version->dataCapacity)
+    {
+        int capacity = version->dataCapacity > 0 ? version->dataCapacity : 256;
+        while (capacity < version->dataSize + size)
+        {
+            capacity *= 2;
+        }
+
+        char* data = realloc(version->data, capacity);
+        if (!data)
+        {
+            return -1;
+        }
+
+        version->data = data;
+        version->dataCapacity = capacity;
+    }
+
+    int offset = version->dataSize;
+    memcpy(version->data + offset, key, keySize);
+    memcpy(version->data + offset + DATA_ALIGN(keySize), value, valueSize);
+
+    version->dataSize += size;
+    return offset;
+}
+
+static void compactData(SnapshotVersion* version)
+{
+    char* data = malloc(version->dataSize - version->garbage);
+    if (!data)
+    {
+        return;
+    }
+
+    int dataSize = 0;
+    for (int i = 0, n = version->count; i < n; i++)
+    {
+        SnapshotEntry* entry = &version->entries[i];
+
+        int size = DATA_ALIGN(DATA_ALIGN(entry->keySize) + entry->valueSize);
+        memcpy(data + dataSize, version->data + entry->offset, size);
+        entry->offset = dataSize;
+        dataSize += size;
+    }
+
+    free(version->data);
+    version->data         = data;
+    version->dataSize     = dataSize;
+    version->dataCapacity = dataSize;
+    version->garbage      = 0;
+}
+
+static SnapshotVersion* acquireDraft(SnapshotHashTable* table)
+{
+    if (!table->draft)
+    {
+        table->draft = copyVersion(atomic_load_explicit(&table->current, memory_order_relaxed));
+    }
+
+    return table->draft;
+}
+
+SnapshotHashTable* shtNew(int size, uint64_t (*hashFn)(void*, int))
+{
+    assert(size > 0);
+
+    int hashCount = 1;
+    while (hashCount < size)
+    {
+        hashCount *= 2;
+    }
+
+    SnapshotHashTable* table = malloc(sizeof(SnapshotHashTable));
+    if (!table)
+    {
+        return NULL;
+    }
+
+    SnapshotVersion* version = newVersion(hashCount);
+    if (!version)
+    {
+        free(table);
+        return NULL;
+    }
+
+    table->hashFn  = hashFn ? hashFn : &defaultHash;
+    table->draft   = NULL;
+    table->retired = NULL;
+    table->readers = NULL;
+
+    atomic_init(&table->current, version);
+    atomic_init(&table->epoch, 1);
+    mutexInit(&table->writeLock);
+
+    return table;
+}
+
+void shtFree(SnapshotHashTable* table)
+{
+    // No reader may be inside a read section anymore
+    while (table->readers)
+    {
+        shtReaderFree(table->readers);
+    }
+
+    SnapshotVersion* version = table->retired;
+    while (version)
+    {
+        SnapshotVersion* next = version->nextRetired;
+        freeVersion(version);
+        version = next;
+    }
+
+    freeVersion(table->draft);
+    freeVersion(atomic_load(&table->current));
+
+    mutexDestroy(&table->writeLock);
+    free(table);
+}
+
+int shtInsert(SnapshotHashTable* table, void* key, int keySize, void* value, int valueSize)
+{
+    uint64_t hash = table->hashFn(key, keySize);
+
+    mutexLock(&table->writeLock);
+
+    int result = 0;
+    SnapshotVersion* draft = acquireDraft(table);
+    if (draft)
+    {
+        int prev;
+        int bucket;
+        int curr = indexOf(draft, hash, key, keySize, &bucket, &prev);
+        if (curr > -1)
+        {
+            SnapshotEntry* entry = &draft->entries[curr];
+            if (entry->valueSize == valueSize)
+            {
+                // The draft owns its data, overwrite in place
+                memcpy(draft->data + entry->offset + DATA_ALIGN(keySize), value, valueSize);
+                result = 1;
+            }
+            else
+            {
+                int offset = appendData(draft, key, keySize, value, valueSize);
+                if (offset > -1)
+                {
+                    draft->garbage += DATA_ALIGN(DATA_ALIGN(keySize) + entry->valueSize);
+                    entry->offset = offset;
+                    entry->valueSize = valueSize;
+                    result = 1;
+                }
+            }
+        }
+        else
+        {
+            if (draft->count + 1 > draft->capacity)
+            {
+                int capacity = (draft->capacity > 0 ? draft->capacity : 8) * 2;
+                SnapshotEntry* entries = realloc(draft->entries, capacity * sizeof(SnapshotEntry));
+                if (entries)
+                {
+                    draft->entries = entries;
+                    draft->capacity = capacity;
+                }
+            }
+
+            int offset = draft->count < draft->capacity ? appendData(draft, key, keySize, value, valueSize) : -1;
+            if (offset > -1)
+            {
+                curr = draft->count++;
+
+                SnapshotEntry* entry = &draft->entries[curr];
+                entry->hash      = hash;
+                entry->offset    = offset;
+                entry->keySize   = keySize;
+                entry->valueSize = valueSize;
+                entry->next      = draft->hashs[bucket];
+                draft->hashs[bucket] = curr;
+
+                if (draft->count > draft->hashCount)
+                {
+                    rehash(draft, draft->hashCount * 2);
+                }
+
+                result = 1;
+            }
+        }
+    }
+
+    mutexUnlock(&table->writeLock);
+    return result;
+}
+
+void shtRemove(SnapshotHashTable* table, void* key, int keySize)
+{
+    uint64_t hash = table->hashFn(key, keySize);
+
+    mutexLock(&table->writeLock);
+
+    SnapshotVersion* draft = acquireDraft(table);
+    if (draft)
+    {
+        int prev;
+        int bucket;
+        int curr = indexOf(draft, hash, key, keySize, &bucket, &prev);
+        if (curr > -1)
+        {
+            SnapshotEntry* entry = &draft->entries[curr];
+            draft->garbage += DATA_ALIGN(DATA_ALIGN(entry->keySize) + entry->valueSize);
+
+            chainsUnlink(draft->hashs, draft->hashCount, draft->entries, draft->count, curr, bucket, prev);
+            draft->count--;
+        }
+    }
+
+    mutexUnlock(&table->writeLock);
+}
+
+// Free the retired versions no reader can still be using. Called with writeLock held.
+static void reclaim(SnapshotHashTable* table)
+{
+    // Oldest epoch any reader inside a read section has announced
+    uint64_t minEpoch = UINT64_MAX;
+    for (SnapshotReader* reader = table->readers; reader; reader = reader->next)
+    {
+        uint64_t epoch = atomic_load(&reader->epoch);
+        if (epoch != 0 && epoch < minEpoch)
+        {
+            minEpoch = epoch;
+        }
+    }
+
+    SnapshotVersion** link = &table->retired;
+    while (*link)
+    {
+        SnapshotVersion* version = *link;
+        if (version->retiredEpoch < minEpoch)
+        {
+            *link = version->nextRetired;
+            freeVersion(version);
+        }
+        else
+        {
+            link = &version->nextRetired;
+        }
+    }
+}
+
+void shtPublish(SnapshotHashTable* table)
+{
+    mutexLock(&table->writeLock);
+
+    SnapshotVersion* draft = table->draft;
+    if (draft)
+    {
+        if (draft->garbage > draft->dataSize / 2)
+        {
+            compactData(draft);
+        }
+
+        table->draft = NULL;
+
+        // Readers that announce an epoch after the increment are guaranteed to load the new version
+        SnapshotVersion* old = atomic_exchange(&table->current, draft);
+        old->retiredEpoch = atomic_fetch_add(&table->epoch, 1);
+        old->nextRetired = table->retired;
+        table->retired = old;
+    }
+
+    reclaim(table);
+    mutexUnlock(&table->writeLock);
+}
+
+SnapshotReader* shtReaderNew(SnapshotHashTable* table)
+{
+    // Each reader sits on its own cache line, announcing an epoch never touches shared lines
+    void* memory = malloc(sizeof(SnapshotReader) + CACHE_LINE_SIZE - 1);
+    if (!memory)
+    {
+        return NULL;
+    }
+
+    SnapshotReader* reader = (SnapshotReader*)(((uintptr_t)memory + CACHE_LINE_SIZE - 1) & ~(uintptr_t)(CACHE_LINE_SIZE - 1));
+    atomic_init(&reader->epoch, 0);
+    reader->version = NULL;
+    reader->table   = table;
+    reader->memory  = memory;
+
+    mutexLock(&table->writeLock);
+    reader->next = table->readers;
+    table->readers = reader;
+    mutexUnlock(&table->writeLock);
+
+    return reader;
+}
+
+void shtReaderFree(SnapshotReader* reader)
+{
+    SnapshotHashTable* table = reader->table;
+
+    mutexLock(&table->writeLock);
+
+    SnapshotReader** link = &table->readers;
+    while (*link != reader)
+    {
+        link = &(*link)->next;
+    }
+    *link = reader->next;
+
+    mutexUnlock(&table->writeLock);
+
+    free(reader->memory);
+}
+
+void shtReadBegin(SnapshotReader* reader)
+{
+    SnapshotHashTable* table = reader->table;
+
+    // Announce the epoch before loading the version, both sequentially consistent,
+    // so a writer either sees the announcement or this reader sees its new version.
+    atomic_store(&reader->epoch, atomic_load(&table->epoch));
+    reader->version = atomic_load(&table->current);
+}
+
+void shtReadEnd(SnapshotReader* reader)
+{
+    reader->version = NULL;
+    atomic_store_explicit(&reader->epoch, 0, memory_order_release);
+}
+
+int shtCount(SnapshotReader* reader)
+{
+    assert(reader->version);
+
+    return reader->version->count;
+}
+
+void* shtSearch(SnapshotReader* reader, void* key, int keySize)
+{
+    assert(reader->version);
+
+    SnapshotVersion* version = reader->version;
+
+    int curr = indexOf(version, reader->table->hashFn(key, keySize), key, keySize, NULL, NULL);
+    if (curr > -1)
+    {
+        SnapshotEntry* entry = &version->entries[curr];
+        return version->data + entry->offset + DATA_ALIGN(entry->keySize);
+    }
+
+    return NULL;
+}
+
+SnapshotHashTableIter* shtIterNew(SnapshotReader* reader)
+{
+    assert(reader->version);
+
+    SnapshotHashTableIter* iter = malloc(sizeof(*iter));
+    if (iter)
+    {
+        iter->version = reader->version;
+        iter->index = -1;
+    }
+
+    return iter;
+}
+
+void shtIterFree(SnapshotHashTableIter* iter)
+{
+    free(iter);
+}
+
+int shtIterNext(SnapshotHashTableIter* iter)
+{
+    if (iter->index < iter->version->count - 1)
+    {
+        iter->index++;
+        return 1;
+    }
+
+    return 0;
+}
+
+void* shtIterGetKey(SnapshotHashTableIter* iter)
+{
+    if (iter->index > -1 && iter->index < iter->version->count)
+    {
+        SnapshotEntry* entry = &iter->version->entries[iter->index];
+        return iter->version->data + entry->offset;
+    }
+    else
+    {
+        return NULL;
+    }
+}
+
+void* shtIterGetValue(SnapshotHashTableIter* iter)
+{
+    if (iter->index > -1 && iter->index < iter->version->count)
+    {
+        SnapshotEntry* entry = &iter->version->entries[iter->index];
+        return iter->version->data + entry->offset + DATA_ALIGN(entry->keySize);
+    }
+    else
+    {
+        return NULL;
+    }
+}
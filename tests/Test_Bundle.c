@@ -8,6 +8,79 @@ int main(void)
     setI32(bundle, "value", 10);
     printf("value=%d\n", getI32(bundle, "value"));
 
+    // Interned keys reach the same nodes as the strings they were made from
+    BundleKey valueKey = bundleIntern("value");
+    BundleKey nameKey  = bundleIntern("name");
+    printf("interned=%d same=%d\n", getI32Key(bundle, valueKey), valueKey.string == bundleIntern("value").string);
+
+    setStringKey(bundle, nameKey, "bundle");
+    printf("name=%s\n", getString(bundle, "name"));
+
+    Bundle* child = newBundle(4);
+    setDouble(child, "scale", 0.5);
+    setBundle(bundle, "child", child);
+    printf("child.scale=%g\n", getDouble(getBundle(bundle, "child"), "scale"));
+
+    removeBundleNodeKey(bundle, valueKey);
+    printf("removed value=%d count=%d missing=%d\n", getI32(bundle, "value"), bundle->count, getI32(bundle, "never set"));
+
+    // Bundles grow past the size they were made with, and shrink back
+    Bundle* grown = newBundle(1);
+    char key[16];
+    for (int i = 0; i < 100; i++)
+    {
+        snprintf(key, sizeof(key), "field%d", i);
+        setI32(grown, key, i);
+    }
+    printf("grown count=%d capacity=%d field42=%d\n", grown->count, grown->capacity, getI32(grown, "field42"));
+
+    for (int i = 0; i < 99; i++)
+    {
+        snprintf(key, sizeof(key), "field%d", i);
+        removeBundleNode(grown, key);
+    }
+    printf("shrunk count=%d capacity=%d field99=%d\n", grown->count, grown->capacity, getI32(grown, "field99"));
+
+    // Bundles with the same keys share a shape, a field resolves its slot once per shape
+    Bundle* first  = newBundle(2);
+    Bundle* second = newBundle(2);
+    BundleField x = bundleField("x");
+    BundleField y = bundleField("y");
+    setI32Field(first, &x, 1);
+    setI32Field(first, &y, 2);
+    setI32Field(second, &x, 3);
+    setI32Field(second, &y, 4);
+    printf("shared=%d first.y=%d second.y=%d second.x=%d\n", first->shape == second->shape,
+        getI32Field(first, &y), getI32Field(second, &y), getI32(second, "x"));
+
+    removeBundleNodeField(second, &x);
+    printf("after remove y=%d x=%d shared=%d\n", getI32Field(second, &y), getI32Field(second, &x), first->shape == second->shape);
+
+    // Batches read and write many fields at once, with their types
+    int32_t     width  = 640;
+    double      ratio  = 1.5;
+    const char* title  = "batch";
+    BundleBatchItem writes[] = {
+        bundleBatchItem("width", Type_I32, &width),
+        bundleBatchItem("ratio", Type_Double, &ratio),
+        bundleBatchItem("title", Type_String, &title),
+    };
+    printf("stored=%d\n", setBatch(first, writes, 3));
+
+    width = 0, ratio = 0, title = NULL;
+    int64_t missing = 7;
+    BundleBatchItem reads[] = {
+        bundleBatchItem("width", Type_I32, &width),
+        bundleBatchItem("ratio", Type_Double, &ratio),
+        bundleBatchItem("title", Type_String, &title),
+        bundleBatchItem("width", Type_I64, &missing),
+    };
+    int found = getBatch(first, reads, 4);
+    printf("found=%d width=%d ratio=%g title=%s mistyped=%lld\n", found, width, ratio, title, (long long)missing);
+
+    freeBundle(first);
+    freeBundle(second);
+    freeBundle(grown);
     freeBundle(bundle);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,78 @@
+#include "BundleImage.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(void)
+{
+    Bundle* bundle = newBundle(8);
+    setI8(bundle, "i8", -8);
+    setU16(bundle, "u16", 16);
+    setI32(bundle, "i32", -32);
+    setU64(bundle, "u64", 64);
+    setFloat(bundle, "float", 1.5f);
+    setDouble(bundle, "double", 2.25);
+    setString(bundle, "name", "image");
+    setCustom(bundle, "custom", bundle);
+
+    Bundle* child = newBundle(4);
+    setI32(child, "depth", 1);
+    setString(child, "label", "child");
+    setBundle(bundle, "child", child);
+
+    uint64_t size = bundleImageSize(bundle);
+    void* buffer = malloc(size);
+    printf("size=%llu written=%llu tooSmall=%llu\n", (unsigned long long)size,
+        (unsigned long long)bundleEncode(bundle, buffer, size), (unsigned long long)bundleEncode(bundle, buffer, size - 1));
+
+    BundleView view;
+    if (!bvOpen(&view, buffer, size))
+    {
+        printf("bvOpen failed\n");
+        return 1;
+    }
+
+    // Custom values stay behind, everything else reads back from the buffer
+    printf("count=%d i8=%d u16=%u i32=%d u64=%llu float=%g double=%g name=%s\n", bvCount(view),
+        bvGetI8(view, "i8"), bvGetU16(view, "u16"), bvGetI32(view, "i32"), (unsigned long long)bvGetU64(view, "u64"),
+        bvGetFloat(view, "float"), bvGetDouble(view, "double"), bvGetString(view, "name"));
+
+    BundleView childView = bvGetBundleKey(view, bundleIntern("child"));
+    printf("child.depth=%d child.label=%s missing=%d wrongType=%d\n",
+        bvGetI32Key(childView, bundleIntern("depth")), bvGetString(childView, "label"),
+        bvGetI32(view, "missing"), bvGetI32(view, "name"));
+
+    // Truncated or corrupted images are rejected up front
+    printf("truncated=%d\n", bvOpen(&view, buffer, size / 2));
+    ((char*)buffer)[0] = 'X';
+    printf("corrupted=%d\n", bvOpen(&view, buffer, size));
+
+    // Two entries sharing one child block are rejected, each block must be referenced once
+    Bundle* shared = newBundle(2);
+    setBundle(shared, "a", newBundle(1));
+    setBundle(shared, "b", newBundle(1));
+    setI32(getBundle(shared, "a"), "x", 1);
+    setI32(getBundle(shared, "b"), "x", 2);
+
+    uint64_t sharedSize   = bundleImageSize(shared);
+    void*    sharedBuffer = malloc(sharedSize);
+    bundleEncode(shared, sharedBuffer, sharedSize);
+    bvOpen(&view, sharedBuffer, sharedSize);
+
+    uint64_t childA = bvGetBundle(view, "a").block;
+    uint64_t childB = bvGetBundle(view, "b").block;
+    for (uint64_t* word = sharedBuffer; (char*)(word + 1) <= (char*)sharedBuffer + sharedSize; word++)
+    {
+        if (*word == childB)
+        {
+            *word = childA;
+        }
+    }
+    printf("sharedChild=%d\n", bvOpen(&view, sharedBuffer, sharedSize));
+
+    free(sharedBuffer);
+    freeBundle(shared);
+    free(buffer);
+    freeBundle(bundle);
+    return 0;
+}
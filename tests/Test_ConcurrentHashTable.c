@@ -0,0 +1,76 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/ConcurrentHashTable.h"
+
+#define THREAD_COUNT    4
+#define KEYS_PER_THREAD 10000
+
+static ConcurrentHashTable* testTable;
+
+static void* worker(void* arg)
+{
+    int first = (int)(intptr_t)arg * KEYS_PER_THREAD;
+    int misses = 0;
+
+    for (int key = first; key < first + KEYS_PER_THREAD; key++)
+    {
+        int value = key * 2;
+        chtInsert(testTable, &key, sizeof(key), &value, sizeof(value));
+    }
+
+    for (int key = first; key < first + KEYS_PER_THREAD; key++)
+    {
+        int value;
+        if (!chtSearch(testTable, &key, sizeof(key), &value, sizeof(value), NULL) || value != key * 2)
+        {
+            misses++;
+        }
+    }
+
+    return (void*)(intptr_t)misses;
+}
+
+int main(void)
+{
+    testTable = chtNew(16, 64, NULL);
+
+    printf("Start %d threads inserting into ConcurrentHashTable\n", THREAD_COUNT);
+    pthread_t threads[THREAD_COUNT];
+    for (int i = 0; i < THREAD_COUNT; i++)
+    {
+        pthread_create(&threads[i], NULL, worker, (void*)(intptr_t)i);
+    }
+
+    int misses = 0;
+    for (int i = 0; i < THREAD_COUNT; i++)
+    {
+        void* result;
+        pthread_join(threads[i], &result);
+        misses += (int)(intptr_t)result;
+    }
+
+    int iterated = 0;
+    ConcurrentHashTableIter* iter = chtIterNew(testTable);
+    while (chtIterNext(iter))
+    {
+        iterated++;
+    }
+    chtIterFree(iter);
+
+    printf("count=%d iterated=%d misses=%d\n", chtCount(testTable), iterated, misses);
+
+    // A lookup into a smaller buffer copies only what fits and reports the stored size
+    int  key = -1;
+    char stored[8] = "1234567";
+    char buffer[8] = "";
+    int  storedSize = 0;
+    chtInsert(testTable, &key, sizeof(key), stored, sizeof(stored));
+    int found = chtSearch(testTable, &key, sizeof(key), buffer, 4, &storedSize);
+    int clamped = found && storedSize == (int)sizeof(stored) && memcmp(buffer, "1234", 4) == 0 && buffer[4] == 0;
+    printf("found=%d storedSize=%d clamped=%d\n", found, storedSize, clamped);
+
+    chtFree(testTable);
+    return misses == 0 && iterated == THREAD_COUNT * KEYS_PER_THREAD && clamped ? 0 : 1;
+}
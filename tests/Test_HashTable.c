@@ -3,6 +3,341 @@
 
 #include "../include/HashTable.h"
 
+static int addValueSize(void* context, void* key, int keySize, void* value, int valueSize)
+{
+    (void)key;
+    (void)keySize;
+    (void)value;
+
+    *(int*)context += valueSize;
+    return 0;
+}
+
+// Half of the keys share the last 4 home slots of a 64-slot table, so open addressing
+// backends get long probe runs that wrap around the end of the array
+#define RUN_TABLE_SIZE  57
+
+static uint64_t clusterHash(void* key, int keySize)
+{
+    (void)keySize;
+
+    int k = *(int*)key;
+    uint64_t home = k % 2 ? (uint64_t)(k * 5) & 63 : 60 + (uint64_t)(k / 2) % 4;
+    return (uint64_t)k << 32 | home;
+}
+
+// Fill to about 0.9 load, remove every third key out of the middle of the runs,
+// then check the survivors, the removed keys and their reinsertion
+static int testRemoveRuns(void)
+{
+    int errors = 0;
+    HashTable* table = htNew(RUN_TABLE_SIZE, clusterHash);
+
+    for (int key = 0; key < RUN_TABLE_SIZE; key++)
+    {
+        int value = key * 3;
+        htInsert(table, &key, sizeof(key), &value, sizeof(value));
+    }
+
+    for (int key = 1; key < RUN_TABLE_SIZE; key += 3)
+    {
+        htRemove(table, &key, sizeof(key));
+    }
+
+    int removed = (RUN_TABLE_SIZE + 1) / 3;
+    if (htCount(table) != RUN_TABLE_SIZE - removed)
+    {
+        errors++;
+    }
+
+    for (int key = 0; key < RUN_TABLE_SIZE; key++)
+    {
+        int* value = htSearch(table, &key, sizeof(key));
+        if (key % 3 == 1 ? value != NULL : !value || *value != key * 3)
+        {
+            errors++;
+        }
+    }
+
+    for (int key = 1; key < RUN_TABLE_SIZE; key += 3)
+    {
+        int value = key * 3;
+        if (!htInsert(table, &key, sizeof(key), &value, sizeof(value)))
+        {
+            errors++;
+        }
+    }
+
+    for (int key = 0; key < RUN_TABLE_SIZE; key++)
+    {
+        int* value = htSearch(table, &key, sizeof(key));
+        if (!value || *value != key * 3)
+        {
+            errors++;
+        }
+    }
+
+    printf("Remove from probe runs: count %d, errors: %d\n", htCount(table), errors);
+
+    htFree(table);
+    return errors;
+}
+
+#define RESIZE_KEY_COUNT 5000
+
+static int isPowerOfTwo(int n)
+{
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+// Tables grow and shrink when the count crosses a power of two,
+// so every key still present is looked up on both sides of each of them
+static int checkKeys(HashTable* table, int begin, int end)
+{
+    int count  = htCount(table);
+    int errors = count != end - begin;
+    if (!isPowerOfTwo(count - 1) && !isPowerOfTwo(count) && !isPowerOfTwo(count + 1))
+    {
+        return errors;
+    }
+
+    for (int key = begin; key < end; key++)
+    {
+        int* value = htSearch(table, &key, sizeof(key));
+        if (!value || *value != -key)
+        {
+            errors++;
+        }
+    }
+
+    return errors;
+}
+
+// Insert past several growth thresholds, then remove down below a quarter of the peak
+static int testResize(void)
+{
+    int errors = 0;
+    HashTable* table = htNew(8, NULL);
+
+    HashTableStats stats;
+    htGetStats(table, &stats);
+    int initialBuckets = stats.bucketCount;
+
+    for (int key = 0; key < RESIZE_KEY_COUNT; key++)
+    {
+        int value = -key;
+        htInsert(table, &key, sizeof(key), &value, sizeof(value));
+        errors += checkKeys(table, 0, key + 1);
+    }
+
+    htGetStats(table, &stats);
+    int peakBuckets = stats.bucketCount;
+
+    int remaining = RESIZE_KEY_COUNT / 8;
+    for (int key = 0; key < RESIZE_KEY_COUNT - remaining; key++)
+    {
+        htRemove(table, &key, sizeof(key));
+        errors += checkKeys(table, key + 1, RESIZE_KEY_COUNT);
+    }
+
+    htGetStats(table, &stats);
+    printf("Resize: buckets %d -> %d -> %d, count %d, errors: %d\n",
+           initialBuckets, peakBuckets, stats.bucketCount, htCount(table), errors);
+
+    htFree(table);
+    return errors;
+}
+
+#define STORAGE_KEY_COUNT   1000
+#define STORAGE_VALUE_SIZE  100
+
+// Values of size bytes whose content depends on the key, larger than inline storage
+static void fillValue(char* value, int key, int size)
+{
+    for (int i = 0; i < size; i++)
+    {
+        value[i] = (char)(key * 7 + i);
+    }
+}
+
+static int checkValues(HashTable* table, int begin, int end, int step, int size)
+{
+    int errors = 0;
+    char expected[STORAGE_VALUE_SIZE];
+    for (int key = begin; key < end; key += step)
+    {
+        fillValue(expected, key, size);
+        char* value = htSearch(table, &key, sizeof(key));
+        if (!value || memcmp(value, expected, size) != 0)
+        {
+            errors++;
+        }
+    }
+
+    return errors;
+}
+
+static int insertValues(HashTable* table, int size)
+{
+    int errors = 0;
+    char value[STORAGE_VALUE_SIZE];
+    for (int key = 0; key < STORAGE_KEY_COUNT; key++)
+    {
+        fillValue(value, key, size);
+        if (!htInsert(table, &key, sizeof(key), value, size))
+        {
+            errors++;
+        }
+    }
+
+    return errors;
+}
+
+static long long poolBytesOf(HashTable* table)
+{
+    HashTableStats stats;
+    htGetStats(table, &stats);
+    return stats.poolBytes;
+}
+
+// Arena tables shrink values in place and only take new arena memory for larger ones,
+// removed data stays in the arena until the table is freed
+static int testArena(void)
+{
+    int errors = 0;
+    HashTable* table = htNewArena(STORAGE_KEY_COUNT, NULL);
+
+    errors += insertValues(table, 64);
+    long long filledBytes = poolBytesOf(table);
+    if (filledBytes < (long long)STORAGE_KEY_COUNT * 64)
+    {
+        errors++;
+    }
+
+    errors += insertValues(table, 40);
+    errors += checkValues(table, 0, STORAGE_KEY_COUNT, 1, 40);
+    if (poolBytesOf(table) != filledBytes)
+    {
+        errors++;
+    }
+
+    errors += insertValues(table, STORAGE_VALUE_SIZE);
+    errors += checkValues(table, 0, STORAGE_KEY_COUNT, 1, STORAGE_VALUE_SIZE);
+    long long grownBytes = poolBytesOf(table);
+    if (grownBytes < filledBytes + (long long)STORAGE_KEY_COUNT * STORAGE_VALUE_SIZE)
+    {
+        errors++;
+    }
+
+    for (int key = 0; key < STORAGE_KEY_COUNT; key += 2)
+    {
+        htRemove(table, &key, sizeof(key));
+    }
+
+    errors += checkValues(table, 1, STORAGE_KEY_COUNT, 2, STORAGE_VALUE_SIZE);
+    for (int key = 0; key < STORAGE_KEY_COUNT; key += 2)
+    {
+        if (htSearch(table, &key, sizeof(key)))
+        {
+            errors++;
+        }
+    }
+
+    if (htCount(table) != STORAGE_KEY_COUNT / 2 || poolBytesOf(table) != grownBytes)
+    {
+        errors++;
+    }
+
+    printf("Arena: %lld pool bytes filled, %lld after growing values, errors: %d\n", filledBytes, grownBytes, errors);
+
+    htFree(table);
+    return errors;
+}
+
+#define POOL_ROUNDS 8
+
+// Value sizes spanning several pool size classes, the last one above the largest class.
+// There are 7 so that removing every third key takes blocks out of every class.
+static const int pooledSizes[] = { 24, 48, 100, 200, 300, 900, 2000 };
+#define POOLED_SIZE_COUNT ((int)(sizeof(pooledSizes) / sizeof(pooledSizes[0])))
+
+static int checkPooled(HashTable* table, int key, int present)
+{
+    int   size  = pooledSizes[key % POOLED_SIZE_COUNT];
+    char* value = htSearch(table, &key, sizeof(key));
+    if (!present)
+    {
+        return value != NULL;
+    }
+
+    char expected[2000];
+    fillValue(expected, key, size);
+    return !value || memcmp(value, expected, size) != 0;
+}
+
+// Pooled tables reuse released blocks: reinserting removed keys of the same sizes takes no
+// new pool memory and keeps the contents intact, and emptying the table gives chunks back
+static int testPooled(void)
+{
+    int errors = 0;
+    HashTable* table = htNewPooled(STORAGE_KEY_COUNT, NULL);
+
+    char value[2000];
+    long long filledBytes = 0;
+    long long peakBytes   = 0;
+    for (int round = 0; round < POOL_ROUNDS; round++)
+    {
+        for (int key = 0; key < STORAGE_KEY_COUNT; key++)
+        {
+            if (round == 0 || key % 3 == round % 3)
+            {
+                int size = pooledSizes[key % POOLED_SIZE_COUNT];
+                fillValue(value, key, size);
+                htInsert(table, &key, sizeof(key), value, size);
+            }
+        }
+
+        for (int key = 0; key < STORAGE_KEY_COUNT; key++)
+        {
+            errors += checkPooled(table, key, 1);
+        }
+
+        long long bytes = poolBytesOf(table);
+        filledBytes = round == 0 ? bytes : filledBytes;
+        peakBytes   = bytes > peakBytes ? bytes : peakBytes;
+
+        // Remove a third of the keys, a different third next round
+        for (int key = 0; key < STORAGE_KEY_COUNT; key++)
+        {
+            if (key % 3 == (round + 1) % 3)
+            {
+                htRemove(table, &key, sizeof(key));
+            }
+        }
+
+        for (int key = 0; key < STORAGE_KEY_COUNT; key++)
+        {
+            errors += checkPooled(table, key, key % 3 != (round + 1) % 3);
+        }
+    }
+
+    for (int key = 0; key < STORAGE_KEY_COUNT; key++)
+    {
+        htRemove(table, &key, sizeof(key));
+    }
+
+    long long emptyBytes = poolBytesOf(table);
+    if (peakBytes != filledBytes || emptyBytes >= filledBytes / 2)
+    {
+        errors++;
+    }
+
+    printf("Pooled: %lld pool bytes filled, %lld at peak, %lld empty, errors: %d\n", filledBytes, peakBytes, emptyBytes, errors);
+
+    htFree(table);
+    return errors;
+}
+
 int main(void)
 {
     HashTable* testTable = htNew(8, NULL);
@@ -21,6 +356,64 @@ int main(void)
     }
 
     htIterFree(iter);
+
+    printf("Iteration values of HashTable with a stack iterator\n");
+    HT_FOREACH(stackIter, testTable)
+    {
+        printf("%s => %s\n", (char*)stackIter.key, (char*)stackIter.value);
+    }
+
+    int totalSize = 0;
+    htForEach(testTable, addValueSize, &totalSize);
+    printf("Total value size: %d\n", totalSize);
+
+    printf("Iteration values of HashTable in 2 ranges\n");
+    for (int part = 0; part < 2; part++)
+    {
+        HashTableIter* rangeIter = htIterNewRange(testTable, part, 2);
+        while (htIterNext(rangeIter))
+        {
+            printf("[%d] %s => %s\n", part, (char*)htIterGetKey(rangeIter), (char*)htIterGetValue(rangeIter));
+        }
+
+        htIterFree(rangeIter);
+    }
+
+    printf("Batch search values of HashTable\n");
+    const char* keys[] = { "GNU", "Rust", "Perl" };
+    void*       keyPtrs[] = { (void*)keys[0], (void*)keys[1], (void*)keys[2] };
+    int         keySizes[] = { (int)strlen(keys[0]) + 1, (int)strlen(keys[1]) + 1, (int)strlen(keys[2]) + 1 };
+    void*       values[3];
+    htSearchBatch(testTable, keyPtrs, keySizes, 3, values);
+    for (int i = 0; i < 3; i++)
+    {
+        printf("%s => %s\n", keys[i], values[i] ? (char*)values[i] : "(null)");
+    }
+
+    printf("Build HashTable from arrays, first duplicate wins\n");
+    void* buildKeys[]   = { "Perl", "GNU", "Perl" };
+    void* buildValues[] = { "Language", "System", "Camel" };
+    int   buildKeySizes[]   = { 5, 4, 5 };
+    int   buildValueSizes[] = { 9, 7, 6 };
+    HashTable* builtTable = htBuildFromArrays(buildKeys, buildKeySizes, buildValues, buildValueSizes, 3, HashTableDuplicates_FirstWins, NULL);
+    printf("count: %d, Perl => %s\n", htCount(builtTable), dictSearch(builtTable, "Perl"));
+    htFree(builtTable);
+
+    printf("Statistics of HashTable\n");
+    HashTableStats stats;
+    htGetStats(testTable, &stats);
+    printf("count: %d, buckets: %d used of %d\n", stats.count, stats.usedBuckets, stats.bucketCount);
+    printf("hits: %lld, misses: %lld, memcmp calls: %lld, resizes: %lld\n", stats.hits, stats.misses, stats.memcmpCalls, stats.resizes);
+    printf("bytes: %lld table, %lld entries, %lld keys, %lld values, %lld pools\n",
+           stats.tableBytes, stats.entryBytes, stats.keyBytes, stats.valueBytes, stats.poolBytes);
+
     htFree(testTable);
-    return 0;
+
+    int errors = 0;
+    errors += testRemoveRuns();
+    errors += testResize();
+    errors += testArena();
+    errors += testPooled();
+
+    return errors ? 1 : 0;
 }
\ No newline at end of file
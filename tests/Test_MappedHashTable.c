@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/HashTable.h"
+#include "../include/MappedHashTable.h"
+
+#define KEY_COUNT 10000
+
+// Header fields read by the corruption checks, see the image layout in MappedHashTable.c
+#define HEADER_BUCKETS_OFFSET   40
+#define HEADER_ENTRIES_OFFSET   48
+
+// Copy the image with size bytes at offset overwritten by value, and report whether it still opens
+static int opensCorrupted(const char* path, const char* corruptPath, long offset, uint64_t value, int size)
+{
+    FILE* file = fopen(path, "rb");
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char* image = malloc(length);
+    fread(image, 1, length, file);
+    fclose(file);
+
+    memcpy(image + offset, &value, size);
+
+    file = fopen(corruptPath, "wb");
+    fwrite(image, 1, length, file);
+    fclose(file);
+    free(image);
+
+    MappedHashTable* mapped = htOpenMapped(corruptPath);
+    mhtClose(mapped);
+    remove(corruptPath);
+
+    return mapped != NULL;
+}
+
+static uint64_t readHeaderField(const char* path, long offset)
+{
+    uint64_t value = 0;
+    FILE* file = fopen(path, "rb");
+    fseek(file, offset, SEEK_SET);
+    fread(&value, sizeof(value), 1, file);
+    fclose(file);
+    return value;
+}
+
+int main(void)
+{
+    const char* path = "Test_MappedHashTable.img";
+
+    HashTable* testTable = htNew(KEY_COUNT, NULL);
+    for (int i = 0; i < KEY_COUNT; i++)
+    {
+        char key[32];
+        snprintf(key, sizeof(key), "key-%d", i);
+
+        // Some values do not fit inline, to cover both storage paths before saving
+        long long value[4] = { i, i * 2, i * 3, i * 4 };
+        htInsert(testTable, key, (int)strlen(key) + 1, value, i % 2 ? (int)sizeof(value) : (int)sizeof(long long));
+    }
+
+    printf("Save HashTable to %s\n", path);
+    if (!htSave(testTable, path))
+    {
+        printf("Failed to save HashTable\n");
+        return 1;
+    }
+    htFree(testTable);
+
+    MappedHashTable* mapped = htOpenMapped(path);
+    if (!mapped)
+    {
+        printf("Failed to map %s\n", path);
+        return 1;
+    }
+
+    int errors = 0;
+    for (int i = 0; i < KEY_COUNT; i++)
+    {
+        char key[32];
+        snprintf(key, sizeof(key), "key-%d", i);
+
+        const long long* value = mhtSearch(mapped, key, (int)strlen(key) + 1);
+        if (!value || value[0] != i || (i % 2 && value[3] != i * 4))
+        {
+            errors++;
+        }
+    }
+
+    if (mhtSearch(mapped, "missing", sizeof("missing")))
+    {
+        errors++;
+    }
+
+    int iterated = 0;
+    MappedHashTableIter* iter = mhtIterNew(mapped);
+    while (mhtIterNext(iter))
+    {
+        const long long* value = mhtIterGetValue(iter);
+        if (mhtSearch(mapped, mhtIterGetKey(iter), mhtIterGetKeySize(iter)) != value)
+        {
+            errors++;
+        }
+
+        iterated++;
+    }
+    mhtIterFree(iter);
+
+    printf("Mapped %d entries, iterated %d, errors: %d\n", mhtCount(mapped), iterated, errors);
+
+    mhtClose(mapped);
+
+    // Bucket ranges and entry offsets pointing outside the file must be rejected at open
+    const char* corruptPath = "Test_MappedHashTable.bad.img";
+    long bucketsOffset = (long)readHeaderField(path, HEADER_BUCKETS_OFFSET);
+    long entriesOffset = (long)readHeaderField(path, HEADER_ENTRIES_OFFSET);
+    int  rejected = !opensCorrupted(path, corruptPath, bucketsOffset + 4, 0xffffffffu, 4)
+                 && !opensCorrupted(path, corruptPath, bucketsOffset, 1, 4)
+                 && !opensCorrupted(path, corruptPath, entriesOffset + 8, (uint64_t)1 << 40, 8)
+                 && !opensCorrupted(path, corruptPath, entriesOffset + 16, (uint64_t)-16, 8);
+    printf("Corrupted images rejected: %d\n", rejected);
+
+    remove(path);
+
+    return errors || iterated != KEY_COUNT || !rejected ? 1 : 0;
+}
@@ -0,0 +1,60 @@
+#include "PersistentBundle.h"
+#include <stdio.h>
+
+int main(void)
+{
+    PersistentBundle* empty = pbNew();
+    PersistentBundle* base  = pbSetI32(empty, "width", 640);
+    PersistentBundle* named = pbSetString(base, "name", "base");
+
+    // Every version keeps the values it was made with
+    PersistentBundle* wide = pbSetI32Key(named, bundleIntern("width"), 1920);
+    printf("base.width=%d wide.width=%d named.name=%s wide.name=%s counts=%d,%d,%d,%d\n",
+        pbGetI32(base, "width"), pbGetI32(wide, "width"), pbGetString(named, "name"), pbGetString(wide, "name"),
+        pbCount(empty), pbCount(base), pbCount(named), pbCount(wide));
+
+    PersistentBundle* child  = pbSetDouble(empty, "scale", 0.5);
+    PersistentBundle* parent = pbSetBundle(wide, "child", child);
+    pbRelease(child);
+    printf("child.scale=%g missing=%d wrongType=%d\n",
+        pbGetDouble(pbGetBundle(parent, "child"), "scale"), pbGetI32(parent, "missing"), pbGetI32(parent, "name"));
+
+    PersistentBundle* removed = pbRemove(parent, "name");
+    PersistentBundle* same    = pbRemove(removed, "name");
+    printf("removed.name=%s parent.name=%s count=%d same=%d\n",
+        pbGetString(removed, "name"), pbGetString(parent, "name"), pbCount(removed), same == removed);
+
+    // Many versions of a large bundle share everything but the changed paths
+    PersistentBundle* large = pbRetain(empty);
+    char key[16];
+    for (int i = 0; i < 1000; i++)
+    {
+        snprintf(key, sizeof(key), "field%d", i);
+        PersistentBundle* next = pbSetI32(large, key, i);
+        pbRelease(large);
+        large = next;
+    }
+
+    PersistentBundle* changed = pbSetI32(large, "field500", -1);
+    printf("large.field500=%d changed.field500=%d changed.field999=%d count=%d\n",
+        pbGetI32(large, "field500"), pbGetI32(changed, "field500"), pbGetI32(changed, "field999"), pbCount(changed));
+
+    Bundle* mutable = newBundle(4);
+    setI32(mutable, "depth", 2);
+    setString(mutable, "label", "converted");
+    PersistentBundle* converted = pbFromBundle(mutable);
+    freeBundle(mutable);
+    printf("converted.depth=%d converted.label=%s\n", pbGetI32(converted, "depth"), pbGetString(converted, "label"));
+
+    pbRelease(converted);
+    pbRelease(changed);
+    pbRelease(large);
+    pbRelease(same);
+    pbRelease(removed);
+    pbRelease(parent);
+    pbRelease(wide);
+    pbRelease(named);
+    pbRelease(base);
+    pbRelease(empty);
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+#include "../include/SnapshotHashTable.h"
+
+#define READER_COUNT    4
+#define KEY_COUNT       256
+#define VERSION_COUNT   200
+
+static SnapshotHashTable* testTable;
+static atomic_int         writerDone;
+
+static void* reader(void* arg)
+{
+    (void)arg;
+
+    SnapshotReader* reader = shtReaderNew(testTable);
+    int torn = 0;
+
+    while (!writerDone)
+    {
+        // Every key of a published version holds the same value
+        shtReadBegin(reader);
+
+        int key = 0;
+        int* first = shtSearch(reader, &key, sizeof(key));
+        for (key = 1; first && key < KEY_COUNT; key++)
+        {
+            int* value = shtSearch(reader, &key, sizeof(key));
+            if (!value || *value != *first)
+            {
+                torn++;
+            }
+        }
+
+        shtReadEnd(reader);
+    }
+
+    shtReaderFree(reader);
+    return (void*)(intptr_t)torn;
+}
+
+int main(void)
+{
+    testTable = shtNew(64, NULL);
+
+    pthread_t threads[READER_COUNT];
+    for (int i = 0; i < READER_COUNT; i++)
+    {
+        pthread_create(&threads[i], NULL, reader, NULL);
+    }
+
+    printf("Publish %d versions of %d keys\n", VERSION_COUNT, KEY_COUNT);
+    for (int version = 0; version < VERSION_COUNT; version++)
+    {
+        for (int key = 0; key < KEY_COUNT; key++)
+        {
+            shtInsert(testTable, &key, sizeof(key), &version, sizeof(version));
+        }
+
+        shtPublish(testTable);
+    }
+    writerDone = 1;
+
+    int torn = 0;
+    for (int i = 0; i < READER_COUNT; i++)
+    {
+        void* result;
+        pthread_join(threads[i], &result);
+        torn += (int)(intptr_t)result;
+    }
+
+    SnapshotReader* reader = shtReaderNew(testTable);
+    shtReadBegin(reader);
+
+    int key = KEY_COUNT - 1;
+    int* value = shtSearch(reader, &key, sizeof(key));
+    printf("count=%d last=%d torn=%d\n", shtCount(reader), value ? *value : -1, torn);
+
+    shtReadEnd(reader);
+    shtReaderFree(reader);
+    shtFree(testTable);
+    return torn == 0 ? 0 : 1;
+}
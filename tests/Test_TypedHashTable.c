@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/TypedHashTable.h"
+
+typedef struct Point
+{
+    float x;
+    float y;
+} Point;
+
+HT_DEFINE(PointTable, uint32_t, Point, htHashU32, htEqual)
+
+#define KEY_RANGE   4096
+#define OP_COUNT    200000
+
+int main(void)
+{
+    PointTable* testTable = PointTableNew(8);
+
+    printf("Start random operations on PointTable\n");
+
+    // Mirror every operation in a plain array and compare
+    static Point expected[KEY_RANGE];
+    static char  present[KEY_RANGE];
+    int          expectedCount = 0;
+    int          errors = 0;
+
+    srand(1);
+    for (int i = 0; i < OP_COUNT; i++)
+    {
+        uint32_t key = (uint32_t)(rand() % KEY_RANGE);
+        switch (rand() % 3)
+        {
+            case 0:
+            {
+                Point point = { (float)i, (float)key };
+                PointTableInsert(testTable, key, point);
+                expectedCount += !present[key];
+                expected[key] = point;
+                present[key] = 1;
+                break;
+            }
+
+            case 1:
+                if (PointTableRemove(testTable, key) != present[key])
+                {
+                    errors++;
+                }
+                expectedCount -= present[key];
+                present[key] = 0;
+                break;
+
+            default:
+            {
+                Point* point = PointTableSearch(testTable, key);
+                if ((point != NULL) != present[key] || (point && point->x != expected[key].x))
+                {
+                    errors++;
+                }
+                break;
+            }
+        }
+    }
+
+    int iterated = 0;
+    for (int i = 0; i < testTable->count; i++)
+    {
+        PointTableEntry* entry = &testTable->entries[i];
+        if (!present[entry->key] || entry->value.y != (float)entry->key)
+        {
+            errors++;
+        }
+        iterated++;
+    }
+
+    printf("count: %d, expected: %d, iterated: %d, errors: %d\n", PointTableCount(testTable), expectedCount, iterated, errors);
+
+    PointTableFree(testTable);
+    return errors || iterated != expectedCount ? 1 : 0;
+}
@@ -0,0 +1,40 @@
+#include <stdio.h>
+#include <string>
+
+#include "../include/TypedHashTable.hpp"
+
+struct StringHash
+{
+    uint64_t operator()(const std::string& key) const
+    {
+        return std::hash<std::string>()(key) * 0x9e3779b97f4a7c15ull;
+    }
+};
+
+int main()
+{
+    TypedHashTable<int, double> numbers;
+    for (int i = 0; i < 1000; i++)
+    {
+        numbers.insert(i, i * 0.5);
+    }
+
+    for (int i = 0; i < 1000; i += 2)
+    {
+        numbers.remove(i);
+    }
+
+    double sum = 0;
+    numbers.forEach([&](int, double value) { sum += value; });
+    printf("numbers: %d entries, sum %.1f, 7 => %.1f\n", numbers.count(), sum, *numbers.search(7));
+
+    TypedHashTable<std::string, std::string, StringHash> languages;
+    languages.insert("Perl", "Language");
+    languages.insert("GNU", "System");
+    languages.insert("Perl", "Camel");
+
+    const std::string* perl = languages.search("Perl");
+    printf("languages: %d entries, Perl => %s\n", languages.count(), perl ? perl->c_str() : "(null)");
+
+    return numbers.count() == 500 && sum == 125000.0 && languages.count() == 2 ? 0 : 1;
+}